@@ -5,5 +5,10 @@
 
 zm_sources += \
 	cond/zm_ccond.c \
+	cond/zm_fcond.c \
+	cond/zm_mcond.c \
+	cond/zm_ncond.c \
 	cond/zm_scount.c \
+	cond/zm_sem.c \
+	cond/zm_barrier.c \
 	cond/zm_wskip.c
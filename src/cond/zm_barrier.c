@@ -0,0 +1,328 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * Barriers as described in:
+ *
+ * Mellor-Crummey, John M., and Michael L. Scott. "Algorithms for scalable
+ * synchronization on shared-memory multiprocessors." ACM Transactions on
+ * Computer Systems (TOCS) 9.1 (1991): 21-65.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "cond/zm_barrier.h"
+#include "lock/zm_topo.h"
+
+/* All the flags count episodes instead of flipping a sense: a waiter of
+ * episode e waits for its flag to reach e, so flags never need a reset. */
+
+struct flag {
+    zm_atomic_uint_t val;
+} __attribute__((aligned(ZM_CACHELINE_SIZE)));
+
+struct hnode {
+    zm_atomic_uint_t count __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    unsigned fanin;
+    zm_atomic_uint_t release __attribute__((aligned(ZM_CACHELINE_SIZE)));
+};
+
+struct barrier {
+    int kind;
+    int nthreads;
+    int nrounds;                /* ceil(log2(nthreads)) */
+    zm_atomic_uint_t nparked __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    struct flag *episodes;      /* per thread, only touched by its owner */
+    /* central */
+    zm_atomic_uint_t count __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    struct flag release;
+    /* dissemination: flags[tid * nrounds + round]
+     * tournament: flags[tid * nrounds + round] for arrivals,
+     *             wakeups[tid] for the release */
+    struct flag *flags;
+    struct flag *wakeups;
+    /* hierarchical */
+    int nlevels;
+    int *level_size;            /* threads per node, 0 for the root */
+    struct hnode **levels;
+};
+
+static inline int reached(zm_atomic_uint_t *flag, unsigned target) {
+    return (int)(zm_atomic_load(flag, zm_memord_acquire) - target) >= 0;
+}
+
+/* Spin until the flag reaches target, then park */
+static inline void await(struct barrier *B, zm_atomic_uint_t *flag, unsigned target) {
+    unsigned spins = 0, val;
+    while (!reached(flag, target)) {
+        if (++spins < ZM_WAIT_SPIN_BUDGET) {
+            zm_cpu_relax();
+            continue;
+        }
+        zm_atomic_fetch_add(&B->nparked, 1, zm_memord_seq_cst);
+        val = zm_atomic_load(flag, zm_memord_seq_cst);
+        if ((int)(val - target) < 0)
+            zm_wait_block(flag, val);
+        zm_atomic_fetch_add(&B->nparked, -1, zm_memord_seq_cst);
+    }
+}
+
+static inline void wake_parked(struct barrier *B, zm_atomic_uint_t *flag) {
+    if (zm_atomic_load(&B->nparked, zm_memord_seq_cst) > 0)
+        zm_wait_wake(flag, INT_MAX);
+}
+
+static inline void set_flag(struct barrier *B, zm_atomic_uint_t *flag, unsigned val) {
+    zm_atomic_store(flag, val, zm_memord_seq_cst);
+    wake_parked(B, flag);
+}
+
+static inline int level_index(struct barrier *B, int level, int tid) {
+    return (B->level_size[level] == 0) ? 0 : tid / B->level_size[level];
+}
+
+static void central_wait(struct barrier *B, unsigned e) {
+    if (zm_atomic_fetch_add(&B->count, -1, zm_memord_acq_rel) == 1) {
+        zm_atomic_store(&B->count, B->nthreads, zm_memord_relaxed);
+        set_flag(B, &B->release.val, e);
+    } else {
+        await(B, &B->release.val, e);
+    }
+}
+
+static void dissemination_wait(struct barrier *B, int tid, unsigned e) {
+    int r, partner;
+    for (r = 0; r < B->nrounds; r++) {
+        partner = (tid + (1 << r)) % B->nthreads;
+        zm_atomic_fetch_add(&B->flags[partner * B->nrounds + r].val, 1, zm_memord_seq_cst);
+        wake_parked(B, &B->flags[partner * B->nrounds + r].val);
+        await(B, &B->flags[tid * B->nrounds + r].val, e);
+    }
+}
+
+static void tournament_wait(struct barrier *B, int tid, unsigned e) {
+    int r, k, child;
+    for (r = 0; r < B->nrounds; r++) {
+        if (tid & (1 << r)) {
+            /* lost round r: tell the winner and wait to be released */
+            set_flag(B, &B->flags[(tid - (1 << r)) * B->nrounds + r].val, e);
+            await(B, &B->wakeups[tid].val, e);
+            break;
+        }
+        if (tid + (1 << r) < B->nthreads)
+            await(B, &B->flags[tid * B->nrounds + r].val, e);
+    }
+    /* release the threads beaten on the way up */
+    for (k = r - 1; k >= 0; k--) {
+        child = tid + (1 << k);
+        if (child < B->nthreads)
+            set_flag(B, &B->wakeups[child].val, e);
+    }
+}
+
+static void hierarchical_wait(struct barrier *B, int tid, unsigned e) {
+    struct hnode *n;
+    int l, k;
+    for (l = 0; l < B->nlevels; l++) {
+        n = &B->levels[l][level_index(B, l, tid)];
+        if (zm_atomic_fetch_add(&n->count, -1, zm_memord_acq_rel) != 1) {
+            await(B, &n->release, e);
+            break;
+        }
+        /* last one at this node: reset it and go up */
+        zm_atomic_store(&n->count, n->fanin, zm_memord_relaxed);
+    }
+    for (k = l - 1; k >= 0; k--)
+        set_flag(B, &B->levels[k][level_index(B, k, tid)].release, e);
+}
+
+static int hierarchical_init(struct barrier *B) {
+    hwloc_topology_t topo;
+    int max_threads, levels, *particip_per_level;
+    int l, i, nnodes, prev_nnodes = B->nthreads, prev_size = 1, ret = -1;
+
+    hwloc_topology_init(&topo);
+    hwloc_topology_load(topo);
+    levels = zm_topo_hierarchy(topo, &max_threads, &particip_per_level);
+    hwloc_topology_destroy(topo);
+
+    B->level_size = (int*) malloc(sizeof(int) * (levels + 1));
+    B->levels = (struct hnode**) malloc(sizeof(struct hnode*) * (levels + 1));
+    if (B->level_size == NULL || B->levels == NULL)
+        goto out;
+    B->nlevels = 0;
+    for (l = 0; l <= levels; l++) {
+        /* the machine level, or anything above, is the root */
+        int root = (l >= levels - 1);
+        int size = root ? 0 : particip_per_level[l];
+        if (!root && (size <= prev_size || size >= B->nthreads))
+            continue; /* no grouping at this level */
+        nnodes = root ? 1 : (B->nthreads + size - 1) / size;
+        if (posix_memalign((void **) &B->levels[B->nlevels], ZM_CACHELINE_SIZE,
+                           sizeof(struct hnode) * nnodes) != 0)
+            goto out;
+        for (i = 0; i < nnodes; i++) {
+            B->levels[B->nlevels][i].fanin = 0;
+            zm_atomic_store(&B->levels[B->nlevels][i].release, 0, zm_memord_relaxed);
+        }
+        /* children are the nodes of the previous level, or the threads */
+        for (i = 0; i < prev_nnodes; i++)
+            B->levels[B->nlevels][root ? 0 : (i * prev_size) / size].fanin++;
+        for (i = 0; i < nnodes; i++)
+            zm_atomic_store(&B->levels[B->nlevels][i].count,
+                            B->levels[B->nlevels][i].fanin, zm_memord_relaxed);
+        B->level_size[B->nlevels] = size;
+        B->nlevels++;
+        if (root)
+            break;
+        prev_nnodes = nnodes;
+        prev_size = size;
+    }
+    ret = 0;
+out:
+    free(particip_per_level);
+    return ret;
+}
+
+static void barrier_free(struct barrier *B) {
+    int l;
+    for (l = 0; l < B->nlevels; l++)
+        free(B->levels[l]);
+    free(B->levels);
+    free(B->level_size);
+    free(B->flags);
+    free(B->wakeups);
+    free(B->episodes);
+    free(B);
+}
+
+int zm_barrier_init(zm_barrier_t *handle, int kind, int nthreads) {
+    struct barrier *B;
+    int i, nflags;
+
+    if (posix_memalign((void **) &B, ZM_CACHELINE_SIZE, sizeof(struct barrier)) != 0)
+        return -1;
+    B->kind = kind;
+    B->nthreads = nthreads;
+    for (B->nrounds = 0; (1 << B->nrounds) < nthreads; B->nrounds++)
+        ;
+    zm_atomic_store(&B->nparked, 0, zm_memord_relaxed);
+    zm_atomic_store(&B->count, nthreads, zm_memord_relaxed);
+    zm_atomic_store(&B->release.val, 0, zm_memord_relaxed);
+    B->flags = NULL;
+    B->wakeups = NULL;
+    B->nlevels = 0;
+    B->level_size = NULL;
+    B->levels = NULL;
+    B->episodes = NULL;
+
+    if (posix_memalign((void **) &B->episodes, ZM_CACHELINE_SIZE,
+                       sizeof(struct flag) * nthreads) != 0)
+        goto fail;
+    for (i = 0; i < nthreads; i++)
+        zm_atomic_store(&B->episodes[i].val, 0, zm_memord_relaxed);
+
+    switch (kind) {
+        case ZM_BARRIER_CENTRAL:
+            break;
+        case ZM_BARRIER_TOURNAMENT:
+            if (posix_memalign((void **) &B->wakeups, ZM_CACHELINE_SIZE,
+                               sizeof(struct flag) * nthreads) != 0)
+                goto fail;
+            for (i = 0; i < nthreads; i++)
+                zm_atomic_store(&B->wakeups[i].val, 0, zm_memord_relaxed);
+            /* fall through */
+        case ZM_BARRIER_DISSEMINATION:
+            nflags = nthreads * (B->nrounds > 0 ? B->nrounds : 1);
+            if (posix_memalign((void **) &B->flags, ZM_CACHELINE_SIZE,
+                               sizeof(struct flag) * nflags) != 0)
+                goto fail;
+            for (i = 0; i < nflags; i++)
+                zm_atomic_store(&B->flags[i].val, 0, zm_memord_relaxed);
+            break;
+        case ZM_BARRIER_HIERARCHICAL:
+            if (hierarchical_init(B) != 0)
+                goto fail;
+            break;
+        default:
+            printf("IZEM:BARRIER:ERROR: unknown barrier kind %d!\n", kind);
+            exit(EXIT_FAILURE);
+    }
+
+    *handle = (zm_barrier_t) B;
+    return 0;
+
+fail:
+    barrier_free(B);
+    return -1;
+}
+
+int zm_barrier_destroy(zm_barrier_t *handle) {
+    barrier_free((struct barrier*)(void *)(*handle));
+    return 0;
+}
+
+int zm_barrier_wait(zm_barrier_t handle, int tid) {
+    struct barrier *B = (struct barrier*)(void *)handle;
+    unsigned e = zm_atomic_load(&B->episodes[tid].val, zm_memord_relaxed) + 1;
+    zm_atomic_store(&B->episodes[tid].val, e, zm_memord_relaxed);
+
+    switch (B->kind) {
+        case ZM_BARRIER_CENTRAL:
+            central_wait(B, e);
+            break;
+        case ZM_BARRIER_DISSEMINATION:
+            dissemination_wait(B, tid, e);
+            break;
+        case ZM_BARRIER_TOURNAMENT:
+            tournament_wait(B, tid, e);
+            break;
+        case ZM_BARRIER_HIERARCHICAL:
+            hierarchical_wait(B, tid, e);
+            break;
+    }
+    return 0;
+}
+
+/* Latch */
+
+int zm_latch_init(struct zm_latch *C, int count) {
+    zm_atomic_store(&C->count, count, zm_memord_release);
+    zm_atomic_store(&C->nparked, 0, zm_memord_release);
+    return 0;
+}
+
+int zm_latch_destroy(struct zm_latch *C) {
+    return 0;
+}
+
+int zm_latch_count_down(struct zm_latch *C, int n) {
+    if (zm_atomic_fetch_add(&C->count, -n, zm_memord_seq_cst) == (unsigned) n
+        && zm_atomic_load(&C->nparked, zm_memord_seq_cst) > 0)
+        zm_wait_wake(&C->count, INT_MAX);
+    return 0;
+}
+
+int zm_latch_wait(struct zm_latch *C) {
+    unsigned spins = 0, val;
+    while (zm_atomic_load(&C->count, zm_memord_acquire) != 0) {
+        if (++spins < ZM_WAIT_SPIN_BUDGET) {
+            zm_cpu_relax();
+            continue;
+        }
+        zm_atomic_fetch_add(&C->nparked, 1, zm_memord_seq_cst);
+        val = zm_atomic_load(&C->count, zm_memord_seq_cst);
+        if (val != 0)
+            zm_wait_block(&C->count, val);
+        zm_atomic_fetch_add(&C->nparked, -1, zm_memord_seq_cst);
+    }
+    return 0;
+}
+
+int zm_latch_trywait(struct zm_latch *C, int *success) {
+    *success = (zm_atomic_load(&C->count, zm_memord_acquire) == 0);
+    return 0;
+}
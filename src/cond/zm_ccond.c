@@ -4,13 +4,30 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include "cond/zm_ccond.h"
 
-/* CAS-based condition variable */
+/* CAS-based condition variable. Waiters spin for a budget and then park
+ * through the block hook; signalers only wake when someone is parked. */
+
+static inline void wait_flag(struct zm_ccond *C) {
+    unsigned spins = 0;
+    while(zm_atomic_load(&C->flag, zm_memord_acquire) == ZM_COND_WAIT) {
+        if (spins < ZM_WAIT_SPIN_BUDGET) {
+            spins++;
+            zm_cpu_relax();
+            continue;
+        }
+        zm_atomic_fetch_add(&C->nblocked, 1, zm_memord_seq_cst);
+        zm_wait_block(&C->flag, ZM_COND_WAIT);
+        zm_atomic_fetch_add(&C->nblocked, -1, zm_memord_seq_cst);
+    }
+}
 
 int zm_ccond_init(struct zm_ccond *C)
 {
     zm_atomic_store(&C->flag, ZM_COND_CLEAR, zm_memord_release);
+    zm_atomic_store(&C->nblocked, 0, zm_memord_release);
     return 0;
 }
 
@@ -22,8 +39,7 @@ int zm_ccond_destroy(struct zm_ccond *C)
 int zm_ccond_wait(struct zm_ccond *C, zm_lock_t *L) {
     zm_atomic_store(&C->flag, ZM_COND_WAIT, zm_memord_release);
     zm_lock_release(L);
-    while(zm_atomic_load(&C->flag, zm_memord_acquire) == ZM_COND_WAIT)
-        ; /* SPIN */
+    wait_flag(C);
     zm_lock_acquire(L);
    return 0;
 }
@@ -31,14 +47,15 @@ int zm_ccond_wait(struct zm_ccond *C, zm_lock_t *L) {
 int zm_ccond_wait_c(struct zm_ccond *C, zm_lock_t *L, zm_lock_ctxt_t *ctxt) {
     zm_atomic_store(&C->flag, ZM_COND_WAIT, zm_memord_release);
     zm_lock_release_c(L, ctxt);
-    while(zm_atomic_load(&C->flag, zm_memord_acquire) == ZM_COND_WAIT)
-        ; /* SPIN */
+    wait_flag(C);
     zm_lock_acquire_c(L, ctxt);
    return 0;
 }
 
 int zm_ccond_signal(struct zm_ccond *C) {
-    zm_atomic_store(&C->flag, ZM_COND_CLEAR, zm_memord_release);
+    zm_atomic_store(&C->flag, ZM_COND_CLEAR, zm_memord_seq_cst);
+    if (zm_atomic_load(&C->nblocked, zm_memord_seq_cst) > 0)
+        zm_wait_wake(&C->flag, INT_MAX);
     return 0;
 }
 
@@ -0,0 +1,112 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include "cond/zm_fcond.h"
+#include "lock/zm_ticket.h"
+
+/* The algorithm follows this logic
+
+wait(C, L)
+w.state = WAIT
+enqueue(C, w)
+release(L)
+spin on w.state != WAIT, then
+if CAS(w.state, WAIT, PARKED)
+    while(w.state == PARKED) block(w.state, PARKED)
+acquire(L)
+
+signal(C)
+w = dequeue(C)
+if (SWAP(w.state, CLEAR) == PARKED) wake(w.state)
+
+The waiter may return as soon as its state is cleared, so the signaler
+must not touch the entry after the swap; waking a stale address is
+harmless since blocking may return spuriously.
+*/
+
+static inline void enqueue(struct zm_fcond *C, struct zm_fcond_waiter *w) {
+    zm_atomic_store(&w->state, ZM_COND_WAIT, zm_memord_relaxed);
+    w->next = NULL;
+    zm_ticket_acquire(&C->lock);
+    if (C->tail != NULL)
+        C->tail->next = w;
+    else
+        C->head = w;
+    C->tail = w;
+    zm_ticket_release(&C->lock);
+}
+
+/* spin then park as described in wait/zm_wait.h */
+static inline void park(struct zm_fcond_waiter *w) {
+    zm_wait_park(&w->state, ZM_COND_WAIT);
+}
+
+static inline void wake(struct zm_fcond_waiter *w) {
+    zm_wait_unpark(&w->state, ZM_COND_CLEAR);
+}
+
+int zm_fcond_init(struct zm_fcond *C)
+{
+    zm_ticket_init(&C->lock);
+    C->head = NULL;
+    C->tail = NULL;
+    return 0;
+}
+
+int zm_fcond_destroy(struct zm_fcond *C)
+{
+    zm_ticket_destroy(&C->lock);
+    return 0;
+}
+
+int zm_fcond_wait(struct zm_fcond *C, zm_lock_t *L) {
+    struct zm_fcond_waiter w;
+    enqueue(C, &w);
+    zm_lock_release(L);
+    park(&w);
+    zm_lock_acquire(L);
+    return 0;
+}
+
+int zm_fcond_wait_c(struct zm_fcond *C, zm_lock_t *L, zm_lock_ctxt_t *ctxt) {
+    struct zm_fcond_waiter w;
+    enqueue(C, &w);
+    zm_lock_release_c(L, ctxt);
+    park(&w);
+    zm_lock_acquire_c(L, ctxt);
+    return 0;
+}
+
+int zm_fcond_signal(struct zm_fcond *C) {
+    struct zm_fcond_waiter *w;
+    zm_ticket_acquire(&C->lock);
+    w = C->head;
+    if (w != NULL) {
+        C->head = w->next;
+        if (C->head == NULL)
+            C->tail = NULL;
+    }
+    zm_ticket_release(&C->lock);
+    if (w != NULL)
+        wake(w);
+    return 0;
+}
+
+int zm_fcond_bcast(struct zm_fcond *C) {
+    struct zm_fcond_waiter *w, *next;
+    zm_ticket_acquire(&C->lock);
+    w = C->head;
+    C->head = NULL;
+    C->tail = NULL;
+    zm_ticket_release(&C->lock);
+    while (w != NULL) {
+        /* read the link before the waiter can return */
+        next = w->next;
+        wake(w);
+        w = next;
+    }
+    return 0;
+}
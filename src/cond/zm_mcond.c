@@ -0,0 +1,110 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include "cond/zm_mcond.h"
+#include "lock/zm_mcs.h"
+
+/* The algorithm follows this logic
+
+wait(C, L, I)
+w.qnode = I; w.state = WAITING
+enqueue(C, w)             // under L
+release(L, I)
+I.next = NULL; I.status = LOCKED
+w.state = RELEASED
+while(I.status == LOCKED) ;   // granted by the predecessor in L's queue
+
+signal(C)                 // under L
+w = dequeue(C)
+while(w.state != RELEASED) ;  // the waiter is done with its release
+requeue(w.lock, w.qnode)  // append to L's queue behind the signaler
+
+The waiter reuses the node it released the lock through, so it returns
+holding the lock with the same context it waited with.
+*/
+
+#define ZM_MCOND_WAITING  0
+#define ZM_MCOND_RELEASED 1
+
+static inline int wait_c(struct zm_mcond *C, zm_mcs_t L, zm_mcs_qnode_t *I) {
+    struct zm_mcond_waiter w;
+    unsigned spins = 0;
+
+    w.lock = L;
+    w.qnode = I;
+    w.next = NULL;
+    zm_atomic_store(&w.state, ZM_MCOND_WAITING, zm_memord_relaxed);
+    if (C->tail != NULL)
+        C->tail->next = &w;
+    else
+        C->head = &w;
+    C->tail = &w;
+
+    zm_mcs_release_c(L, I);
+
+    zm_atomic_store(&I->next, ZM_NULL, zm_memord_relaxed);
+    zm_atomic_store(&I->status, ZM_LOCKED, zm_memord_relaxed);
+    zm_atomic_store(&w.state, ZM_MCOND_RELEASED, zm_memord_release);
+    /* w may be gone from here on */
+    while (zm_atomic_load(&I->status, zm_memord_acquire) != ZM_UNLOCKED)
+        zm_wait_spin(&spins);
+    return 0;
+}
+
+static inline void morph(struct zm_mcond_waiter *w) {
+    zm_mcs_t L = w->lock;
+    zm_mcs_qnode_t *I = w->qnode;
+    unsigned spins = 0;
+    while (zm_atomic_load(&w->state, zm_memord_acquire) != ZM_MCOND_RELEASED)
+        zm_wait_spin(&spins);
+    zm_mcs_requeue_c(L, I);
+}
+
+int zm_mcond_init(struct zm_mcond *C)
+{
+    C->head = NULL;
+    C->tail = NULL;
+    return 0;
+}
+
+int zm_mcond_destroy(struct zm_mcond *C)
+{
+    return 0;
+}
+
+int zm_mcond_wait(struct zm_mcond *C, zm_mcs_t L) {
+    zm_mcs_qnode_t *I;
+    zm_mcs_local_qnode(L, &I);
+    return wait_c(C, L, I);
+}
+
+int zm_mcond_wait_c(struct zm_mcond *C, zm_mcs_t L, zm_mcs_qnode_t *I) {
+    return wait_c(C, L, I);
+}
+
+int zm_mcond_signal(struct zm_mcond *C) {
+    struct zm_mcond_waiter *w = C->head;
+    if (w != NULL) {
+        C->head = w->next;
+        if (C->head == NULL)
+            C->tail = NULL;
+        morph(w);
+    }
+    return 0;
+}
+
+int zm_mcond_bcast(struct zm_mcond *C) {
+    struct zm_mcond_waiter *w = C->head, *next;
+    C->head = NULL;
+    C->tail = NULL;
+    while (w != NULL) {
+        /* read the link before the waiter can return */
+        next = w->next;
+        morph(w);
+        w = next;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include "cond/zm_ncond.h"
+#include "lock/zm_ticket.h"
+#include "lock/zm_topo.h"
+
+/* The algorithm follows this logic
+
+wait(C, L)
+w.state = WAIT; w.seq = C.seq++
+enqueue(C.lists[my_node], w)
+release(L)
+park(w)                  // as in zm_fcond
+acquire(L)
+
+signal(C)
+if (C.lists[my_node] not empty &&
+    (C.streak < LIMIT || no remote waiter))
+    w = dequeue(C.lists[my_node]); C.streak++
+else
+    w = dequeue(list with the oldest head); C.streak = 0
+wake(w)
+*/
+
+#ifndef ZM_NCOND_LOCAL_LIMIT
+#define ZM_NCOND_LOCAL_LIMIT 64
+#endif
+
+struct waiter {
+    zm_atomic_uint_t state;
+    unsigned long seq;
+    struct waiter *next;
+};
+
+struct sublist {
+    struct waiter *head;
+    struct waiter *tail;
+    int count;
+} __attribute__((aligned(ZM_CACHELINE_SIZE)));
+
+struct ncond {
+    zm_ticket_t lock __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    struct sublist *lists;
+    int nclusters;
+    int cluster_size;
+    int nwaiters;
+    unsigned streak;   /* consecutive local wake-ups with remote waiters */
+    unsigned long seq;
+    hwloc_topology_t topo;
+};
+
+static inline int my_cluster(struct ncond *C) {
+    return zm_topo_cluster(C->topo, C->cluster_size, C->nclusters);
+}
+
+static inline void push(struct sublist *l, struct waiter *w) {
+    w->next = NULL;
+    if (l->tail != NULL)
+        l->tail->next = w;
+    else
+        l->head = w;
+    l->tail = w;
+    l->count++;
+}
+
+static inline struct waiter *pop(struct sublist *l) {
+    struct waiter *w = l->head;
+    l->head = w->next;
+    if (l->head == NULL)
+        l->tail = NULL;
+    l->count--;
+    return w;
+}
+
+static inline void park(struct waiter *w) {
+    zm_wait_park(&w->state, ZM_COND_WAIT);
+}
+
+static inline void wake(struct waiter *w) {
+    zm_wait_unpark(&w->state, ZM_COND_CLEAR);
+}
+
+static inline void enqueue(struct ncond *C, struct waiter *w) {
+    int c = my_cluster(C);
+    zm_atomic_store(&w->state, ZM_COND_WAIT, zm_memord_relaxed);
+    zm_ticket_acquire(&C->lock);
+    w->seq = C->seq++;
+    push(&C->lists[c], w);
+    C->nwaiters++;
+    zm_ticket_release(&C->lock);
+}
+
+static inline struct waiter *select_waiter(struct ncond *C) {
+    struct sublist *local = &C->lists[my_cluster(C)];
+    struct waiter *oldest = NULL;
+    int i, oldest_list = 0;
+
+    if (local->count > 0 && (C->streak < ZM_NCOND_LOCAL_LIMIT || local->count == C->nwaiters)) {
+        if (local->count != C->nwaiters)
+            C->streak++;
+        return pop(local);
+    }
+    for (i = 0; i < C->nclusters; i++) {
+        struct waiter *w = C->lists[i].head;
+        if (w != NULL && (oldest == NULL || w->seq < oldest->seq)) {
+            oldest = w;
+            oldest_list = i;
+        }
+    }
+    C->streak = 0;
+    return pop(&C->lists[oldest_list]);
+}
+
+int zm_ncond_init(zm_ncond_t *handle)
+{
+    struct ncond *C;
+    int i;
+
+    if (posix_memalign((void **) &C, ZM_CACHELINE_SIZE, sizeof(struct ncond)) != 0)
+        return -1;
+    hwloc_topology_init(&C->topo);
+    hwloc_topology_load(C->topo);
+    C->nclusters = zm_topo_clusters(C->topo, &C->cluster_size);
+
+    if (posix_memalign((void **) &C->lists, ZM_CACHELINE_SIZE,
+                       sizeof(struct sublist) * C->nclusters) != 0) {
+        hwloc_topology_destroy(C->topo);
+        free(C);
+        return -1;
+    }
+    for (i = 0; i < C->nclusters; i++) {
+        C->lists[i].head = NULL;
+        C->lists[i].tail = NULL;
+        C->lists[i].count = 0;
+    }
+    zm_ticket_init(&C->lock);
+    C->nwaiters = 0;
+    C->streak = 0;
+    C->seq = 0;
+
+    *handle = (zm_ncond_t) C;
+    return 0;
+}
+
+int zm_ncond_destroy(zm_ncond_t *handle)
+{
+    struct ncond *C = (struct ncond*)(void *)(*handle);
+    zm_ticket_destroy(&C->lock);
+    hwloc_topology_destroy(C->topo);
+    free(C->lists);
+    free(C);
+    return 0;
+}
+
+int zm_ncond_wait(zm_ncond_t handle, zm_lock_t *L) {
+    struct ncond *C = (struct ncond*)(void *)handle;
+    struct waiter w;
+    enqueue(C, &w);
+    zm_lock_release(L);
+    park(&w);
+    zm_lock_acquire(L);
+    return 0;
+}
+
+int zm_ncond_wait_c(zm_ncond_t handle, zm_lock_t *L, zm_lock_ctxt_t *ctxt) {
+    struct ncond *C = (struct ncond*)(void *)handle;
+    struct waiter w;
+    enqueue(C, &w);
+    zm_lock_release_c(L, ctxt);
+    park(&w);
+    zm_lock_acquire_c(L, ctxt);
+    return 0;
+}
+
+int zm_ncond_signal(zm_ncond_t handle) {
+    struct ncond *C = (struct ncond*)(void *)handle;
+    struct waiter *w = NULL;
+    zm_ticket_acquire(&C->lock);
+    if (C->nwaiters > 0) {
+        w = select_waiter(C);
+        C->nwaiters--;
+    }
+    zm_ticket_release(&C->lock);
+    if (w != NULL)
+        wake(w);
+    return 0;
+}
+
+int zm_ncond_bcast(zm_ncond_t handle) {
+    struct ncond *C = (struct ncond*)(void *)handle;
+    struct waiter *heads[C->nclusters], *w, *next;
+    int i, c = my_cluster(C);
+
+    zm_ticket_acquire(&C->lock);
+    for (i = 0; i < C->nclusters; i++) {
+        heads[i] = C->lists[i].head;
+        C->lists[i].head = NULL;
+        C->lists[i].tail = NULL;
+        C->lists[i].count = 0;
+    }
+    C->nwaiters = 0;
+    C->streak = 0;
+    zm_ticket_release(&C->lock);
+
+    /* local waiters first */
+    for (i = 0; i < C->nclusters; i++) {
+        w = heads[(c + i) % C->nclusters];
+        while (w != NULL) {
+            /* read the link before the waiter can return */
+            next = w->next;
+            wake(w);
+            w = next;
+        }
+    }
+    return 0;
+}
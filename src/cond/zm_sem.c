@@ -0,0 +1,216 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include "cond/zm_sem.h"
+#include "lock/zm_ticket.h"
+
+/* The algorithm follows this logic
+
+wait(S)
+if (FAA(S.count, -1) > 0) return
+lock(S)
+if (S.pending > 0) { S.pending--; unlock(S); return }
+enqueue(S, w); unlock(S)
+park(w)
+
+post(S, n)
+old = FAA(S.count, n)
+if (old >= 0) return
+lock(S)
+S.pending += min(n, -old)
+while (S.pending > 0 && S.head != NULL) { wake(dequeue(S)); S.pending-- }
+unlock(S)
+
+A waiter registers with the decrement, and only then queues itself, so a
+post may hand it a permit before it is queued; pending carries such permits
+over to the next waiters that queue. A timed-out waiter still queued leaves
+the queue and gives its registration back if the count is negative; if it
+is not, a post in flight already accounted for its permit, which it takes
+by turning it into a debt on pending.
+*/
+
+static inline int as_int(unsigned v) {
+    return (int) v;
+}
+
+static inline void park(struct zm_sem_waiter *w) {
+#if ZM_SEM_PARK
+    zm_wait_park(&w->state, ZM_COND_WAIT);
+#else
+    unsigned spins = 0;
+    while (zm_atomic_load(&w->state, zm_memord_acquire) == ZM_COND_WAIT)
+        zm_wait_spin(&spins);
+#endif
+}
+
+static inline void wake(struct zm_sem_waiter *w) {
+    zm_wait_unpark(&w->state, ZM_COND_CLEAR);
+}
+
+/* Queue w unless a permit is pending. Returns 1 if w was queued. */
+static inline int enqueue(struct zm_sem *S, struct zm_sem_waiter *w) {
+    zm_atomic_store(&w->state, ZM_COND_WAIT, zm_memord_relaxed);
+    w->next = NULL;
+    zm_ticket_acquire(&S->lock);
+    if (S->pending > 0) {
+        S->pending--;
+        zm_ticket_release(&S->lock);
+        return 0;
+    }
+    if (S->tail != NULL)
+        S->tail->next = w;
+    else
+        S->head = w;
+    S->tail = w;
+    zm_ticket_release(&S->lock);
+    return 1;
+}
+
+/* Leave the queue after a timeout. Returns 1 if w got a permit anyway. */
+static inline int cancel(struct zm_sem *S, struct zm_sem_waiter *w) {
+    struct zm_sem_waiter *cur, *prev = NULL;
+    int granted = 1;
+    unsigned c;
+
+    zm_ticket_acquire(&S->lock);
+    for (cur = S->head; cur != NULL && cur != w; cur = cur->next)
+        prev = cur;
+    if (cur == NULL) {
+        /* dequeued by a post that is about to wake us */
+        zm_ticket_release(&S->lock);
+        while (zm_atomic_load(&w->state, zm_memord_acquire) != ZM_COND_CLEAR)
+            zm_cpu_relax();
+        return 1;
+    }
+    if (prev != NULL)
+        prev->next = w->next;
+    else
+        S->head = w->next;
+    if (S->tail == w)
+        S->tail = prev;
+    for (;;) {
+        c = zm_atomic_load(&S->count, zm_memord_acquire);
+        if (as_int(c) >= 0) {
+            S->pending--;
+            break;
+        }
+        if (zm_atomic_compare_exchange_weak(&S->count, &c, c + 1,
+                                            zm_memord_acq_rel, zm_memord_acquire)) {
+            granted = 0;
+            break;
+        }
+    }
+    zm_ticket_release(&S->lock);
+    return granted;
+}
+
+int zm_sem_init(struct zm_sem *S, int count)
+{
+    zm_atomic_store(&S->count, (unsigned) count, zm_memord_release);
+    zm_ticket_init(&S->lock);
+    S->head = NULL;
+    S->tail = NULL;
+    S->pending = 0;
+    return 0;
+}
+
+int zm_sem_destroy(struct zm_sem *S)
+{
+    zm_ticket_destroy(&S->lock);
+    return 0;
+}
+
+int zm_sem_wait(struct zm_sem *S) {
+    struct zm_sem_waiter w;
+    if (zm_likely(as_int(zm_atomic_fetch_add(&S->count, -1, zm_memord_acq_rel)) > 0))
+        return 0;
+    if (enqueue(S, &w))
+        park(&w);
+    return 0;
+}
+
+int zm_sem_trywait(struct zm_sem *S, int *success) {
+    unsigned c = zm_atomic_load(&S->count, zm_memord_acquire);
+    *success = 0;
+    while (as_int(c) > 0) {
+        if (zm_atomic_compare_exchange_weak(&S->count, &c, c - 1,
+                                            zm_memord_acq_rel, zm_memord_acquire)) {
+            *success = 1;
+            break;
+        }
+        c = zm_atomic_load(&S->count, zm_memord_acquire);
+    }
+    return 0;
+}
+
+/* Returns 1 if woken and 0 on timeout */
+static inline int park_until(struct zm_sem_waiter *w, long deadline) {
+#if ZM_SEM_PARK
+    return zm_wait_park_until(&w->state, ZM_COND_WAIT, deadline);
+#else
+    unsigned spins = 0;
+    while (zm_atomic_load(&w->state, zm_memord_acquire) == ZM_COND_WAIT) {
+        if (zm_wait_now_ns() >= deadline)
+            return 0;
+        zm_wait_spin(&spins);
+    }
+    return 1;
+#endif
+}
+
+int zm_sem_timedwait(struct zm_sem *S, long timeout_ns, int *success) {
+    struct zm_sem_waiter w;
+    long deadline;
+
+    *success = 1;
+    if (zm_likely(as_int(zm_atomic_fetch_add(&S->count, -1, zm_memord_acq_rel)) > 0))
+        return 0;
+    deadline = zm_wait_now_ns() + timeout_ns;
+    if (!enqueue(S, &w))
+        return 0;
+    if (!park_until(&w, deadline))
+        *success = cancel(S, &w);
+    return 0;
+}
+
+int zm_sem_post(struct zm_sem *S, int n) {
+    struct zm_sem_waiter *w, *first = NULL, *last = NULL, *next;
+    int old = as_int(zm_atomic_fetch_add(&S->count, (unsigned) n, zm_memord_acq_rel));
+    if (zm_likely(old >= 0))
+        return 0;
+
+    zm_ticket_acquire(&S->lock);
+    S->pending += (n < -old) ? n : -old;
+    while (S->pending > 0 && (w = S->head) != NULL) {
+        S->head = w->next;
+        if (S->head == NULL)
+            S->tail = NULL;
+        w->next = NULL;
+        if (last != NULL)
+            last->next = w;
+        else
+            first = w;
+        last = w;
+        S->pending--;
+    }
+    zm_ticket_release(&S->lock);
+
+    for (w = first; w != NULL; w = next) {
+        /* read the link before the waiter can return */
+        next = w->next;
+        wake(w);
+    }
+    return 0;
+}
+
+int zm_sem_getvalue(struct zm_sem *S, int *value) {
+    int c = as_int(zm_atomic_load(&S->count, zm_memord_acquire));
+    *value = (c > 0) ? c : 0;
+    return 0;
+}
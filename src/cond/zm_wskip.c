@@ -101,10 +101,11 @@ static inline int wait(struct zm_mcs *L, zm_mcs_qnode_t* I) {
     /* First, insert the qnode into the queue */
     enq(L,I, &wait);
     /* wait in line if necessary */
+    unsigned spins = 0;
     if (wait)
         while(zm_atomic_load(&I->status, zm_memord_acquire) != ZM_WAKE &&
               zm_atomic_load(&I->status, zm_memord_acquire) != ZM_RECYCLE)
-            ; /* SPIN */
+            zm_wait_spin(&spins);
 
     return 0;
 }
@@ -155,8 +156,9 @@ static inline int wake(struct zm_mcs *L, zm_mcs_qnode_t *I) {
                                              zm_memord_acq_rel,
                                              zm_memord_acquire))
             return 0;
+        unsigned spins = 0;
         while(zm_atomic_load(&cur_node->next, zm_memord_acquire) == ZM_NULL)
-            ; /* SPIN */
+            zm_wait_spin(&spins);
         zm_atomic_store(&((zm_mcs_qnode_t*)zm_atomic_load(&cur_node->next, zm_memord_acquire))->status, ZM_WAKE, zm_memord_release);
     }
     zm_atomic_store(&I->next, NULL, zm_memord_release);
@@ -7,17 +7,27 @@ prefixdir = ${prefix}
 
 zm_headers = \
 	include/common/zm_common.h \
+	include/wait/zm_wait.h \
+	include/wait/zm_ec.h \
+	include/wait/zm_ult.h \
 	include/queue/zm_queue_types.h \
 	include/queue/zm_glqueue.h \
 	include/queue/zm_swpqueue.h \
 	include/queue/zm_faqueue.h \
 	include/queue/zm_mpbqueue.h \
-	include/queue/zm_msqueue.h
+	include/queue/zm_rbqueue.h \
+	include/queue/zm_lcrqueue.h \
+	include/queue/zm_spscqueue.h \
+	include/queue/zm_msqueue.h \
+	include/queue/zm_iswpqueue.h \
+	include/queue/zm_imsqueue.h \
+	include/queue/zm_ifaqueue.h
 
 
 if ZM_HAVE_HWLOC
 zm_headers += \
 	include/lock/zm_lock.h \
+	include/lock/zm_lock_many.h \
 	include/lock/zm_lock_types.h \
 	include/lock/zm_ticket.h \
 	include/lock/zm_mcs.h \
@@ -26,16 +36,28 @@ zm_headers += \
 	include/lock/zm_mcsp.h \
 	include/lock/zm_hmcs.h \
 	include/lock/zm_hmpr.h \
+	include/lock/zm_rangelock.h \
+	include/lock/zm_locktable.h \
+	include/lock/zm_biased.h \
+	include/lock/zm_topo.h \
+	include/lock/zm_dlg.h \
+	include/lock/zm_ccsynch.h \
 	include/cond/zm_cond.h \
 	include/cond/zm_cond_types.h \
 	include/cond/zm_ccond.h \
+	include/cond/zm_fcond.h \
+	include/cond/zm_mcond.h \
+	include/cond/zm_ncond.h \
 	include/cond/zm_scount.h \
+	include/cond/zm_sem.h \
+	include/cond/zm_barrier.h \
 	include/cond/zm_wskip.h
 endif
 
 noinst_HEADERS = \
 	include/zm_config.h \
 	include/mem/zm_hzdptr.h \
+	include/mem/zm_pool.h \
 	include/list/zm_sdlist.h
 
 if ZM_EMBEDDED_MODE
@@ -0,0 +1,42 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_BARRIER_H
+#define _ZM_BARRIER_H
+
+#include "cond/zm_cond_types.h"
+
+/* Reusable barriers for a fixed set of nthreads threads, each passing its
+ * rank in [0, nthreads) to zm_barrier_wait:
+ *
+ * ZM_BARRIER_CENTRAL       - sense-reversing counter; O(P) misses on one line
+ * ZM_BARRIER_DISSEMINATION - ceil(log2 P) rounds of pairwise signals
+ * ZM_BARRIER_TOURNAMENT    - static binary tree; winners climb, losers wait
+ *                            for the wake-up sent down the tree
+ * ZM_BARRIER_HIERARCHICAL  - combining tree following the HMCS levels of the
+ *                            topology; assumes rank i runs on hardware
+ *                            thread i, as in a compact binding
+ *
+ * Waiters spin on a flag for ZM_WAIT_SPIN_BUDGET rounds and then park
+ * through the block hook. zm_barrier_init returns -1 if out of memory. */
+
+#define ZM_BARRIER_CENTRAL       0
+#define ZM_BARRIER_DISSEMINATION 1
+#define ZM_BARRIER_TOURNAMENT    2
+#define ZM_BARRIER_HIERARCHICAL  3
+
+int zm_barrier_init(zm_barrier_t *B, int kind, int nthreads);
+int zm_barrier_destroy(zm_barrier_t *B);
+int zm_barrier_wait(zm_barrier_t B, int tid);
+
+/* Single-use count-down latch: zm_latch_wait returns once count_down has
+ * been called for a total of count. */
+int zm_latch_init(struct zm_latch *C, int count);
+int zm_latch_destroy(struct zm_latch *C);
+int zm_latch_count_down(struct zm_latch *C, int n);
+int zm_latch_wait(struct zm_latch *C);
+int zm_latch_trywait(struct zm_latch *C, int *success);
+
+#endif /* _ZM_BARRIER_H */
@@ -15,12 +15,65 @@
 
 struct zm_ccond {
     zm_atomic_uint_t flag;
+    zm_atomic_uint_t nblocked; /* waiters parked through the block hook */
 };
 
+/* waiter of a futex-backed condition variable, lives on the waiter's stack */
+struct zm_fcond_waiter {
+    zm_atomic_uint_t state;
+    struct zm_fcond_waiter *next;
+};
+
+struct zm_fcond {
+    zm_ticket_t lock; /* protects the waiter queue */
+    struct zm_fcond_waiter *head;
+    struct zm_fcond_waiter *tail;
+};
+
+/* waiter of a wait-morphing condition variable, lives on the waiter's stack */
+struct zm_mcond_waiter {
+    zm_mcs_t lock;
+    zm_mcs_qnode_t *qnode;    /* node the waiter released the lock through */
+    zm_atomic_uint_t state;
+    struct zm_mcond_waiter *next;
+};
+
+/* the waiter queue is protected by the associated MCS lock */
+struct zm_mcond {
+    struct zm_mcond_waiter *head;
+    struct zm_mcond_waiter *tail;
+};
+
+/* topology-aware condition variable, handle to a private structure */
+typedef zm_ptr_t zm_ncond_t;
+
 struct zm_scount {
     zm_atomic_uint_t count;
     struct zm_ccond cvar;
 };
 
+/* barrier, handle to a private structure */
+typedef zm_ptr_t zm_barrier_t;
+
+struct zm_latch {
+    zm_atomic_uint_t count;
+    zm_atomic_uint_t nparked;
+};
+
+/* waiter of a semaphore, lives on the waiter's stack */
+struct zm_sem_waiter {
+    zm_atomic_uint_t state;
+    struct zm_sem_waiter *next;
+};
+
+struct zm_sem {
+    /* permits minus registered waiters, as a signed int */
+    zm_atomic_uint_t count __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    zm_ticket_t lock __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    struct zm_sem_waiter *head;
+    struct zm_sem_waiter *tail;
+    int pending; /* permits handed to waiters that are not queued yet */
+};
+
 
 #endif /* _IZEM_COND_TYPES_H */
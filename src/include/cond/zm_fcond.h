@@ -0,0 +1,23 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_FCOND_H
+#define _ZM_FCOND_H
+
+#include "cond/zm_cond_types.h"
+
+/* Condition variable with a FIFO queue of waiters. Each waiter spins on its
+ * own queue entry for ZM_WAIT_SPIN_BUDGET rounds and then parks through the
+ * block hook (a futex by default). Signal wakes the oldest waiter and
+ * broadcast wakes all the current ones. */
+
+int zm_fcond_init(struct zm_fcond *C);
+int zm_fcond_destroy(struct zm_fcond *C);
+int zm_fcond_wait(struct zm_fcond *C, zm_lock_t *L);
+int zm_fcond_wait_c(struct zm_fcond *C, zm_lock_t *L, zm_lock_ctxt_t *ctxt);
+int zm_fcond_signal(struct zm_fcond *C);
+int zm_fcond_bcast(struct zm_fcond *C);
+
+#endif /* _ZM_FCOND_H */
@@ -0,0 +1,25 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_MCOND_H
+#define _ZM_MCOND_H
+
+#include "cond/zm_cond_types.h"
+
+/* Wait-morphing condition variable associated with an MCS lock. Signal and
+ * broadcast move waiters from the condition variable straight into the
+ * queue of the lock, so a woken waiter returns holding the lock without
+ * contending for it again. Signal and broadcast must be called with the
+ * lock held; the waiters get the lock after the signaler releases it, in
+ * FIFO order. */
+
+int zm_mcond_init(struct zm_mcond *C);
+int zm_mcond_destroy(struct zm_mcond *C);
+int zm_mcond_wait(struct zm_mcond *C, zm_mcs_t L);
+int zm_mcond_wait_c(struct zm_mcond *C, zm_mcs_t L, zm_mcs_qnode_t *I);
+int zm_mcond_signal(struct zm_mcond *C);
+int zm_mcond_bcast(struct zm_mcond *C);
+
+#endif /* _ZM_MCOND_H */
@@ -0,0 +1,28 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_NCOND_H
+#define _ZM_NCOND_H
+
+#include "cond/zm_cond_types.h"
+
+/* Topology-aware condition variable. Waiters are kept in one FIFO sublist
+ * per node of the level right below the machine in the HMCS hierarchy
+ * (typically a socket), and park like in zm_fcond. Signal wakes the oldest
+ * waiter of the signaler's node, which is the lock holder's node when
+ * signaling under the lock. After ZM_NCOND_LOCAL_LIMIT consecutive local
+ * wake-ups while remote waiters exist, it wakes the oldest waiter overall
+ * so that remote waiters are not starved. Broadcast wakes the local waiters
+ * first. Threads not bound to a single hardware thread use the first
+ * sublist. zm_ncond_init returns -1 if out of memory. */
+
+int zm_ncond_init(zm_ncond_t *C);
+int zm_ncond_destroy(zm_ncond_t *C);
+int zm_ncond_wait(zm_ncond_t C, zm_lock_t *L);
+int zm_ncond_wait_c(zm_ncond_t C, zm_lock_t *L, zm_lock_ctxt_t *ctxt);
+int zm_ncond_signal(zm_ncond_t C);
+int zm_ncond_bcast(zm_ncond_t C);
+
+#endif /* _ZM_NCOND_H */
@@ -0,0 +1,30 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_SEM_H
+#define _ZM_SEM_H
+
+#include "cond/zm_cond_types.h"
+
+/* Counting semaphore. Waiting and posting take one atomic operation when
+ * no thread has to wait. Otherwise waiters queue in FIFO order, spin on
+ * their own entry and then, if ZM_SEM_PARK is nonzero, park through the
+ * block hook (a futex by default). zm_sem_post(S, n) hands up to n permits
+ * to the oldest waiters. zm_sem_timedwait gives up after timeout_ns
+ * nanoseconds; timed waiters park with a timeout. */
+
+#ifndef ZM_SEM_PARK
+#define ZM_SEM_PARK 1
+#endif
+
+int zm_sem_init(struct zm_sem *S, int count);
+int zm_sem_destroy(struct zm_sem *S);
+int zm_sem_wait(struct zm_sem *S);
+int zm_sem_trywait(struct zm_sem *S, int *success);
+int zm_sem_timedwait(struct zm_sem *S, long timeout_ns, int *success);
+int zm_sem_post(struct zm_sem *S, int n);
+int zm_sem_getvalue(struct zm_sem *S, int *value);
+
+#endif /* _ZM_SEM_H */
@@ -0,0 +1,26 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_BIASED_H
+#define _ZM_BIASED_H
+#include "lock/zm_lock_types.h"
+#include "lock/zm_ticket.h"
+
+/* Biased lock: the first thread to acquire the lock becomes its owner and
+ * later acquires and releases it with plain loads and stores. Any other
+ * thread revokes the bias through a handshake with the owner, then everyone
+ * goes through the underlying ticket lock. A thread that keeps acquiring the
+ * revoked lock alone gets the bias back. */
+
+int zm_biased_init(zm_biased_t *);
+int zm_biased_destroy(zm_biased_t *);
+int zm_biased_acquire(zm_biased_t *);
+int zm_biased_tryacq(zm_biased_t *, int*);
+int zm_biased_release(zm_biased_t *);
+
+/* Counters are only consistent while no thread uses the lock */
+int zm_biased_get_stats(zm_biased_t *, zm_biased_stats_t *);
+
+#endif /* _ZM_BIASED_H */
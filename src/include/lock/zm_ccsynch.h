@@ -0,0 +1,39 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_CCSYNCH_H
+#define _ZM_CCSYNCH_H
+#include "lock/zm_lock_types.h"
+
+/* Combining synchronization (CC-Synch and H-Synch by Fatourou and
+ * Kallimanis). A thread announces its operation by appending it to an
+ * MCS-like list of nodes; the thread at the head of the list, the combiner,
+ * runs up to ZM_COMBINING_BATCH queued operations on behalf of the others
+ * and hands the combiner role to the next waiting thread.
+ *
+ * Each thread owns one node per instance, obtained with *_node_alloc. Nodes
+ * are recycled across operations, so the node passed to apply may be
+ * replaced by another one; *_node_free must be given the current one.
+ * *_init and *_node_alloc return -1 if out of memory. */
+
+int zm_ccsynch_init(zm_ccsynch_t *);
+int zm_ccsynch_destroy(zm_ccsynch_t *);
+int zm_ccsynch_node_alloc(zm_ccsynch_node_t **);
+int zm_ccsynch_node_free(zm_ccsynch_node_t *);
+/* Run fn(arg) under mutual exclusion; ret may be NULL */
+int zm_ccsynch_apply(zm_ccsynch_t *, zm_ccsynch_node_t **,
+                     zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret);
+
+/* H-Synch keeps one CC-Synch list per node of the outermost level of the
+ * HMCS hierarchy below the machine (typically a socket); the combiners of
+ * the lists then take a global lock. Threads must be bound to a single
+ * hardware thread to be assigned to their list, and are otherwise assigned
+ * to the first one. */
+int zm_hsynch_init(zm_hsynch_t *);
+int zm_hsynch_destroy(zm_hsynch_t *);
+int zm_hsynch_apply(zm_hsynch_t, zm_ccsynch_node_t **,
+                    zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret);
+
+#endif /* _ZM_CCSYNCH_H */
@@ -0,0 +1,29 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_DLG_H
+#define _ZM_DLG_H
+#include "lock/zm_lock_types.h"
+
+/* Critical-section delegation: a dedicated server thread runs the critical
+ * sections on behalf of the clients, so the protected data and the lock
+ * never move between cores. Each registered client owns a request and a
+ * response cache line; the server polls the requests in batches and writes
+ * back the results.
+ *
+ * The server is bound to the last hardware thread of the package of the
+ * thread calling zm_dlg_init, or to the hardware thread whose logical index
+ * is given by ZM_DLG_SERVER_PU. The slots are first touched by the server.
+ * zm_dlg_init returns -1 if out of memory or if the server thread cannot
+ * be created. */
+
+int zm_dlg_init(zm_dlg_t *, int max_clients);
+int zm_dlg_destroy(zm_dlg_t *);
+/* Get a slot for the calling thread; a client must not be shared */
+int zm_dlg_register(zm_dlg_t, zm_dlg_client_t *);
+/* Run fn(arg) on the server and wait for it; ret may be NULL */
+int zm_dlg_execute(zm_dlg_client_t, zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret);
+
+#endif /* _ZM_DLG_H */
@@ -14,4 +14,11 @@ int zm_hmcs_tryacq(zm_hmcs_t, int*);
 int zm_hmcs_release(zm_hmcs_t);
 int zm_hmcs_nowaiters(zm_hmcs_t);
 
+/* Context-full routines: the caller provides the queue node, so that
+ * user-level threads sharing a hardware thread do not share one */
+int zm_hmcs_acquire_c(zm_hmcs_t, zm_hmcs_qnode_t*);
+int zm_hmcs_tryacq_c(zm_hmcs_t, zm_hmcs_qnode_t*, int*);
+int zm_hmcs_release_c(zm_hmcs_t, zm_hmcs_qnode_t*);
+int zm_hmcs_nowaiters_c(zm_hmcs_t, zm_hmcs_qnode_t*);
+
 #endif /* _ZM_HMCS_H */
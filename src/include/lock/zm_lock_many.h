@@ -0,0 +1,147 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_LOCK_MANY_H
+#define _ZM_LOCK_MANY_H
+
+#include "lock/zm_lock.h"
+
+/* Multi-lock acquisition
+ *
+ * Acquire or release n locks at once. The lock array is sorted in place by
+ * address (the canonical order) and duplicates are taken only once, so
+ * concurrent multi-lock acquisitions cannot deadlock. The same array (and
+ * context array for the context-full variants, where ctxts[i] is the
+ * context used for locks[i]) must be passed to the release routine.
+ * Locks that support trylock are acquired with trylock first: on failure
+ * the already held locks are dropped and the acquisition is retried after
+ * an exponential backoff, rather than waiting in a queue while holding
+ * other locks. After ZM_LOCK_MANY_MAX_RETRIES failed rounds the remaining
+ * locks are acquired in order with blocking acquisitions. */
+
+#define ZM_LOCK_MANY_MAX_RETRIES 8
+#define ZM_LOCK_MANY_BACKOFF_MIN 16
+#define ZM_LOCK_MANY_BACKOFF_MAX 4096
+
+static inline void zm_lock_many_sort(zm_lock_t *locks[], int n) {
+    int i, j;
+    for (i = 1; i < n; i++) {
+        zm_lock_t *l = locks[i];
+        for (j = i; j > 0 && locks[j-1] > l; j--)
+            locks[j] = locks[j-1];
+        locks[j] = l;
+    }
+}
+
+static inline void zm_lock_many_backoff(unsigned *backoff) {
+    unsigned i;
+    for (i = 0; i < *backoff; i++)
+        zm_cpu_relax();
+    if (*backoff < ZM_LOCK_MANY_BACKOFF_MAX)
+        *backoff *= 2;
+}
+
+#if defined(zm_lock_tryacq_c)
+
+static inline int zm_lock_acquire_many_c(zm_lock_t *locks[], zm_lock_ctxt_t ctxts[], int n) {
+    int i, j, acq, retries = 0;
+    unsigned backoff = ZM_LOCK_MANY_BACKOFF_MIN;
+    zm_lock_many_sort(locks, n);
+retry:
+    for (i = 0; i < n; i++) {
+        if (i > 0 && locks[i] == locks[i-1])
+            continue;
+        zm_lock_tryacq_c(locks[i], &ctxts[i], &acq);
+        if (acq)
+            continue;
+        if (i == 0 || retries >= ZM_LOCK_MANY_MAX_RETRIES) {
+            /* nothing held or out of retries: wait in order */
+            zm_lock_acquire_c(locks[i], &ctxts[i]);
+            continue;
+        }
+        for (j = i - 1; j >= 0; j--)
+            if (j == 0 || locks[j] != locks[j-1])
+                zm_lock_release_c(locks[j], &ctxts[j]);
+        retries++;
+        zm_lock_many_backoff(&backoff);
+        goto retry;
+    }
+    return 0;
+}
+
+#else
+
+static inline int zm_lock_acquire_many_c(zm_lock_t *locks[], zm_lock_ctxt_t ctxts[], int n) {
+    int i;
+    zm_lock_many_sort(locks, n);
+    for (i = 0; i < n; i++)
+        if (i == 0 || locks[i] != locks[i-1])
+            zm_lock_acquire_c(locks[i], &ctxts[i]);
+    return 0;
+}
+
+#endif /* zm_lock_tryacq_c */
+
+static inline int zm_lock_release_many_c(zm_lock_t *locks[], zm_lock_ctxt_t ctxts[], int n) {
+    int i;
+    for (i = n - 1; i >= 0; i--)
+        if (i == 0 || locks[i] != locks[i-1])
+            zm_lock_release_c(locks[i], &ctxts[i]);
+    return 0;
+}
+
+#if defined(zm_lock_acquire)
+
+#if defined(zm_lock_tryacq)
+
+static inline int zm_lock_acquire_many(zm_lock_t *locks[], int n) {
+    int i, j, acq, retries = 0;
+    unsigned backoff = ZM_LOCK_MANY_BACKOFF_MIN;
+    zm_lock_many_sort(locks, n);
+retry:
+    for (i = 0; i < n; i++) {
+        if (i > 0 && locks[i] == locks[i-1])
+            continue;
+        zm_lock_tryacq(locks[i], &acq);
+        if (acq)
+            continue;
+        if (i == 0 || retries >= ZM_LOCK_MANY_MAX_RETRIES) {
+            zm_lock_acquire(locks[i]);
+            continue;
+        }
+        for (j = i - 1; j >= 0; j--)
+            if (j == 0 || locks[j] != locks[j-1])
+                zm_lock_release(locks[j]);
+        retries++;
+        zm_lock_many_backoff(&backoff);
+        goto retry;
+    }
+    return 0;
+}
+
+#else
+
+static inline int zm_lock_acquire_many(zm_lock_t *locks[], int n) {
+    int i;
+    zm_lock_many_sort(locks, n);
+    for (i = 0; i < n; i++)
+        if (i == 0 || locks[i] != locks[i-1])
+            zm_lock_acquire(locks[i]);
+    return 0;
+}
+
+#endif /* zm_lock_tryacq */
+
+static inline int zm_lock_release_many(zm_lock_t *locks[], int n) {
+    int i;
+    for (i = n - 1; i >= 0; i--)
+        if (i == 0 || locks[i] != locks[i-1])
+            zm_lock_release(locks[i]);
+    return 0;
+}
+
+#endif /* zm_lock_acquire */
+
+#endif /* _ZM_LOCK_MANY_H */
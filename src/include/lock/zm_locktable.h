@@ -0,0 +1,38 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_LOCKTABLE_H
+#define _ZM_LOCKTABLE_H
+#include "lock/zm_lock_types.h"
+
+/* Striped lock table: a key (typically the address of the protected object)
+ * is hashed to one of a fixed number of cache-line-padded stripes, each
+ * protected by the lock selected at configure time (--with-locktable-lock).
+ * Distinct keys may share a stripe, so holding the stripe of a key protects
+ * every object that hashes to it. Several stripes must be taken with
+ * zm_locktable_acquire_many, which acquires them in increasing stripe order
+ * to avoid deadlocks.
+ *
+ * zm_locktable_init returns -1 if out of memory. The *_many routines
+ * return -1, without taking or releasing any stripe, if they cannot
+ * allocate the list of stripes of more than 64 keys. */
+
+int zm_locktable_init(zm_locktable_t *, unsigned nstripes);
+int zm_locktable_destroy(zm_locktable_t *);
+
+int zm_locktable_acquire(zm_locktable_t *, zm_ptr_t key);
+int zm_locktable_release(zm_locktable_t *, zm_ptr_t key);
+
+int zm_locktable_acquire_many(zm_locktable_t *, const zm_ptr_t keys[], int n);
+int zm_locktable_release_many(zm_locktable_t *, const zm_ptr_t keys[], int n);
+
+/* Fibonacci hashing: the upper bits of the product are the best mixed */
+static inline unsigned zm_locktable_stripe(zm_locktable_t *T, zm_ptr_t key) {
+    if (T->shift >= 64)
+        return 0;
+    return (unsigned)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> T->shift);
+}
+
+#endif /* _ZM_LOCKTABLE_H */
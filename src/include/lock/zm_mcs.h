@@ -20,5 +20,31 @@ int zm_mcs_tryacq_c(zm_mcs_t, zm_mcs_qnode_t*, int*);
 int zm_mcs_release_c(zm_mcs_t, zm_mcs_qnode_t*);
 int zm_mcs_nowaiters_c(zm_mcs_t, zm_mcs_qnode_t *);
 
+/* Wait morphing support. zm_mcs_local_qnode returns the node used by the
+ * context-less routines of the calling thread. zm_mcs_requeue_c, called by
+ * the lock holder, appends a node whose owner released the lock through it
+ * and now waits for its status to become ZM_UNLOCKED. */
+int zm_mcs_local_qnode(zm_mcs_t, zm_mcs_qnode_t **);
+int zm_mcs_requeue_c(zm_mcs_t, zm_mcs_qnode_t *);
+
+/* Asynchronous API: cb(arg) runs as a critical section once the lock is
+ * granted, and the lock is released when it returns. If the lock is free,
+ * cb runs before zm_mcs_acquire_async returns; otherwise the call returns
+ * at once and cb is run by the thread releasing the lock to it, or by the
+ * thread polling the inbox bound to the calling thread, if any. The node
+ * of zm_mcs_acquire_async_c must stay valid until cb has run.
+ * zm_mcs_acquire_async returns -1, without queueing, if it cannot allocate
+ * a node. */
+int zm_mcs_acquire_async(zm_mcs_t, zm_lock_cb_t cb, zm_ptr_t arg);
+int zm_mcs_acquire_async_c(zm_mcs_t, zm_mcs_anode_t*, zm_lock_cb_t cb, zm_ptr_t arg);
+
+int zm_mcs_inbox_init(zm_mcs_inbox_t *);
+int zm_mcs_inbox_destroy(zm_mcs_inbox_t *);
+/* Have the continuations of the calling thread delivered to the inbox;
+ * NULL goes back to running them in the releasing thread */
+int zm_mcs_inbox_bind(zm_mcs_inbox_t *);
+/* Run the continuations delivered so far in FIFO order */
+int zm_mcs_inbox_poll(zm_mcs_inbox_t *, int *nran);
+
 
 #endif /* _ZM_MCS_H */
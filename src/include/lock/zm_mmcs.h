@@ -9,8 +9,21 @@
 
 int zm_mmcs_init(zm_mmcs_t *);
 int zm_mmcs_destroy(zm_mmcs_t *);
+
+/* Memorizing API: zm_mmcs_release releases the lock whatever the recursion
+ * depth of the holder and returns its context. The holder can reacquire the
+ * lock either with that context or with a NULL context, which restores the
+ * saved context and recursion depth. The saved context is kept per thread;
+ * zm_mmcs_acquire with a NULL context returns -1 if the calling thread has
+ * none for this lock, and zm_mmcs_release returns -1, keeping the lock, if
+ * it cannot save one. */
 int zm_mmcs_acquire(zm_mmcs_t *, zm_mcs_qnode_t*);
 int zm_mmcs_release(zm_mmcs_t *, zm_mcs_qnode_t**);
 int zm_mmcs_nowaiters(zm_mmcs_t *);
 
+/* Reentrant API: an acquisition by the current holder only increments the
+ * recursion depth; the lock is released when the depth drops to zero. */
+int zm_mmcs_acquire_c(zm_mmcs_t *, zm_mcs_qnode_t*);
+int zm_mmcs_release_c(zm_mmcs_t *, zm_mcs_qnode_t*);
+
 #endif /* _ZM_MMCS_H */
@@ -0,0 +1,27 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_RANGELOCK_H
+#define _ZM_RANGELOCK_H
+#include "lock/zm_lock_types.h"
+
+/* Range lock: protects the half-open interval [start, end) of a shared
+ * resource (e.g. a file or an address range). Requests are kept in arrival
+ * order in a lock-free list; a request waits only for older requests that
+ * overlap with it and conflict in mode (at least one writer), which gives
+ * FIFO fairness among overlapping ranges while disjoint ranges and
+ * overlapping readers proceed in parallel. The returned node identifies
+ * the acquisition and must be passed to zm_rangelock_release. The init and
+ * acquire routines return -1 if they cannot allocate a node; the range is
+ * then not held. */
+
+int zm_rangelock_init(zm_rangelock_t *);
+int zm_rangelock_destroy(zm_rangelock_t *);
+
+int zm_rangelock_acquire(zm_rangelock_t *, zm_ulong_t start, zm_ulong_t end, zm_rlnode_t **);
+int zm_rangelock_acquire_rd(zm_rangelock_t *, zm_ulong_t start, zm_ulong_t end, zm_rlnode_t **);
+int zm_rangelock_release(zm_rangelock_t *, zm_rlnode_t *);
+
+#endif /* _ZM_RANGELOCK_H */
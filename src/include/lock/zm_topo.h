@@ -0,0 +1,45 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_TOPO_H
+#define _ZM_TOPO_H
+#include <hwloc.h>
+#include "common/zm_common.h"
+
+/* Topology helpers shared by the locks that place or identify threads
+ * with hwloc. All of them query the binding of the calling thread. */
+
+/* Number of hardware threads the calling thread is bound to */
+int zm_topo_nbound_pus(hwloc_topology_t);
+/* Logical index of the first hardware thread the calling thread is bound to */
+int zm_topo_hwthread_id(hwloc_topology_t);
+/* Package (socket) of the first hardware thread the calling thread is bound
+ * to, or the first package if the topology has none for it */
+hwloc_obj_t zm_topo_package(hwloc_topology_t);
+/* Levels of the lock hierarchy used by HMCS, from the innermost to the
+ * machine level. Sets the number of hardware threads and allocates the
+ * number of hardware threads per node of each level. The levels can be
+ * chosen with ZM_HMCS_MAX_LEVELS and ZM_HMCS_EXPLICIT_LEVELS. */
+int zm_topo_hierarchy(hwloc_topology_t, int *max_threads, int **particip_per_level);
+/* Clusters of hardware threads, the nodes of the level of that hierarchy
+ * right below the machine, for objects that keep one list per cluster.
+ * Sets the number of hardware threads per cluster and returns the number
+ * of clusters. */
+int zm_topo_clusters(hwloc_topology_t, int *cluster_size);
+/* Hardware thread the calling thread is bound to, -1 if more than one */
+int zm_topo_bound_pu(hwloc_topology_t);
+
+/* zm_topo_bound_pu of the calling thread; -2 until first needed */
+extern zm_thread_local int zm_topo_pu;
+
+/* Cluster of the calling thread, 0 if it is not bound to a single
+ * hardware thread */
+static inline int zm_topo_cluster(hwloc_topology_t topo, int cluster_size, int nclusters) {
+    if (zm_unlikely(zm_topo_pu == -2))
+        zm_topo_pu = zm_topo_bound_pu(topo);
+    return (zm_topo_pu >= 0) ? (zm_topo_pu / cluster_size) % nclusters : 0;
+}
+
+#endif /* _ZM_TOPO_H */
@@ -117,6 +117,21 @@ static inline void zm_hzdptr_retire(zm_ptr_t node) {
     }
 }
 
+/* Tells whether any thread holds a hazard pointer to ptr. Objects that
+ * manage their own reclamation use it before freeing ptr */
+static inline int zm_hzdptr_hazardous(zm_ptr_t ptr) {
+    int i;
+    zm_hzdptr_lnode_t *cur_hplnode = (zm_hzdptr_lnode_t*) zm_atomic_load(&zm_hzdptr_list, zm_memord_acquire);
+    while((zm_ptr_t)cur_hplnode != ZM_NULL) {
+        for(i=0; i<ZM_HZDPTR_NUM; i++) {
+            if(cur_hplnode->hzdptrs[i] == ptr)
+                return 1;
+        }
+        cur_hplnode = (zm_hzdptr_lnode_t*)zm_atomic_load(&cur_hplnode->next, zm_memord_acquire);
+    }
+    return 0;
+}
+
 static inline zm_hzdptr_t* zm_hzdptr_get(void) {
     if(zm_unlikely(zm_my_hplnode == NULL))
         zm_hzdptr_allocate();
@@ -0,0 +1,94 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_POOL_H_
+#define _ZM_POOL_H_
+#include <stddef.h>
+#include "common/zm_common.h"
+
+/* Pools of fixed-size objects, such as queue nodes, with per-thread
+ * magazines and a global depot (Bonwick and Adams, USENIX ATC'01).
+ *
+ * Each thread caches two magazines of objects per pool and allocates and
+ * frees objects from them without synchronization. When both are empty
+ * (full), the thread trades one with the depot, a lock-free array of
+ * magazine slots. The system allocator is only called when the depot has
+ * no objects left, or no room for more. zm_pool_alloc returns NULL if the
+ * system allocator fails.
+ *
+ * Pools used beyond the first ZM_POOL_MAX get no magazines: their objects
+ * come straight from the system allocator. */
+
+#define ZM_POOL_MAGSIZE     64  /* objects per magazine */
+#define ZM_POOL_DEPOTSIZE   256 /* magazine slots in the depot */
+#define ZM_POOL_MAX         16  /* pools with per-thread magazines */
+
+typedef struct zm_pool      zm_pool_t;
+typedef struct zm_poolmag   zm_poolmag_t;
+typedef struct zm_poolcache zm_poolcache_t;
+
+struct zm_poolmag {
+    int count;
+    void *objs[ZM_POOL_MAGSIZE];
+};
+
+struct zm_pool {
+    size_t objsize;
+    size_t align;
+    zm_atomic_uint_t id;        /* index of the per-thread cache + 1; 0 until first use */
+    zm_atomic_ptr_t full[ZM_POOL_DEPOTSIZE] ZM_ALLIGN_TO_CACHELINE;  /* magazines with objects */
+    zm_atomic_ptr_t empty[ZM_POOL_DEPOTSIZE] ZM_ALLIGN_TO_CACHELINE; /* magazines without */
+};
+
+/* id of the pools without magazines */
+#define ZM_POOL_UNCACHED    (ZM_POOL_MAX + 1)
+
+/* per-thread magazines of a pool */
+struct zm_poolcache {
+    zm_poolmag_t *loaded;
+    zm_poolmag_t *prev;
+    zm_poolmag_t *retired;      /* objects waiting for hazard pointers to clear */
+};
+
+/* Pools are meant to be statically allocated */
+#define ZM_POOL_INITIALIZER(size, alignment) { .objsize = (size), .align = (alignment) }
+
+/* the last cache, never loaded, is shared by the pools without magazines */
+extern zm_thread_local zm_poolcache_t zm_pool_caches[ZM_POOL_UNCACHED];
+
+void *zm_pool_alloc_slow(zm_pool_t *pool);
+void zm_pool_free_slow(zm_pool_t *pool, void *obj);
+unsigned zm_pool_register(zm_pool_t *pool);
+
+/* Free obj once no hazard pointer (mem/zm_hzdptr.h) refers to it */
+void zm_pool_retire(zm_pool_t *pool, void *obj);
+
+/* Number of calls to the system allocator made by all the pools */
+int zm_pool_stats(zm_ulong_t *nmallocs, zm_ulong_t *nfrees);
+
+static inline zm_poolcache_t *zm_pool_cache(zm_pool_t *pool) {
+    unsigned id = zm_atomic_load(&pool->id, zm_memord_acquire);
+    if (zm_unlikely(id == 0))
+        id = zm_pool_register(pool);
+    return &zm_pool_caches[id - 1];
+}
+
+static inline void *zm_pool_alloc(zm_pool_t *pool) {
+    zm_poolmag_t *mag = zm_pool_cache(pool)->loaded;
+    if (zm_likely(mag != NULL && mag->count > 0))
+        return mag->objs[--mag->count];
+    return zm_pool_alloc_slow(pool);
+}
+
+static inline void zm_pool_free(zm_pool_t *pool, void *obj) {
+    zm_poolmag_t *mag = zm_pool_cache(pool)->loaded;
+    if (zm_likely(mag != NULL && mag->count < ZM_POOL_MAGSIZE)) {
+        mag->objs[mag->count++] = obj;
+        return;
+    }
+    zm_pool_free_slow(pool, obj);
+}
+
+#endif /* _ZM_POOL_H_ */
@@ -9,8 +9,18 @@
 #include <stdio.h>
 #include "queue/zm_queue_types.h"
 
+/* faqueue: wait-free MPMC queue based on fetch-and-add. Each thread gets a
+ * handle in the queue on first use; handles are freed by destroy. */
+
 int zm_faqueue_init(zm_faqueue_t *);
+int zm_faqueue_destroy(zm_faqueue_t *);
 int zm_faqueue_enqueue(zm_faqueue_t* q, void *data);
 int zm_faqueue_dequeue(zm_faqueue_t* q, void **data);
+int zm_faqueue_dequeue_wait(zm_faqueue_t* q, void **data);
+int zm_faqueue_enqueue_bulk(zm_faqueue_t* q, void *data[], int n);
+int zm_faqueue_dequeue_bulk(zm_faqueue_t* q, void *data[], int max, int *count);
+
+/* Bytes of segment memory the queue holds, spare segments included */
+int zm_faqueue_footprint(zm_faqueue_t *q, zm_ulong_t *bytes);
 
 #endif /* _ZM_FAQUEUE_H */
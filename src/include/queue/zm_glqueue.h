@@ -10,10 +10,14 @@
 #include "queue/zm_queue_types.h"
 
 /* glqueue: concurrent queue where both enqueue and dequeue operations
- * are protected with the same global lock (thus, the gl prefix) */
+ * are protected with the same global lock (thus, the gl prefix). The init
+ * and enqueue routines return -1 if out of memory. */
 
 int zm_glqueue_init(zm_glqueue_t *);
 int zm_glqueue_enqueue(zm_glqueue_t* q, void *data);
 int zm_glqueue_dequeue(zm_glqueue_t* q, void **data);
+int zm_glqueue_dequeue_wait(zm_glqueue_t* q, void **data);
+int zm_glqueue_enqueue_bulk(zm_glqueue_t* q, void *data[], int n);
+int zm_glqueue_dequeue_bulk(zm_glqueue_t* q, void *data[], int max, int *count);
 
 #endif /* _ZM_GLQUEUE_H */
@@ -0,0 +1,35 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_IFAQUEUE_H
+#define _ZM_IFAQUEUE_H
+#include "queue/zm_faqueue.h"
+
+/* ifaqueue: the faqueue with the element interface of the other intrusive
+ * queues. The faqueue stores element pointers in its cells and never
+ * allocates per element, so the link itself is not written; it only names
+ * the element. */
+
+static inline int zm_ifaqueue_init(zm_ifaqueue_t *q) {
+    return zm_faqueue_init(&q->faqueue);
+}
+
+static inline int zm_ifaqueue_destroy(zm_ifaqueue_t *q) {
+    return zm_faqueue_destroy(&q->faqueue);
+}
+
+static inline int zm_ifaqueue_enqueue(zm_ifaqueue_t* q, zm_qlink_t *link) {
+    return zm_faqueue_enqueue(&q->faqueue, (void*)link);
+}
+
+static inline int zm_ifaqueue_dequeue(zm_ifaqueue_t* q, zm_qlink_t **link) {
+    return zm_faqueue_dequeue(&q->faqueue, (void**)link);
+}
+
+static inline int zm_ifaqueue_dequeue_wait(zm_ifaqueue_t* q, zm_qlink_t **link) {
+    return zm_faqueue_dequeue_wait(&q->faqueue, (void**)link);
+}
+
+#endif /* _ZM_IFAQUEUE_H */
@@ -0,0 +1,37 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_IMSQUEUE_H
+#define _ZM_IMSQUEUE_H
+#include <stdlib.h>
+#include <stdio.h>
+#include "queue/zm_queue_types.h"
+
+/* imsqueue: intrusive version of the msqueue (MPMC). Elements embed a
+ * zm_qlink_t; nothing is allocated.
+ *
+ * As in the msqueue, the element returned by dequeue stays in the queue as
+ * its dummy node until the next dequeue, and other dequeuers may still read
+ * its link after that. The queue calls dispose on the link once no thread
+ * can use it anymore (mem/zm_hzdptr.h). Only then may the element be
+ * enqueued again or freed; dispose may run while the dequeuer still works
+ * on the element. Links waiting to be disposed are kept per thread and
+ * handed back when that list fills up or the thread finds the queue empty;
+ * zm_imsqueue_reclaim disposes those of the calling thread that are safe,
+ * e.g. before the thread exits. With a NULL dispose, elements are never
+ * handed back. zm_imsqueue_destroy, called once the queue is empty and no
+ * longer used, hands back the last dequeued element and the retired links
+ * of the calling thread that are safe.
+ *
+ * dequeue returns 0 and sets *link to NULL if the queue is empty. */
+
+int zm_imsqueue_init(zm_imsqueue_t *, zm_qlink_dispose_t dispose);
+int zm_imsqueue_destroy(zm_imsqueue_t *);
+int zm_imsqueue_enqueue(zm_imsqueue_t* q, zm_qlink_t *link);
+int zm_imsqueue_dequeue(zm_imsqueue_t* q, zm_qlink_t **link);
+int zm_imsqueue_dequeue_wait(zm_imsqueue_t* q, zm_qlink_t **link);
+int zm_imsqueue_reclaim(void);
+
+#endif /* _ZM_IMSQUEUE_H */
@@ -0,0 +1,24 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_ISWPQUEUE_H
+#define _ZM_ISWPQUEUE_H
+#include <stdlib.h>
+#include <stdio.h>
+#include "queue/zm_queue_types.h"
+
+/* iswpqueue: intrusive version of the swpqueue (MPSC). Elements embed a
+ * zm_qlink_t, which enqueue links into the queue; nothing is allocated.
+ * The link belongs to the queue from enqueue until dequeue returns it.
+ *
+ * dequeue returns 0 and sets *link to NULL if the queue is empty, or if
+ * the only element is still being linked by its producer. */
+
+int zm_iswpqueue_init(zm_iswpqueue_t *);
+int zm_iswpqueue_enqueue(zm_iswpqueue_t* q, zm_qlink_t *link);
+int zm_iswpqueue_dequeue(zm_iswpqueue_t* q, zm_qlink_t **link);
+int zm_iswpqueue_dequeue_wait(zm_iswpqueue_t* q, zm_qlink_t **link);
+
+#endif /* _ZM_ISWPQUEUE_H */
@@ -0,0 +1,33 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_LCRQUEUE_H
+#define _ZM_LCRQUEUE_H
+#include <stdlib.h>
+#include <stdio.h>
+#include "queue/zm_queue_types.h"
+
+/* lcrqueue: unbounded MPMC queue made of a linked list of ring buffers
+ * indexed with fetch-and-add (LCRQ). A ring that fills up is closed and
+ * enqueuers move on to a new one. Rings are freed once no thread holds a
+ * hazard pointer to them.
+ *
+ * Cells are updated with a double-width CAS when the platform has one
+ * (HAVE_DWCAS, cmpxchg16b on x86_64) and under striped spinlocks otherwise.
+ *
+ * dequeue returns 0 and sets *data to NULL if the queue is empty, 1
+ * otherwise. NULL cannot be enqueued. init and the enqueue routines return
+ * -1 if a new ring cannot be allocated; enqueue_bulk has then added the
+ * elements before the one that failed. */
+
+int zm_lcrqueue_init(zm_lcrqueue_t *);
+int zm_lcrqueue_destroy(zm_lcrqueue_t *);
+int zm_lcrqueue_enqueue(zm_lcrqueue_t* q, void *data);
+int zm_lcrqueue_dequeue(zm_lcrqueue_t* q, void **data);
+int zm_lcrqueue_dequeue_wait(zm_lcrqueue_t* q, void **data);
+int zm_lcrqueue_enqueue_bulk(zm_lcrqueue_t* q, void *data[], int n);
+int zm_lcrqueue_dequeue_bulk(zm_lcrqueue_t* q, void *data[], int max, int *count);
+
+#endif /* _ZM_LCRQUEUE_H */
@@ -14,7 +14,9 @@
 
 int zm_mpbqueue_init(struct zm_mpbqueue *, int);
 int zm_mpbqueue_enqueue(struct zm_mpbqueue* q, void *data, int);
+/* Returns 1 if an element was dequeued, 0 if the queue was found empty */
 int zm_mpbqueue_dequeue(struct zm_mpbqueue* q, void **data);
+int zm_mpbqueue_dequeue_wait(struct zm_mpbqueue* q, void **data);
 int zm_mpbqueue_dequeue_bulk(struct zm_mpbqueue* q, void*[], int, int*);
 int zm_mpbqueue_dequeue_range(struct zm_mpbqueue* q, void*[], int, int, int, int*);
 
@@ -9,8 +9,12 @@
 #include <stdio.h>
 #include "queue/zm_queue_types.h"
 
+/* The init and enqueue routines return -1 if out of memory */
 int zm_msqueue_init(zm_msqueue_t *);
 int zm_msqueue_enqueue(zm_msqueue_t* q, void *data);
 int zm_msqueue_dequeue(zm_msqueue_t* q, void **data);
+int zm_msqueue_dequeue_wait(zm_msqueue_t* q, void **data);
+int zm_msqueue_enqueue_bulk(zm_msqueue_t* q, void *data[], int n);
+int zm_msqueue_dequeue_bulk(zm_msqueue_t* q, void *data[], int max, int *count);
 
 #endif /* _ZM_MSQUEUE_H */
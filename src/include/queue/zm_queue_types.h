@@ -6,15 +6,27 @@
 #ifndef _ZM_QUEUE_TYPES_H
 #define _ZM_QUEUE_TYPES_H
 #include "common/zm_common.h"
+#include "wait/zm_ec.h"
 #include <pthread.h>
 #include <limits.h>
+#include <stddef.h>
+
+/* Nodes of the linked queues take a full cache line by default, so that
+ * threads working on neighbouring nodes do not share lines. Define
+ * ZM_QUEUE_COMPACT_NODES (configure --enable-compact-qnodes) to pack them
+ * instead. */
+#if defined(ZM_QUEUE_COMPACT_NODES)
+#define ZM_QNODE_ALIGN
+#else
+#define ZM_QNODE_ALIGN ZM_ALLIGN_TO_CACHELINE
+#endif
 
 /* glqueue*/
 typedef struct zm_glqueue zm_glqueue_t;
 typedef struct zm_glqnode zm_glqnode_t;
 
 struct zm_glqnode {
-    void *data ZM_ALLIGN_TO_CACHELINE;
+    void *data ZM_QNODE_ALIGN;
     zm_ptr_t next;
 };
 
@@ -22,41 +34,66 @@ struct zm_glqueue {
     pthread_mutex_t lock;
     zm_ptr_t head ZM_ALLIGN_TO_CACHELINE;
     zm_ptr_t tail ZM_ALLIGN_TO_CACHELINE;
+    zm_ec_t ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuers */
 };
 
 /* swpqueue */
 typedef struct zm_msqueue zm_swpqueue_t;
 typedef struct zm_msqnode zm_swpqnode_t;
 
+/* a chain of nodes detached from a swpqueue, from a dummy node to last */
+typedef struct zm_swpqlist zm_swpqlist_t;
+
+struct zm_swpqlist {
+    struct zm_msqnode *node;
+    struct zm_msqnode *last;
+};
+
 /* msqueue */
 typedef struct zm_msqueue zm_msqueue_t;
 typedef struct zm_msqnode zm_msqnode_t;
 
 struct zm_msqnode {
-    void *data ZM_ALLIGN_TO_CACHELINE;
+    void *data ZM_QNODE_ALIGN;
     zm_atomic_ptr_t next;
 };
 
 struct zm_msqueue {
     zm_atomic_ptr_t head ZM_ALLIGN_TO_CACHELINE;
     zm_atomic_ptr_t tail ZM_ALLIGN_TO_CACHELINE;
+    zm_ec_t ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuers */
 };
 
 /* faqueue */
 
 #define ZM_MAX_FAQUEUE_SIZE     ULONG_MAX
 #define ZM_MAX_FASEG_SIZE       1024
-#define ZM_FAQUEUE_ALPHA        (void*)ULLONG_MAX /* meaning: queue cell empty */
+#define ZM_FAQUEUE_ALPHA        (void*)ULLONG_MAX /* meaning: cell given up by dequeuers */
 
 typedef struct zm_faseg     zm_faseg_t;
 typedef struct zm_faqueue   zm_faqueue_t;
 typedef struct zm_facell    zm_facell_t;
+typedef struct zm_fahandle  zm_fahandle_t;
 
-/* data inside a cell */
+/* Cells take a full cache line by default. ZM_FAQUEUE_PACKED_CELLS
+ * (configure --enable-faqueue-packed-cells) packs them, and consecutive
+ * cell indices are then spread over different cache lines. */
+#if defined(ZM_FAQUEUE_PACKED_CELLS)
+#define ZM_FACELL_ALIGN __attribute__((aligned(4 * sizeof(zm_ptr_t))))
+#else
+#define ZM_FACELL_ALIGN ZM_ALLIGN_TO_CACHELINE
+#endif
+
+/* a cell holds a value, and the slow-path enqueue and dequeue requests
+ * that reserved it, if any */
 struct zm_facell {
-    void* data ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ptr_t data ZM_FACELL_ALIGN;
+    zm_atomic_ptr_t enq;
+    zm_atomic_ptr_t deq;
 };
 
+#define ZM_FACELLS_PER_LINE     (ZM_CACHELINE_SIZE / sizeof(zm_facell_t))
+
 /* segment */
 struct zm_faseg {
     zm_ulong_t id;
@@ -64,13 +101,57 @@ struct zm_faseg {
     zm_atomic_ptr_t next;
 };
 
+/* Request states pack a pending bit with a cell index: (idx << 1) | pending */
+struct zm_faenq_req {
+    zm_atomic_ptr_t     val;
+    zm_atomic_ulong_t   state;
+};
+
+struct zm_fadeq_req {
+    zm_atomic_ulong_t   id;
+    zm_atomic_ulong_t   state;
+};
+
+/* per-thread state of a queue; handles are created on first use and live
+ * as long as the queue */
+struct zm_fahandle {
+    zm_atomic_ptr_t     next;       /* next handle of the queue */
+    void                *owner;
+    zm_faseg_t          *tail;      /* segment of the last enqueue */
+    zm_ulong_t          tail_id;
+    zm_atomic_ptr_t     head;       /* segment of the last dequeue */
+    zm_ulong_t          head_id;
+    struct zm_faenq_req enq_req ZM_ALLIGN_TO_CACHELINE;
+    zm_fahandle_t       *enq_peer;  /* next peer to help enqueue */
+    zm_ulong_t          enq_help_id;
+    struct zm_fadeq_req deq_req ZM_ALLIGN_TO_CACHELINE;
+    zm_fahandle_t       *deq_peer;  /* next peer to help dequeue */
+};
+
 struct zm_faqueue {
-    zm_ulong_t          head ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ulong_t   head ZM_ALLIGN_TO_CACHELINE;
     zm_atomic_ulong_t   tail ZM_ALLIGN_TO_CACHELINE;
-    zm_ptr_t            seg_head;
-    zm_atomic_ptr_t     seg_tail;
+    zm_atomic_ptr_t     seg_head ZM_ALLIGN_TO_CACHELINE; /* oldest live segment */
+    zm_atomic_ulong_t   seg_head_id;
+    zm_ptr_t            seg_free;   /* oldest segment not yet retired */
+    zm_atomic_flag_t    cleaning;
+    zm_atomic_ptr_t     handles;
+    zm_ulong_t          uid;        /* tells apart queues at the same address */
+    /* segment recycling */
+    zm_atomic_flag_t    seg_lock ZM_ALLIGN_TO_CACHELINE;
+    zm_ptr_t            seg_spare;  /* segments ready for reuse */
+    zm_ulong_t          nspare;
+    zm_ptr_t            arena;      /* hugepage chunks (ZM_FAQUEUE_HUGEPAGES) */
+    char                *arena_cur;
+    zm_ulong_t          arena_left;
+    zm_atomic_ulong_t   footprint;  /* bytes obtained from the system */
+    zm_ec_t             ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuers */
 };
 
+#ifndef ZM_MPBQUEUE_NBUCKETS
+#define ZM_MPBQUEUE_NBUCKETS    64 /* default for zm_queue_t */
+#endif
+
 typedef struct zm_mpbqueue zm_mpbqueue_t;
 
 struct zm_mpbqueue {
@@ -80,16 +161,150 @@ struct zm_mpbqueue {
     int *backoff_counters;
     int *backoff_bounds;
     int last_bucket_set;
+    zm_ec_t ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuer */
+};
+
+/* rbqueue */
+
+#ifndef ZM_RBQUEUE_CAPACITY
+#define ZM_RBQUEUE_CAPACITY     1024 /* default for zm_queue_t */
+#endif
+
+typedef struct zm_rbqueue   zm_rbqueue_t;
+typedef struct zm_rbcell    zm_rbcell_t;
+
+/* data inside a cell; seq tells whose turn it is to use the cell */
+struct zm_rbcell {
+    zm_atomic_ulong_t seq;
+    void *data;
+};
+
+#define ZM_RBCELLS_PER_LINE     (ZM_CACHELINE_SIZE / sizeof(zm_rbcell_t))
+
+struct zm_rbqueue {
+    zm_atomic_ulong_t   head ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ulong_t   tail ZM_ALLIGN_TO_CACHELINE;
+    zm_rbcell_t         *cells ZM_ALLIGN_TO_CACHELINE;
+    zm_ulong_t          mask;   /* capacity - 1 */
+    unsigned            shift;  /* log2(capacity / ZM_RBCELLS_PER_LINE) */
+    zm_ec_t             ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuers */
+};
+
+/* lcrqueue */
+
+#ifndef ZM_LCRQUEUE_RING_SIZE
+#define ZM_LCRQUEUE_RING_SIZE   1024 /* cells per ring, a power of two */
+#endif
+
+typedef struct zm_lcrqueue  zm_lcrqueue_t;
+typedef struct zm_lcrqring  zm_lcrqring_t;
+typedef struct zm_lcrqcell  zm_lcrqcell_t;
+
+/* val and idx are updated together with a double-width CAS. The top bit of
+ * idx marks the cell unsafe */
+struct zm_lcrqcell {
+    zm_atomic_ptr_t     val;
+    zm_atomic_ulong_t   idx;
+} __attribute__((aligned(2 * sizeof(zm_ptr_t))));
+
+#define ZM_LCRQCELLS_PER_LINE   (ZM_CACHELINE_SIZE / sizeof(zm_lcrqcell_t))
+
+/* a CRQ; the top bit of tail marks the ring closed */
+struct zm_lcrqring {
+    zm_atomic_ulong_t   head ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ulong_t   tail ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ptr_t     next ZM_ALLIGN_TO_CACHELINE;
+    zm_lcrqcell_t       cells[ZM_LCRQUEUE_RING_SIZE] ZM_ALLIGN_TO_CACHELINE;
+};
+
+struct zm_lcrqueue {
+    zm_atomic_ptr_t     head ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ptr_t     tail ZM_ALLIGN_TO_CACHELINE;
+    zm_ptr_t            ring_free ZM_ALLIGN_TO_CACHELINE; /* oldest ring not yet freed */
+    zm_atomic_flag_t    cleaning;
+    zm_ec_t             ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuers */
+};
+
+/* spscqueue */
+
+#ifndef ZM_SPSCQUEUE_CAPACITY
+#define ZM_SPSCQUEUE_CAPACITY   1024 /* default for zm_queue_t */
+#endif
+
+typedef struct zm_spscqueue zm_spscqueue_t;
+
+/* Each side keeps a private position and a cached copy of the other side's
+ * index, and publishes its own index every `batch` operations */
+struct zm_spscqueue {
+    /* consumer */
+    zm_atomic_ulong_t   head ZM_ALLIGN_TO_CACHELINE;
+    zm_ulong_t          phead;
+    zm_ulong_t          tail_cache;
+    /* producer */
+    zm_atomic_ulong_t   tail ZM_ALLIGN_TO_CACHELINE;
+    zm_ulong_t          ptail;
+    zm_ulong_t          head_cache;
+    /* read-only */
+    void                **cells ZM_ALLIGN_TO_CACHELINE;
+    zm_ulong_t          mask;   /* capacity - 1 */
+    zm_ulong_t          batch;
+    zm_ec_t             ec_data ZM_ALLIGN_TO_CACHELINE;  /* blocking consumer */
+    zm_ec_t             ec_space ZM_ALLIGN_TO_CACHELINE; /* blocking producer */
+};
+
+/* intrusive queues: elements embed a zm_qlink_t and are linked through it */
+
+typedef struct zm_qlink zm_qlink_t;
+
+struct zm_qlink {
+    zm_atomic_ptr_t next;
+};
+
+/* element of type `type` whose zm_qlink_t field `member` is at `link` */
+#define zm_qlink_entry(link, type, member) \
+    ((type *)((char *)(link) - offsetof(type, member)))
+
+/* called when a queue no longer uses the link of an element */
+typedef void (*zm_qlink_dispose_t)(zm_qlink_t *);
+
+typedef struct zm_iswpqueue zm_iswpqueue_t;
+typedef struct zm_imsqueue  zm_imsqueue_t;
+typedef struct zm_ifaqueue  zm_ifaqueue_t;
+
+struct zm_iswpqueue {
+    zm_ptr_t            head ZM_ALLIGN_TO_CACHELINE; /* consumer only */
+    zm_atomic_ptr_t     tail ZM_ALLIGN_TO_CACHELINE;
+    zm_qlink_t          stub ZM_ALLIGN_TO_CACHELINE;
+    zm_ec_t             ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuer */
+};
+
+struct zm_imsqueue {
+    zm_atomic_ptr_t     head ZM_ALLIGN_TO_CACHELINE;
+    zm_atomic_ptr_t     tail ZM_ALLIGN_TO_CACHELINE;
+    zm_qlink_t          stub ZM_ALLIGN_TO_CACHELINE;
+    zm_qlink_dispose_t  dispose;
+    zm_ec_t             ec ZM_ALLIGN_TO_CACHELINE; /* blocking dequeuers */
+};
+
+struct zm_ifaqueue {
+    zm_faqueue_t        faqueue;
 };
 
-/* Common structure to allow runtime selection */
+/* Common structure to allow runtime selection; type is the ZM_*QUEUE_IF
+ * of the instance (queue/zm_queue.h) */
 
-typedef union zm_queue {
-    zm_glqueue_t  glqueue;
-    zm_msqueue_t  msqueue;
-    zm_swpqueue_t swpqueue;
-    zm_faqueue_t  faqueue;
-    zm_mpbqueue_t mpbqueue;
+typedef struct zm_queue {
+    union {
+        zm_glqueue_t   glqueue;
+        zm_msqueue_t   msqueue;
+        zm_swpqueue_t  swpqueue;
+        zm_faqueue_t   faqueue;
+        zm_mpbqueue_t  mpbqueue;
+        zm_rbqueue_t   rbqueue;
+        zm_lcrqueue_t  lcrqueue;
+        zm_spscqueue_t spscqueue;
+    };
+    int type;
 } zm_queue_t;
 
 #endif /* _ZM_QUEUE_TYPES_H */
@@ -0,0 +1,30 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_RBQUEUE_H
+#define _ZM_RBQUEUE_H
+#include <stdlib.h>
+#include <stdio.h>
+#include "queue/zm_queue_types.h"
+
+/* rbqueue: bounded MPMC queue on a ring buffer (thus, the rb prefix) with a
+ * sequence number per cell. The capacity is rounded up to a power of two.
+ * Nothing is allocated after init, which returns -1 if out of memory.
+ *
+ * try_enqueue returns 0 if the queue is full and 1 otherwise; dequeue and
+ * try_dequeue return 0 and set *data to NULL if the queue is empty, 1
+ * otherwise. enqueue waits for a free cell when the queue is full. */
+
+int zm_rbqueue_init(zm_rbqueue_t *, zm_ulong_t capacity);
+int zm_rbqueue_destroy(zm_rbqueue_t *);
+int zm_rbqueue_try_enqueue(zm_rbqueue_t* q, void *data);
+int zm_rbqueue_enqueue(zm_rbqueue_t* q, void *data);
+int zm_rbqueue_try_dequeue(zm_rbqueue_t* q, void **data);
+int zm_rbqueue_dequeue(zm_rbqueue_t* q, void **data);
+int zm_rbqueue_dequeue_wait(zm_rbqueue_t* q, void **data);
+int zm_rbqueue_enqueue_bulk(zm_rbqueue_t* q, void *data[], int n);
+int zm_rbqueue_dequeue_bulk(zm_rbqueue_t* q, void *data[], int max, int *count);
+
+#endif /* _ZM_RBQUEUE_H */
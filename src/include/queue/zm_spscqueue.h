@@ -0,0 +1,36 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_SPSCQUEUE_H
+#define _ZM_SPSCQUEUE_H
+#include <stdlib.h>
+#include <stdio.h>
+#include "queue/zm_queue_types.h"
+
+/* spscqueue: bounded single-producer single-consumer queue on a ring
+ * buffer. The capacity is rounded up to a power of two; init returns -1 if
+ * the ring cannot be allocated. Neither side uses an atomic
+ * read-modify-write; each side re-reads the other side's index only when
+ * its cached copy says the queue is full (or empty).
+ *
+ * Indices are published every `batch` operations: an element becomes
+ * visible to the consumer at the latest after `batch` enqueues, when the
+ * producer waits for space, or on zm_spscqueue_flush. A producer that
+ * stops enqueuing must flush. batch = 1 publishes every element.
+ *
+ * try_enqueue returns 0 if the queue is full and 1 otherwise; enqueue
+ * waits for space, spinning and then parking. dequeue returns 0 and sets
+ * *data to NULL if the queue is empty, 1 otherwise; dequeue_wait waits for
+ * an element. */
+
+int zm_spscqueue_init(zm_spscqueue_t *, zm_ulong_t capacity, int batch);
+int zm_spscqueue_destroy(zm_spscqueue_t *);
+int zm_spscqueue_try_enqueue(zm_spscqueue_t* q, void *data);
+int zm_spscqueue_enqueue(zm_spscqueue_t* q, void *data);
+int zm_spscqueue_flush(zm_spscqueue_t* q);
+int zm_spscqueue_dequeue(zm_spscqueue_t* q, void **data);
+int zm_spscqueue_dequeue_wait(zm_spscqueue_t* q, void **data);
+
+#endif /* _ZM_SPSCQUEUE_H */
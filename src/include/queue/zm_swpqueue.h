@@ -9,9 +9,23 @@
 #include <stdio.h>
 #include "queue/zm_queue_types.h"
 
+/* The init and enqueue routines return -1 if out of memory */
 int zm_swpqueue_init(zm_swpqueue_t *);
 int zm_swpqueue_enqueue(zm_swpqueue_t* q, void *data);
+/* Enqueue without notifying zm_swpqueue_dequeue_wait callers, for queues
+ * built on swp queues that notify their own waiters (mpb) */
+int zm_swpqueue_enqueue_quiet(zm_swpqueue_t* q, void *data);
 int zm_swpqueue_dequeue(zm_swpqueue_t* q, void **data);
+int zm_swpqueue_dequeue_wait(zm_swpqueue_t* q, void **data);
+int zm_swpqueue_enqueue_bulk(zm_swpqueue_t* q, void *data[], int n);
+int zm_swpqueue_dequeue_bulk(zm_swpqueue_t* q, void *data[], int max, int *count);
+/* Detach all the elements in one exchange, for the consumer to go through
+ * with zm_swpqueue_list_next. Returns 0 if the queue was empty, and -1,
+ * leaving the elements in the queue, if out of memory. */
+int zm_swpqueue_take_all(zm_swpqueue_t* q, zm_swpqlist_t *list);
+/* Next element of a detached list, in FIFO order; returns 0 at the end.
+ * Nodes are freed as the list is walked, so it must be walked to the end. */
+int zm_swpqueue_list_next(zm_swpqlist_t *list, void **data);
 int zm_swpqueue_isempty_weak(zm_swpqueue_t* q);
 int zm_swpqueue_isempty_strong(zm_swpqueue_t* q);
 
@@ -0,0 +1,92 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_EC_H
+#define _ZM_EC_H
+#include <limits.h>
+#include "wait/zm_wait.h"
+
+/* Eventcount: lets a thread block until a condition on a lock-free data
+ * structure may have changed, without any lock.
+ *
+ * waiter:                              notifier:
+ *   zm_ec_prepare_wait(ec, &key)         make the change visible
+ *   if (condition holds)                 zm_ec_notify(ec)
+ *       zm_ec_cancel_wait(ec)
+ *   else
+ *       zm_ec_commit_wait(ec, key)
+ *
+ * commit_wait returns once a notify has happened after prepare_wait; it
+ * spins for ZM_WAIT_SPIN_BUDGET rounds and then parks through the block
+ * hook. When nobody waits, notify costs a full fence and a load of a line
+ * that only waiters write. */
+
+typedef struct zm_ec zm_ec_t;
+
+struct zm_ec {
+    zm_atomic_uint_t seq;      /* bumped by each notify that has waiters */
+    zm_atomic_uint_t nwaiters; /* between prepare and commit or cancel */
+};
+
+static inline void zm_ec_init(zm_ec_t *ec) {
+    zm_atomic_store(&ec->seq, 0, zm_memord_relaxed);
+    zm_atomic_store(&ec->nwaiters, 0, zm_memord_release);
+}
+
+static inline void zm_ec_prepare_wait(zm_ec_t *ec, unsigned *key) {
+    zm_atomic_fetch_add(&ec->nwaiters, 1, zm_memord_seq_cst);
+    *key = zm_atomic_load(&ec->seq, zm_memord_seq_cst);
+}
+
+static inline void zm_ec_cancel_wait(zm_ec_t *ec) {
+    zm_atomic_fetch_add(&ec->nwaiters, -1, zm_memord_release);
+}
+
+static inline void zm_ec_commit_wait(zm_ec_t *ec, unsigned key) {
+    unsigned spins = 0;
+    while (zm_atomic_load(&ec->seq, zm_memord_acquire) == key) {
+        if (++spins < ZM_WAIT_SPIN_BUDGET)
+            zm_cpu_relax();
+        else
+            zm_wait_block(&ec->seq, key);
+    }
+    zm_atomic_fetch_add(&ec->nwaiters, -1, zm_memord_release);
+}
+
+static inline void zm_ec_notify_n(zm_ec_t *ec, int n) {
+    /* order the change before reading nwaiters; pairs with prepare_wait */
+    zm_atomic_thread_fence(zm_memord_seq_cst);
+    if (zm_likely(zm_atomic_load(&ec->nwaiters, zm_memord_relaxed) == 0))
+        return;
+    zm_atomic_fetch_add(&ec->seq, 1, zm_memord_seq_cst);
+    zm_wait_wake(&ec->seq, n);
+}
+
+static inline void zm_ec_notify(zm_ec_t *ec) {
+    zm_ec_notify_n(ec, 1);
+}
+
+static inline void zm_ec_notify_all(zm_ec_t *ec) {
+    zm_ec_notify_n(ec, INT_MAX);
+}
+
+/* Waiter side for the common case: evaluates try_expr, which attempts the
+ * operation and is nonzero on success, until it succeeds, blocking on ec
+ * in between. try_expr is evaluated again after prepare_wait, so that a
+ * change made from then on notifies us. */
+#define ZM_EC_WAIT_UNTIL(ec, try_expr)                  \
+    do {                                                \
+        unsigned zm_ec_key_;                            \
+        while (!(try_expr)) {                           \
+            zm_ec_prepare_wait((ec), &zm_ec_key_);      \
+            if (try_expr) {                             \
+                zm_ec_cancel_wait(ec);                  \
+                break;                                  \
+            }                                           \
+            zm_ec_commit_wait((ec), zm_ec_key_);        \
+        }                                               \
+    } while (0)
+
+#endif /* _ZM_EC_H */
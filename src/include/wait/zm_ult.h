@@ -0,0 +1,36 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_ULT_H
+#define _ZM_ULT_H
+#include "wait/zm_wait.h"
+
+/* Reference user-level thread scheduler built on ucontext, meant for
+ * testing the waiting hooks. Each OS thread runs its own ULTs
+ * cooperatively; zm_ult_init registers waiting hooks that switch to another
+ * ULT of the same OS thread instead of yielding or blocking it, and that
+ * fall back to the previous hooks outside of ULTs. A ULT blocked on an
+ * address is also resumed when the address is changed by another OS
+ * thread, which the scheduler checks before every switch.
+ *
+ * ULTs sharing an OS thread must use the context-full lock routines, each
+ * with its own queue node: the context-less ones keep one queue node per
+ * hardware thread (this includes HMCS, see zm_hmcs_acquire_c). */
+
+#ifndef ZM_ULT_STACK_SIZE
+#define ZM_ULT_STACK_SIZE (64 * 1024)
+#endif
+
+typedef void (*zm_ult_fn_t)(zm_ptr_t);
+
+int zm_ult_init(void);
+int zm_ult_finalize(void);
+/* Create a ULT on the calling OS thread; returns -1 if out of memory */
+int zm_ult_create(zm_ult_fn_t fn, zm_ptr_t arg);
+/* Run the ULTs of the calling OS thread until they all complete */
+int zm_ult_run(void);
+int zm_ult_yield(void);
+
+#endif /* _ZM_ULT_H */
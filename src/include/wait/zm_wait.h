@@ -0,0 +1,137 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef _ZM_WAIT_H
+#define _ZM_WAIT_H
+#include "common/zm_common.h"
+
+/* Waiting hooks. Locks spin for ZM_WAIT_SPIN_BUDGET rounds and then yield
+ * through the yield hook before spinning again; condition variables block
+ * through the block hook and are woken through the wake hook. A user-level
+ * thread runtime registers its own hooks so that a waiting ULT lets the
+ * other ULTs of its OS thread run. The default hooks yield the OS thread
+ * and block on a futex.
+ *
+ * block(addr, val) waits as long as *addr == val; it may return spuriously.
+ * block_timed(addr, val, timeout_ns) does the same for at most timeout_ns
+ * nanoseconds; hooks registered without it yield instead. wake(addr, n)
+ * wakes up to n waiters blocked on addr. */
+
+#ifndef ZM_WAIT_SPIN_BUDGET
+#define ZM_WAIT_SPIN_BUDGET 1024
+#endif
+
+typedef struct zm_wait_hooks zm_wait_hooks_t;
+
+struct zm_wait_hooks {
+    void (*yield)(void);
+    void (*block)(zm_atomic_uint_t *addr, unsigned val);
+    void (*wake)(zm_atomic_uint_t *addr, int n);
+    void (*block_timed)(zm_atomic_uint_t *addr, unsigned val, long timeout_ns);
+};
+
+extern zm_wait_hooks_t zm_wait_hooks;
+
+/* Register hooks; NULL restores the default ones. Hooks must be registered
+ * while no thread waits in izem. */
+int zm_wait_set_hooks(const zm_wait_hooks_t *);
+int zm_wait_get_default_hooks(zm_wait_hooks_t *);
+
+static inline void zm_wait_yield() {
+    zm_wait_hooks.yield();
+}
+
+static inline void zm_wait_block(zm_atomic_uint_t *addr, unsigned val) {
+    zm_wait_hooks.block(addr, val);
+}
+
+static inline void zm_wait_block_timed(zm_atomic_uint_t *addr, unsigned val,
+                                       long timeout_ns) {
+    zm_wait_hooks.block_timed(addr, val, timeout_ns);
+}
+
+static inline void zm_wait_wake(zm_atomic_uint_t *addr, int n) {
+    zm_wait_hooks.wake(addr, n);
+}
+
+/* One round of a spin-wait loop: relax the CPU, and yield once the
+ * budget is exhausted */
+static inline void zm_wait_spin(unsigned *spins) {
+    if (zm_likely(++(*spins) < ZM_WAIT_SPIN_BUDGET)) {
+        zm_cpu_relax();
+    } else {
+        *spins = 0;
+        zm_wait_yield();
+    }
+}
+
+/* Spin-then-park handshake on a state word. The waiter stores a waiting
+ * value in *state before it publishes itself; zm_wait_park returns once a
+ * waker has stored another value with zm_wait_unpark. After spinning for
+ * ZM_WAIT_SPIN_BUDGET rounds, the waiter marks the word ZM_WAIT_PARKED and
+ * blocks, and the waker only calls the wake hook if it finds that mark.
+ * The waiter may return as soon as the word is changed, so the waker must
+ * not touch the waiter afterwards; waking a stale address is harmless
+ * since blocking may return spuriously. The waiting and the cleared
+ * values must differ from ZM_WAIT_PARKED. */
+
+#define ZM_WAIT_PARKED 2
+
+static inline void zm_wait_park(zm_atomic_uint_t *state, unsigned waiting) {
+    unsigned spins = 0;
+    unsigned expected;
+    while (zm_atomic_load(state, zm_memord_acquire) == waiting) {
+        if (++spins < ZM_WAIT_SPIN_BUDGET) {
+            zm_cpu_relax();
+            continue;
+        }
+        expected = waiting;
+        if (zm_atomic_compare_exchange_strong(state, &expected, ZM_WAIT_PARKED,
+                                              zm_memord_acq_rel, zm_memord_acquire))
+            break;
+    }
+    while (zm_atomic_load(state, zm_memord_acquire) == ZM_WAIT_PARKED)
+        zm_wait_block(state, ZM_WAIT_PARKED);
+}
+
+/* CLOCK_MONOTONIC time in nanoseconds */
+long zm_wait_now_ns(void);
+
+/* zm_wait_park that gives up at deadline_ns (CLOCK_MONOTONIC, see
+ * zm_wait_now_ns). Returns 1 if woken and 0 on timeout, in which case the
+ * word may still be marked and the caller must withdraw from its wakers
+ * before the state goes away. */
+static inline int zm_wait_park_until(zm_atomic_uint_t *state, unsigned waiting,
+                                     long deadline_ns) {
+    unsigned spins = 0;
+    unsigned expected;
+    long left;
+    while (zm_atomic_load(state, zm_memord_acquire) == waiting) {
+        if (zm_wait_now_ns() >= deadline_ns)
+            return 0;
+        if (++spins < ZM_WAIT_SPIN_BUDGET) {
+            zm_cpu_relax();
+            continue;
+        }
+        expected = waiting;
+        if (zm_atomic_compare_exchange_strong(state, &expected, ZM_WAIT_PARKED,
+                                              zm_memord_acq_rel, zm_memord_acquire))
+            break;
+    }
+    while (zm_atomic_load(state, zm_memord_acquire) == ZM_WAIT_PARKED) {
+        left = deadline_ns - zm_wait_now_ns();
+        if (left <= 0)
+            return 0;
+        zm_wait_block_timed(state, ZM_WAIT_PARKED, left);
+    }
+    return 1;
+}
+
+static inline void zm_wait_unpark(zm_atomic_uint_t *state, unsigned cleared) {
+    if (zm_atomic_exchange_int(state, cleared, zm_memord_acq_rel) == ZM_WAIT_PARKED)
+        zm_wait_wake(state, 1);
+}
+
+#endif /* _ZM_WAIT_H */
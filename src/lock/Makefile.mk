@@ -10,4 +10,10 @@ zm_sources += \
 	lock/zm_tlp.c \
 	lock/zm_mcsp.c \
 	lock/zm_hmcs.c \
-	lock/zm_hmpr.c
+	lock/zm_hmpr.c \
+	lock/zm_rangelock.c \
+	lock/zm_locktable.c \
+	lock/zm_biased.c \
+	lock/zm_topo.c \
+	lock/zm_dlg.c \
+	lock/zm_ccsynch.c
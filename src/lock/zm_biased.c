@@ -0,0 +1,161 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include "zm_config.h"
+#include "lock/zm_biased.h"
+#if defined(HAVE_LINUX_MEMBARRIER_H)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
+/* The owner and a revoker synchronize as in Dekker's algorithm:
+
+owner: cs = 1; fence; if (bias != me) { cs = 0; slow path }
+revoker: lock(); bias = REVOKED; fence; while (cs) ;
+
+With membarrier, the revoker forces the fence on the running threads of
+the process and the owner only needs a compiler barrier. */
+
+/* The address of this variable identifies the calling thread */
+static zm_thread_local char self_tag;
+#define SELF ((zm_ptr_t)&self_tag)
+
+static zm_atomic_uint_t use_membarrier = 0;
+
+static void membarrier_register() {
+#if defined(HAVE_LINUX_MEMBARRIER_H) && defined(SYS_membarrier)
+    if (zm_atomic_load(&use_membarrier, zm_memord_acquire))
+        return;
+    if (syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+        zm_atomic_store(&use_membarrier, 1, zm_memord_release);
+#endif
+}
+
+static inline void owner_fence() {
+    if (zm_likely(zm_atomic_load(&use_membarrier, zm_memord_relaxed)))
+        __asm__ __volatile__("" ::: "memory");
+    else
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+}
+
+static inline void revoker_fence() {
+#if defined(HAVE_LINUX_MEMBARRIER_H) && defined(SYS_membarrier)
+    if (zm_atomic_load(&use_membarrier, zm_memord_relaxed)) {
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+        return;
+    }
+#endif
+    zm_atomic_thread_fence(zm_memord_seq_cst);
+}
+
+int zm_biased_init(zm_biased_t *L)
+{
+    membarrier_register();
+    zm_atomic_store(&L->bias, ZM_NULL, zm_memord_relaxed);
+    zm_atomic_store(&L->owner_cs, 0, zm_memord_relaxed);
+    L->fast_held = 0;
+    L->fast_acqs = 0;
+    L->last_holder = ZM_NULL;
+    L->streak = 0;
+    L->slow_acqs = 0;
+    L->revocations = 0;
+    L->rebiases = 0;
+    zm_ticket_init(&L->lock);
+    return 0;
+}
+
+int zm_biased_destroy(zm_biased_t *L)
+{
+    zm_ticket_destroy(&L->lock);
+    return 0;
+}
+
+static inline int fast_acquire(zm_biased_t *L) {
+    if (zm_atomic_load(&L->bias, zm_memord_relaxed) != SELF)
+        return 0;
+    zm_atomic_store(&L->owner_cs, 1, zm_memord_relaxed);
+    owner_fence();
+    if (zm_likely(zm_atomic_load(&L->bias, zm_memord_relaxed) == SELF)) {
+        L->fast_held = 1;
+        L->fast_acqs++;
+        return 1;
+    }
+    /* revoked: let the revoker in */
+    zm_atomic_store(&L->owner_cs, 0, zm_memord_release);
+    return 0;
+}
+
+/* Called with the underlying lock held */
+static inline void slow_acquired(zm_biased_t *L) {
+    zm_ptr_t bias = zm_atomic_load(&L->bias, zm_memord_relaxed);
+    unsigned spins = 0;
+    if (bias == ZM_NULL) {
+        /* first acquisition: claim the bias */
+        zm_atomic_store(&L->bias, SELF, zm_memord_relaxed);
+    } else if (bias != ZM_BIASED_REVOKED && bias != SELF) {
+        zm_atomic_store(&L->bias, ZM_BIASED_REVOKED, zm_memord_relaxed);
+        revoker_fence();
+        while (zm_atomic_load(&L->owner_cs, zm_memord_acquire))
+            zm_wait_spin(&spins);
+        L->revocations++;
+    } else if (bias == ZM_BIASED_REVOKED) {
+        if (L->last_holder == SELF) {
+            if (++L->streak >= ZM_BIASED_REBIAS_THRESHOLD) {
+                zm_atomic_store(&L->bias, SELF, zm_memord_relaxed);
+                L->streak = 0;
+                L->rebiases++;
+            }
+        } else {
+            L->last_holder = SELF;
+            L->streak = 1;
+        }
+    }
+    L->fast_held = 0;
+    L->slow_acqs++;
+}
+
+int zm_biased_acquire(zm_biased_t *L) {
+    if (fast_acquire(L))
+        return 0;
+    zm_ticket_acquire(&L->lock);
+    slow_acquired(L);
+    return 0;
+}
+
+int zm_biased_tryacq(zm_biased_t *L, int *success) {
+    int acquired = 0;
+    if (fast_acquire(L)) {
+        acquired = 1;
+    } else {
+        zm_ticket_tryacq(&L->lock, &acquired);
+        if (acquired)
+            slow_acquired(L);
+    }
+    *success = acquired;
+    return 0;
+}
+
+int zm_biased_release(zm_biased_t *L) {
+    if (L->fast_held) {
+        L->fast_held = 0;
+        zm_atomic_store(&L->owner_cs, 0, zm_memord_release);
+    } else {
+        zm_ticket_release(&L->lock);
+    }
+    return 0;
+}
+
+int zm_biased_get_stats(zm_biased_t *L, zm_biased_stats_t *stats) {
+    stats->fast_acqs = L->fast_acqs;
+    stats->slow_acqs = L->slow_acqs;
+    stats->revocations = L->revocations;
+    stats->rebiases = L->rebiases;
+    return 0;
+}
@@ -0,0 +1,201 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * CC-Synch and H-Synch as described in:
+ *
+ * Fatourou, Panagiota, and Nikolaos D. Kallimanis. "Revisiting the
+ * combining synchronization technique." In Proceedings of the 17th ACM
+ * SIGPLAN Symposium on Principles and Practice of Parallel Programming
+ * (PPoPP'12), ACM, 2012.
+ */
+
+#include <stdlib.h>
+#include "lock/zm_ccsynch.h"
+#include "lock/zm_ticket.h"
+#include "lock/zm_topo.h"
+
+/* The algorithm follows this logic
+
+apply(fn, arg)
+next = my_node
+next.next = NULL; next.wait = 1; next.completed = 0
+cur = SWAP(tail, next)
+cur.fn = fn; cur.arg = arg; cur.next = next
+my_node = cur
+while(cur.wait) ;
+if (cur.completed)
+    return cur.ret
+// combiner
+tmp = cur
+while (tmp.next != NULL && count++ < BATCH) {
+    tmp.ret = tmp.fn(tmp.arg)
+    tmp.completed = 1; tmp.wait = 0
+    tmp = tmp.next
+}
+tmp.wait = 0 // next combiner
+*/
+
+#ifndef ZM_COMBINING_BATCH
+#define ZM_COMBINING_BATCH 64
+#endif
+
+struct cluster {
+    zm_ccsynch_t list;
+} __attribute__((aligned(ZM_CACHELINE_SIZE)));
+
+struct hsynch {
+    zm_ticket_t lock __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    struct cluster *clusters;
+    int nclusters;
+    int cluster_size;
+    hwloc_topology_t topo;
+};
+
+/* Returns NULL if out of memory */
+static zm_ccsynch_node_t *new_node() {
+    zm_ccsynch_node_t *node;
+    if (posix_memalign((void **) &node, ZM_CACHELINE_SIZE, sizeof(zm_ccsynch_node_t)) != 0)
+        return NULL;
+    node->fn = NULL;
+    node->arg = ZM_NULL;
+    node->ret = ZM_NULL;
+    zm_atomic_store(&node->wait, 0, zm_memord_relaxed);
+    zm_atomic_store(&node->completed, 0, zm_memord_relaxed);
+    zm_atomic_store(&node->next, ZM_NULL, zm_memord_relaxed);
+    return node;
+}
+
+static inline int list_init(zm_ccsynch_t *C) {
+    /* the tail is a dummy node that lets the first thread combine */
+    zm_ccsynch_node_t *node = new_node();
+    if (node == NULL)
+        return -1;
+    zm_atomic_store(&C->tail, (zm_ptr_t) node, zm_memord_release);
+    return 0;
+}
+
+static inline void list_destroy(zm_ccsynch_t *C) {
+    free((void*) zm_atomic_load(&C->tail, zm_memord_acquire));
+}
+
+static inline void combine(zm_ccsynch_t *C, zm_ticket_t *global,
+                           zm_ccsynch_node_t **my_node,
+                           zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret) {
+    zm_ccsynch_node_t *next = *my_node, *cur, *tmp, *tmp_next;
+    int count = 0;
+    unsigned spins = 0;
+
+    zm_atomic_store(&next->next, ZM_NULL, zm_memord_relaxed);
+    zm_atomic_store(&next->wait, 1, zm_memord_relaxed);
+    zm_atomic_store(&next->completed, 0, zm_memord_relaxed);
+
+    cur = (zm_ccsynch_node_t*) zm_atomic_exchange_ptr(&C->tail, (zm_ptr_t) next, zm_memord_acq_rel);
+    cur->fn = fn;
+    cur->arg = arg;
+    zm_atomic_store(&cur->next, (zm_ptr_t) next, zm_memord_release);
+    *my_node = cur;
+
+    while (zm_atomic_load(&cur->wait, zm_memord_acquire))
+        zm_wait_spin(&spins);
+
+    if (!zm_atomic_load(&cur->completed, zm_memord_acquire)) {
+        /* combiner: serve the operations queued behind, including ours */
+        if (global != NULL)
+            zm_ticket_acquire(global);
+        tmp = cur;
+        while ((tmp_next = (zm_ccsynch_node_t*) zm_atomic_load(&tmp->next, zm_memord_acquire)) != NULL
+               && count < ZM_COMBINING_BATCH) {
+            count++;
+            tmp->ret = tmp->fn(tmp->arg);
+            zm_atomic_store(&tmp->completed, 1, zm_memord_relaxed);
+            zm_atomic_store(&tmp->wait, 0, zm_memord_release);
+            tmp = tmp_next;
+        }
+        if (global != NULL)
+            zm_ticket_release(global);
+        /* hand over the combiner role */
+        zm_atomic_store(&tmp->wait, 0, zm_memord_release);
+    }
+    if (ret != NULL)
+        *ret = cur->ret;
+}
+
+int zm_ccsynch_init(zm_ccsynch_t *C) {
+    return list_init(C);
+}
+
+int zm_ccsynch_destroy(zm_ccsynch_t *C) {
+    list_destroy(C);
+    return 0;
+}
+
+int zm_ccsynch_node_alloc(zm_ccsynch_node_t **node) {
+    *node = new_node();
+    return (*node != NULL) ? 0 : -1;
+}
+
+int zm_ccsynch_node_free(zm_ccsynch_node_t *node) {
+    free(node);
+    return 0;
+}
+
+int zm_ccsynch_apply(zm_ccsynch_t *C, zm_ccsynch_node_t **node,
+                     zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret) {
+    combine(C, NULL, node, fn, arg, ret);
+    return 0;
+}
+
+int zm_hsynch_init(zm_hsynch_t *handle) {
+    struct hsynch *H;
+    int i;
+
+    if (posix_memalign((void **) &H, ZM_CACHELINE_SIZE, sizeof(struct hsynch)) != 0)
+        return -1;
+    hwloc_topology_init(&H->topo);
+    hwloc_topology_load(H->topo);
+    /* one list per cluster */
+    H->nclusters = zm_topo_clusters(H->topo, &H->cluster_size);
+
+    if (posix_memalign((void **) &H->clusters, ZM_CACHELINE_SIZE,
+                       sizeof(struct cluster) * H->nclusters) != 0)
+        goto fail_clusters;
+    for (i = 0; i < H->nclusters; i++)
+        if (list_init(&H->clusters[i].list) != 0)
+            goto fail_lists;
+    zm_ticket_init(&H->lock);
+
+    *handle = (zm_hsynch_t) H;
+    return 0;
+
+fail_lists:
+    while (i-- > 0)
+        list_destroy(&H->clusters[i].list);
+    free(H->clusters);
+fail_clusters:
+    hwloc_topology_destroy(H->topo);
+    free(H);
+    return -1;
+}
+
+int zm_hsynch_destroy(zm_hsynch_t *handle) {
+    struct hsynch *H = (struct hsynch*)(void *)(*handle);
+    int i;
+    for (i = 0; i < H->nclusters; i++)
+        list_destroy(&H->clusters[i].list);
+    zm_ticket_destroy(&H->lock);
+    hwloc_topology_destroy(H->topo);
+    free(H->clusters);
+    free(H);
+    return 0;
+}
+
+int zm_hsynch_apply(zm_hsynch_t handle, zm_ccsynch_node_t **node,
+                    zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret) {
+    struct hsynch *H = (struct hsynch*)(void *)handle;
+    int c = zm_topo_cluster(H->topo, H->cluster_size, H->nclusters);
+    combine(&H->clusters[c].list, &H->lock, node, fn, arg, ret);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include "lock/zm_dlg.h"
+#include "lock/zm_topo.h"
+
+/* The algorithm follows this logic
+
+execute(fn, arg)
+req.fn = fn; req.arg = arg
+req.seq++
+while(resp.seq != req.seq) ;
+return resp.ret
+
+server()
+while(!stop) {
+    for each batch of clients {
+        collect the clients with req.seq != resp.seq
+        run their requests
+        publish resp.ret and resp.seq = req.seq
+    }
+}
+*/
+
+#ifndef ZM_DLG_BATCH
+#define ZM_DLG_BATCH 8
+#endif
+
+/* Polling rounds without requests before the server yields its core */
+#ifndef ZM_DLG_IDLE_SPINS
+#define ZM_DLG_IDLE_SPINS 1024
+#endif
+
+struct request {
+    zm_dlg_fn_t fn;
+    zm_ptr_t arg;
+    zm_atomic_uint_t seq;
+} __attribute__((aligned(ZM_CACHELINE_SIZE)));
+
+struct response {
+    zm_ptr_t ret;
+    zm_atomic_uint_t seq;
+} __attribute__((aligned(ZM_CACHELINE_SIZE)));
+
+struct slot {
+    struct request req;   /* written by the client */
+    struct response resp; /* written by the server */
+};
+
+struct server {
+    struct slot *slots;
+    int max_clients;
+    zm_atomic_uint_t nclients __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    zm_atomic_uint_t stop __attribute__((aligned(ZM_CACHELINE_SIZE)));
+    zm_atomic_uint_t ready;
+    hwloc_topology_t topo;
+    hwloc_obj_t server_pu;
+    pthread_t thread;
+};
+
+static hwloc_obj_t select_server_pu(hwloc_topology_t topo) {
+    hwloc_obj_t pkg, pu = NULL;
+    char *s = getenv("ZM_DLG_SERVER_PU");
+    if (s != NULL)
+        pu = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PU, atoi(s));
+    if (pu == NULL) {
+        int npus;
+        pkg = zm_topo_package(topo);
+        npus = hwloc_get_nbobjs_inside_cpuset_by_type(topo, pkg->cpuset, HWLOC_OBJ_PU);
+        pu = hwloc_get_obj_inside_cpuset_by_type(topo, pkg->cpuset, HWLOC_OBJ_PU, npus - 1);
+    }
+    return pu;
+}
+
+static inline int serve_batch(struct server *S, int first, int last) {
+    int i, n = 0;
+    int pending[ZM_DLG_BATCH];
+    unsigned seqs[ZM_DLG_BATCH];
+    for (i = first; i < last; i++) {
+        struct slot *slot = &S->slots[i];
+        unsigned seq = zm_atomic_load(&slot->req.seq, zm_memord_acquire);
+        if (seq != zm_atomic_load(&slot->resp.seq, zm_memord_relaxed)) {
+            pending[n] = i;
+            seqs[n] = seq;
+            n++;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        struct slot *slot = &S->slots[pending[i]];
+        slot->resp.ret = slot->req.fn(slot->req.arg);
+    }
+    for (i = 0; i < n; i++)
+        zm_atomic_store(&S->slots[pending[i]].resp.seq, seqs[i], zm_memord_release);
+    return n;
+}
+
+static void *server_loop(void *arg) {
+    struct server *S = (struct server*) arg;
+    unsigned idle = 0;
+    int i;
+
+    hwloc_set_cpubind(S->topo, S->server_pu->cpuset, HWLOC_CPUBIND_THREAD);
+    /* first touch from the server's socket */
+    memset(S->slots, 0, sizeof(struct slot) * S->max_clients);
+    zm_atomic_store(&S->ready, 1, zm_memord_release);
+
+    while (!zm_atomic_load(&S->stop, zm_memord_acquire)) {
+        int nclients = zm_atomic_load(&S->nclients, zm_memord_acquire);
+        int served = 0;
+        for (i = 0; i < nclients; i += ZM_DLG_BATCH)
+            served += serve_batch(S, i, (i + ZM_DLG_BATCH < nclients) ? i + ZM_DLG_BATCH : nclients);
+        if (served) {
+            idle = 0;
+        } else if (++idle >= ZM_DLG_IDLE_SPINS) {
+            idle = 0;
+            sched_yield();
+        } else {
+            zm_cpu_relax();
+        }
+    }
+    return NULL;
+}
+
+int zm_dlg_init(zm_dlg_t *handle, int max_clients) {
+    struct server *S;
+    if (posix_memalign((void **) &S, ZM_CACHELINE_SIZE, sizeof(struct server)) != 0)
+        return -1;
+    if (posix_memalign((void **) &S->slots, ZM_CACHELINE_SIZE,
+                       sizeof(struct slot) * max_clients) != 0) {
+        free(S);
+        return -1;
+    }
+    S->max_clients = max_clients;
+    zm_atomic_store(&S->nclients, 0, zm_memord_relaxed);
+    zm_atomic_store(&S->stop, 0, zm_memord_relaxed);
+    zm_atomic_store(&S->ready, 0, zm_memord_relaxed);
+
+    hwloc_topology_init(&S->topo);
+    hwloc_topology_load(S->topo);
+    S->server_pu = select_server_pu(S->topo);
+
+    if (pthread_create(&S->thread, NULL, server_loop, (void*) S) != 0) {
+        hwloc_topology_destroy(S->topo);
+        free(S->slots);
+        free(S);
+        return -1;
+    }
+    while (!zm_atomic_load(&S->ready, zm_memord_acquire))
+        sched_yield();
+
+    *handle = (zm_dlg_t) S;
+    return 0;
+}
+
+int zm_dlg_destroy(zm_dlg_t *handle) {
+    struct server *S = (struct server*)(void *)(*handle);
+    zm_atomic_store(&S->stop, 1, zm_memord_release);
+    pthread_join(S->thread, NULL);
+    hwloc_topology_destroy(S->topo);
+    free(S->slots);
+    free(S);
+    return 0;
+}
+
+int zm_dlg_register(zm_dlg_t D, zm_dlg_client_t *client) {
+    struct server *S = (struct server*)(void *)D;
+    unsigned id = zm_atomic_fetch_add(&S->nclients, 1, zm_memord_acq_rel);
+    if (id >= (unsigned)S->max_clients) {
+        printf("IZEM:DLG:ERROR: more than %d clients registered!\n", S->max_clients);
+        exit(EXIT_FAILURE);
+    }
+    *client = (zm_dlg_client_t) &S->slots[id];
+    return 0;
+}
+
+int zm_dlg_execute(zm_dlg_client_t client, zm_dlg_fn_t fn, zm_ptr_t arg, zm_ptr_t *ret) {
+    struct slot *slot = (struct slot*)(void *)client;
+    unsigned seq = zm_atomic_load(&slot->req.seq, zm_memord_relaxed) + 1;
+    unsigned spins = 0;
+    slot->req.fn = fn;
+    slot->req.arg = arg;
+    zm_atomic_store(&slot->req.seq, seq, zm_memord_release);
+    while (zm_atomic_load(&slot->resp.seq, zm_memord_acquire) != seq)
+        zm_wait_spin(&spins);
+    if (ret != NULL)
+        *ret = slot->resp.ret;
+    return 0;
+}
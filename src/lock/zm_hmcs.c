@@ -20,16 +20,12 @@
  */
 
 #include "lock/zm_lock_types.h"
-#include <hwloc.h>
+#include "lock/zm_topo.h"
 
 #ifndef DEFAULT_THRESHOLD
 #define DEFAULT_THRESHOLD 256
 #endif
 
-#ifndef HMCS_DEFAULT_MAX_LEVELS
-#define HMCS_DEFAULT_MAX_LEVELS 3
-#endif
-
 #define WAIT (0xffffffff)
 #define COHORT_START (0x1)
 #define ACQUIRE_PARENT (0xcffffffc)
@@ -72,9 +68,8 @@ struct hnode{
 struct leaf{
     struct hnode * cur_node;
     struct hnode * root_node;
-    zm_mcs_qnode_t I;
+    zm_hmcs_qnode_t node; /* used by the context-less routines */
     int curDepth;
-    int took_fast_path;
 };
 
 struct lock{
@@ -92,13 +87,7 @@ static zm_thread_local int tid = -1;
 
 /* Check the actual affinity mask assigned to the thread */
 static void check_affinity(hwloc_topology_t topo) {
-    hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
-    int set_length;
-    hwloc_get_cpubind(topo, cpuset, HWLOC_CPUBIND_THREAD);
-    set_length = hwloc_get_nbobjs_inside_cpuset_by_type(topo, cpuset, HWLOC_OBJ_PU);
-    hwloc_bitmap_free(cpuset);
-
-    if(set_length != 1) {
+    if(zm_topo_nbound_pus(topo) != 1) {
         printf("IZEM:HMCS:ERROR: thread bound to more than one HW thread!\n");
         exit(EXIT_FAILURE);
     }
@@ -135,8 +124,9 @@ static inline void normal_mcs_release_with_value(struct hnode * L, zm_mcs_qnode_
     zm_mcs_qnode_t *tmp = I;
     if (CAS(&(L->lock), (zm_ptr_t*)&tmp,ZM_NULL))
         return;
-    while(succ == NULL)
-        succ = (zm_mcs_qnode_t *)LOAD(&I->next); /* SPIN */
+    unsigned spins = 0;
+    while((succ = (zm_mcs_qnode_t *)LOAD(&I->next)) == NULL)
+        zm_wait_spin(&spins);
     STORE(&succ->status, val);
     return;
 }
@@ -152,8 +142,9 @@ static inline void acquire_root(struct hnode * L, zm_mcs_qnode_t *I) {
     }
 
     STORE(&pred->next, I);
+    unsigned spins = 0;
     while(LOAD(&I->status) == WAIT)
-        ; /* SPIN */
+        zm_wait_spin(&spins);
     return;
 }
 
@@ -196,6 +187,7 @@ static inline void acquire_helper(int level, struct hnode * L, zm_mcs_qnode_t *I
             return;
         } else {
             STORE(&pred->next, I);
+            unsigned spins = 0;
             for(;;){
                 unsigned myStatus = LOAD(&I->status);
                 if(myStatus < ACQUIRE_PARENT) {
@@ -209,6 +201,7 @@ static inline void acquire_helper(int level, struct hnode * L, zm_mcs_qnode_t *I
                     return;
                 }
                 // spin back; (I->status == WAIT)
+                zm_wait_spin(&spins);
             }
         }
     }
@@ -268,7 +261,7 @@ static void* new_leaf(struct hnode *h, int depth) {
     }
     leaf->cur_node = h;
     leaf->curDepth = depth;
-    leaf->took_fast_path = FALSE;
+    leaf->node.took_fast_path = FALSE;
     struct hnode *tmp, *root_node;
     for(tmp = leaf->cur_node; tmp->parent != NULL; tmp = tmp->parent);
     root_node = tmp;
@@ -276,125 +269,63 @@ static void* new_leaf(struct hnode *h, int depth) {
     return leaf;
 }
 
-static inline void acquire_from_leaf(int level, struct leaf *L){
+/* Q is the queue node of the acquisition: the one of the leaf for the
+ * context-less routines, or one given by the caller, so that several
+ * user-level threads running on the same hardware thread can queue at
+ * the same leaf. Q remembers its leaf for the release. */
+static inline void acquire_from_leaf(int level, struct leaf *L, zm_hmcs_qnode_t *Q){
+    Q->leaf = (zm_ptr_t)L;
     if((zm_ptr_t)L->cur_node->lock == ZM_NULL
     && (zm_ptr_t)L->root_node->lock == ZM_NULL) {
         // go FP
-        L->took_fast_path = TRUE;
-        acquire_root(L->root_node, &L->I);
+        Q->took_fast_path = TRUE;
+        acquire_root(L->root_node, &Q->I);
         return;
     }
-    acquire_helper(level, L->cur_node, &L->I);
+    Q->took_fast_path = FALSE;
+    acquire_helper(level, L->cur_node, &Q->I);
     return;
 }
 
-static inline void tryacq_from_leaf(int level, struct leaf *L, int *success){
+static inline void tryacq_from_leaf(int level, struct leaf *L, zm_hmcs_qnode_t *Q, int *success){
     *success = 0;
+    Q->leaf = (zm_ptr_t)L;
+    Q->took_fast_path = FALSE;
     if((zm_ptr_t)L->cur_node->lock == ZM_NULL
     && (zm_ptr_t)L->root_node->lock == ZM_NULL) {
-        tryacq_root(L->root_node, &L->I, success);
+        tryacq_root(L->root_node, &Q->I, success);
         if (*success)
-            L->took_fast_path = TRUE;
+            Q->took_fast_path = TRUE;
     }
     return;
 }
 
-static inline void release_from_leaf(int level, struct leaf *L){
+static inline void release_from_leaf(int level, zm_hmcs_qnode_t *Q){
+    struct leaf *L = (struct leaf*)Q->leaf;
     //myrelease(cur_node, I);
-    if(L->took_fast_path) {
-        release_root(L->root_node, &L->I);
-        L->took_fast_path = FALSE;
+    if(Q->took_fast_path) {
+        release_root(L->root_node, &Q->I);
+        Q->took_fast_path = FALSE;
         return;
     }
-    release_helper(level, L->cur_node, &L->I);
+    release_helper(level, L->cur_node, &Q->I);
     return;
 }
 
-static inline int nowaiters_from_leaf(int level, struct leaf *L){
+static inline int nowaiters_from_leaf(int level, zm_hmcs_qnode_t *Q){
+    struct leaf *L = (struct leaf*)Q->leaf;
     // Shouldnt this be nowaiters(root_node, I)?
-    if(L->took_fast_path) {
-        return nowaiters_root(L->cur_node, &L->I);
+    if(Q->took_fast_path) {
+        return nowaiters_root(L->cur_node, &Q->I);
     }
 
-    return nowaiters_helper(level, L->cur_node, &L->I);
-}
-
-static int get_hwthread_id(hwloc_topology_t topo){
-    hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
-    hwloc_obj_t obj;
-    hwloc_get_cpubind(topo, cpuset, HWLOC_CPUBIND_THREAD);
-    obj = hwloc_get_obj_inside_cpuset_by_type(topo, cpuset, HWLOC_OBJ_PU, 0);
-    hwloc_bitmap_free(cpuset);
-    return obj->logical_index;
+    return nowaiters_helper(level, L->cur_node, &Q->I);
 }
 
 static void set_hierarchy(struct lock *L, int *max_threads, int** particip_per_level) {
-    int max_depth, levels = 0, max_levels = HMCS_DEFAULT_MAX_LEVELS, explicit_levels = 0;
-    char tmp[20];
-    char *s = getenv("ZM_HMCS_MAX_LEVELS");
-    if (s != NULL)
-        max_levels = atoi(s);
-    int depths[max_levels];
-    int idx = 0;
-    /* advice to users: run `hwloc-ls -s --no-io --no-icaches` and choose
-     * depths of interest in ascending order. The first depth must be `0' */
-
-    s = getenv("ZM_HMCS_EXPLICIT_LEVELS");
-    if (s != NULL) {
-        strcpy(tmp, s);
-        explicit_levels = 1;
-        char* token;
-        token = strtok(tmp,",");
-        while(token != NULL) {
-            depths[idx] = atoi(token);
-            if (idx == 0)
-                assert(depths[idx] == 0 && "the first depth must be machine level (i.e., depth 0), run `hwloc-ls -s --no-io --no-icaches` and choose appropriate depth values");
-            idx++;
-            token = strtok(NULL,",");
-        }
-        assert(idx == max_levels);
-    }
-
     hwloc_topology_init(&L->topo);
     hwloc_topology_load(L->topo);
-
-    *max_threads = hwloc_get_nbobjs_by_type(L->topo, HWLOC_OBJ_PU);
-
-    max_depth = hwloc_topology_get_depth(L->topo);
-    assert(max_depth >= 2); /* At least Machine and Core levels exist */
-
-    *particip_per_level = (int*) malloc(max_levels * sizeof(int));
-    int prev_nobjs = -1;
-    if(!explicit_levels) {
-        for (int d = max_depth - 2; d > 1; d--) {
-            int cur_nobjs = hwloc_get_nbobjs_by_depth(L->topo, d);
-            /* Check if this level has a hierarchical impact */
-            if(cur_nobjs != prev_nobjs) {
-                prev_nobjs = cur_nobjs;
-                (*particip_per_level)[levels] = (*max_threads)/cur_nobjs;
-                levels++;
-                if(levels >= max_levels - 1)
-                    break;
-            }
-        }
-        (*particip_per_level)[levels] = *max_threads;
-        levels++;
-    } else {
-        for(int i = max_levels - 1; i >= 0; i--){
-            int d = depths[i];
-            int cur_nobjs = hwloc_get_nbobjs_by_depth(L->topo, d);
-            /* Check if this level has a hierarchical impact */
-            if(cur_nobjs != prev_nobjs) {
-                prev_nobjs = cur_nobjs;
-                (*particip_per_level)[levels] = (*max_threads)/cur_nobjs;
-                levels++;
-            } else {
-                assert(0 && "plz choose levels that have a hierarchical impact");
-            }
-        }
-    }
-
-    L->levels = levels;
+    L->levels = zm_topo_hierarchy(L->topo, max_threads, particip_per_level);
 }
 
 static void free_hierarchy(int* particip_per_level){
@@ -509,28 +440,30 @@ static void free_lock(struct lock* L) {
     free(L);
 }
 
-static inline void hmcs_acquire(struct lock *L){
+static inline struct leaf *my_leaf(struct lock *L){
     if (zm_unlikely(tid == -1)) {
         check_affinity(L->topo);
-        tid = get_hwthread_id(L->topo);
+        tid = zm_topo_hwthread_id(L->topo);
     }
-    acquire_from_leaf(L->levels, L->leaf_nodes[tid]);
+    return L->leaf_nodes[tid];
 }
 
-static inline void hmcs_tryacq(struct lock *L, int *success){
-    if (zm_unlikely(tid == -1)) {
-        check_affinity(L->topo);
-        tid = get_hwthread_id(L->topo);
-    }
-    tryacq_from_leaf(L->levels, L->leaf_nodes[tid], success);
+static inline void hmcs_acquire(struct lock *L, zm_hmcs_qnode_t *Q){
+    struct leaf *leaf = my_leaf(L);
+    acquire_from_leaf(L->levels, leaf, (Q != NULL) ? Q : &leaf->node);
+}
+
+static inline void hmcs_tryacq(struct lock *L, zm_hmcs_qnode_t *Q, int *success){
+    struct leaf *leaf = my_leaf(L);
+    tryacq_from_leaf(L->levels, leaf, (Q != NULL) ? Q : &leaf->node, success);
 }
 
-static inline void hmcs_release(struct lock *L){
-    release_from_leaf(L->levels, L->leaf_nodes[tid]);
+static inline void hmcs_release(struct lock *L, zm_hmcs_qnode_t *Q){
+    release_from_leaf(L->levels, (Q != NULL) ? Q : &L->leaf_nodes[tid]->node);
 }
 
-static inline int hmcs_nowaiters(struct lock *L){
-    return nowaiters_from_leaf(L->levels, L->leaf_nodes[tid]);
+static inline int hmcs_nowaiters(struct lock *L, zm_hmcs_qnode_t *Q){
+    return nowaiters_from_leaf(L->levels, (Q != NULL) ? Q : &L->leaf_nodes[tid]->node);
 }
 
 int zm_hmcs_init(zm_hmcs_t * handle) {
@@ -545,19 +478,36 @@ int zm_hmcs_destroy(zm_hmcs_t *L) {
 }
 
 int zm_hmcs_acquire(zm_hmcs_t L){
-    hmcs_acquire((struct lock*)L);
+    hmcs_acquire((struct lock*)L, NULL);
     return 0;
 }
 
 int zm_hmcs_tryacq(zm_hmcs_t L, int *success){
-    hmcs_tryacq((struct lock*)L, success);
+    hmcs_tryacq((struct lock*)L, NULL, success);
     return 0;
 }
 int zm_hmcs_release(zm_hmcs_t L){
-    hmcs_release((struct lock*)L);
+    hmcs_release((struct lock*)L, NULL);
     return 0;
 }
 int zm_hmcs_nowaiters(zm_hmcs_t L){
-    return hmcs_nowaiters((struct lock*)L);
+    return hmcs_nowaiters((struct lock*)L, NULL);
+}
+
+int zm_hmcs_acquire_c(zm_hmcs_t L, zm_hmcs_qnode_t *Q){
+    hmcs_acquire((struct lock*)L, Q);
+    return 0;
+}
+
+int zm_hmcs_tryacq_c(zm_hmcs_t L, zm_hmcs_qnode_t *Q, int *success){
+    hmcs_tryacq((struct lock*)L, Q, success);
+    return 0;
+}
+int zm_hmcs_release_c(zm_hmcs_t L, zm_hmcs_qnode_t *Q){
+    hmcs_release((struct lock*)L, Q);
+    return 0;
+}
+int zm_hmcs_nowaiters_c(zm_hmcs_t L, zm_hmcs_qnode_t *Q){
+    return hmcs_nowaiters((struct lock*)L, Q);
 }
 
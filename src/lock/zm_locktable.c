@@ -0,0 +1,143 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lock/zm_locktable.h"
+#include "lock/zm_ticket.h"
+#include "lock/zm_mcs.h"
+#include "lock/zm_hmcs.h"
+#include "lock/zm_tlp.h"
+#include "lock/zm_mcsp.h"
+
+/* Helper functions */
+
+#if (ZM_LOCKTABLE_LOCK == ZM_TICKET)
+#define zm_lt_init_stripe(S)    zm_ticket_init(&(S)->lock)
+#define zm_lt_destroy_stripe(S) zm_ticket_destroy(&(S)->lock)
+#define zm_lt_acquire_stripe(S) zm_ticket_acquire(&(S)->lock)
+#define zm_lt_release_stripe(S) zm_ticket_release(&(S)->lock)
+#elif (ZM_LOCKTABLE_LOCK == ZM_MCS)
+#define zm_lt_init_stripe(S)    zm_mcs_init(&(S)->lock)
+#define zm_lt_destroy_stripe(S) zm_mcs_destroy(&(S)->lock)
+#define zm_lt_acquire_stripe(S) zm_mcs_acquire((S)->lock)
+#define zm_lt_release_stripe(S) zm_mcs_release((S)->lock)
+#elif (ZM_LOCKTABLE_LOCK == ZM_HMCS)
+#define zm_lt_init_stripe(S)    zm_hmcs_init(&(S)->lock)
+#define zm_lt_destroy_stripe(S) zm_hmcs_destroy(&(S)->lock)
+#define zm_lt_acquire_stripe(S) zm_hmcs_acquire((S)->lock)
+#define zm_lt_release_stripe(S) zm_hmcs_release((S)->lock)
+#elif (ZM_LOCKTABLE_LOCK == ZM_TLP)
+#define zm_lt_init_stripe(S)    zm_tlp_init(&(S)->lock)
+#define zm_lt_destroy_stripe(S) zm_tlp_destroy(&(S)->lock)
+#define zm_lt_acquire_stripe(S) zm_tlp_acquire(&(S)->lock)
+#define zm_lt_release_stripe(S) zm_tlp_release(&(S)->lock)
+#elif (ZM_LOCKTABLE_LOCK == ZM_MCSP)
+#define zm_lt_init_stripe(S)    zm_mcsp_init(&(S)->lock)
+#define zm_lt_destroy_stripe(S) zm_mcsp_destroy(&(S)->lock)
+#define zm_lt_acquire_stripe(S) zm_mcsp_acquire(&(S)->lock)
+#define zm_lt_release_stripe(S) zm_mcsp_release(&(S)->lock)
+#endif
+
+/* Stripe lists of up to this length are kept on the stack */
+#define ZM_LT_STACK_STRIPES 64
+
+/* Map the keys to stripes and sort them in increasing order without
+ * duplicates. Returns the number of distinct stripes. */
+static inline int sorted_stripes(zm_locktable_t *T, const zm_ptr_t keys[],
+                                 int n, unsigned stripes[]) {
+    int i, j, m = 0;
+    for (i = 0; i < n; i++) {
+        unsigned s = zm_locktable_stripe(T, keys[i]);
+        /* insertion sort: n is expected to be small */
+        for (j = m; j > 0 && stripes[j-1] > s; j--)
+            ;
+        if (j > 0 && stripes[j-1] == s)
+            continue;
+        memmove(&stripes[j+1], &stripes[j], (m - j) * sizeof(unsigned));
+        stripes[j] = s;
+        m++;
+    }
+    return m;
+}
+
+/* Buffer for the distinct stripes of n keys: buf if large enough, else a
+ * heap one (NULL if out of memory) to be released with put_stripe_buf */
+static inline unsigned *get_stripe_buf(zm_locktable_t *T, int n, unsigned buf[]) {
+    unsigned max = ((unsigned) n < T->nstripes) ? (unsigned) n : T->nstripes;
+    if (max <= ZM_LT_STACK_STRIPES)
+        return buf;
+    return (unsigned *) malloc(sizeof(unsigned) * max);
+}
+
+static inline void put_stripe_buf(unsigned *stripes, unsigned buf[]) {
+    if (stripes != buf)
+        free(stripes);
+}
+
+int zm_locktable_init(zm_locktable_t *T, unsigned nstripes) {
+    unsigned i, log2n = 0;
+    while ((1u << log2n) < nstripes)
+        log2n++;
+    T->nstripes = 1u << log2n;
+    T->shift = 64 - log2n;
+    if (posix_memalign((void **) &T->stripes, ZM_CACHELINE_SIZE,
+                       sizeof(struct zm_lt_stripe) * T->nstripes) != 0) {
+        T->stripes = NULL;
+        T->nstripes = 0;
+        return -1;
+    }
+    for (i = 0; i < T->nstripes; i++)
+        zm_lt_init_stripe(&T->stripes[i]);
+    return 0;
+}
+
+int zm_locktable_destroy(zm_locktable_t *T) {
+    unsigned i;
+    for (i = 0; i < T->nstripes; i++)
+        zm_lt_destroy_stripe(&T->stripes[i]);
+    free(T->stripes);
+    T->stripes = NULL;
+    T->nstripes = 0;
+    return 0;
+}
+
+int zm_locktable_acquire(zm_locktable_t *T, zm_ptr_t key) {
+    return zm_lt_acquire_stripe(&T->stripes[zm_locktable_stripe(T, key)]);
+}
+
+int zm_locktable_release(zm_locktable_t *T, zm_ptr_t key) {
+    return zm_lt_release_stripe(&T->stripes[zm_locktable_stripe(T, key)]);
+}
+
+int zm_locktable_acquire_many(zm_locktable_t *T, const zm_ptr_t keys[], int n) {
+    unsigned buf[ZM_LT_STACK_STRIPES], *stripes;
+    int i, m;
+    if (n <= 0)
+        return 0;
+    stripes = get_stripe_buf(T, n, buf);
+    if (stripes == NULL)
+        return -1;
+    m = sorted_stripes(T, keys, n, stripes);
+    for (i = 0; i < m; i++)
+        zm_lt_acquire_stripe(&T->stripes[stripes[i]]);
+    put_stripe_buf(stripes, buf);
+    return 0;
+}
+
+int zm_locktable_release_many(zm_locktable_t *T, const zm_ptr_t keys[], int n) {
+    unsigned buf[ZM_LT_STACK_STRIPES], *stripes;
+    int i, m;
+    if (n <= 0)
+        return 0;
+    stripes = get_stripe_buf(T, n, buf);
+    if (stripes == NULL)
+        return -1;
+    m = sorted_stripes(T, keys, n, stripes);
+    for (i = m - 1; i >= 0; i--)
+        zm_lt_release_stripe(&T->stripes[stripes[i]]);
+    put_stripe_buf(stripes, buf);
+    return 0;
+}
@@ -15,6 +15,17 @@ struct zm_mcs {
 
 static zm_thread_local int tid = -1;
 
+/* Asynchronous acquisitions: inbox bound to the calling thread, and
+ * continuations granted the lock that this thread has to run. The ready
+ * list turns the nested grants that happen when a continuation releases
+ * the lock into a loop. */
+static zm_thread_local zm_mcs_inbox_t *my_inbox = NULL;
+static zm_thread_local zm_mcs_anode_t *ready_head = NULL;
+static zm_thread_local zm_mcs_anode_t *ready_tail = NULL;
+static zm_thread_local int dispatching = 0;
+
+static void grant_async(zm_mcs_anode_t *A);
+
 /* Check the actual affinity mask assigned to the thread */
 static inline void check_affinity(hwloc_topology_t topo) {
     hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
@@ -66,8 +77,9 @@ static inline int acquire_c(struct zm_mcs *L, zm_mcs_qnode_t* I) {
     if((zm_ptr_t)pred != ZM_NULL) {
         zm_atomic_store(&I->status, ZM_LOCKED, zm_memord_release);
         zm_atomic_store(&pred->next, (zm_ptr_t)I, zm_memord_release);
+        unsigned spins = 0;
         while(zm_atomic_load(&I->status, zm_memord_acquire) != ZM_UNLOCKED)
-            ; /* SPIN */
+            zm_wait_spin(&spins);
     }
     return 0;
 }
@@ -96,10 +108,15 @@ static inline int release_c(struct zm_mcs *L, zm_mcs_qnode_t *I) {
                                              zm_memord_acq_rel,
                                              zm_memord_acquire))
             return 0;
+        unsigned spins = 0;
         while(zm_atomic_load(&I->next, zm_memord_acquire) == ZM_NULL)
-            ; /* SPIN */
+            zm_wait_spin(&spins);
     }
-    zm_atomic_store(&((zm_mcs_qnode_t*)zm_atomic_load(&I->next, zm_memord_acquire))->status, ZM_UNLOCKED, zm_memord_release);
+    zm_mcs_qnode_t *succ = (zm_mcs_qnode_t*)zm_atomic_load(&I->next, zm_memord_acquire);
+    if (zm_atomic_load(&succ->status, zm_memord_acquire) == ZM_ASYNC)
+        grant_async((zm_mcs_anode_t*)succ);
+    else
+        zm_atomic_store(&succ->status, ZM_UNLOCKED, zm_memord_release);
     return 0;
 }
 
@@ -153,6 +170,78 @@ static inline int mcs_nowaiters_c(struct zm_mcs *L, zm_mcs_qnode_t *I) {
     return nowaiters_c(L, I);
 }
 
+/* Asynchronous API */
+static void run_async(zm_mcs_anode_t *A) {
+    struct zm_mcs *L = (struct zm_mcs*)(void *)A->lock;
+    int allocated = A->allocated;
+    A->cb(A->arg);
+    /* A may be reused by its owner once released */
+    release_c(L, &A->qnode);
+    if (allocated)
+        free(A);
+}
+
+static void run_ready(zm_mcs_anode_t *A) {
+    A->next_ready = NULL;
+    if (ready_tail != NULL)
+        ready_tail->next_ready = A;
+    else
+        ready_head = A;
+    ready_tail = A;
+    if (dispatching)
+        return;
+    dispatching = 1;
+    while ((A = ready_head) != NULL) {
+        ready_head = A->next_ready;
+        if (ready_head == NULL)
+            ready_tail = NULL;
+        run_async(A);
+    }
+    dispatching = 0;
+}
+
+static void inbox_push(zm_mcs_inbox_t *inbox, zm_mcs_anode_t *A) {
+    zm_ptr_t head;
+    do {
+        head = zm_atomic_load(&inbox->head, zm_memord_acquire);
+        A->next_ready = (zm_mcs_anode_t*)(void *)head;
+    } while (!zm_atomic_compare_exchange_weak(&inbox->head, &head, (zm_ptr_t)A,
+                                              zm_memord_acq_rel, zm_memord_acquire));
+}
+
+/* The lock has been passed to A */
+static void grant_async(zm_mcs_anode_t *A) {
+    if (A->inbox != NULL)
+        inbox_push(A->inbox, A);
+    else
+        run_ready(A);
+}
+
+static inline int mcs_acquire_async_c(struct zm_mcs *L, zm_mcs_anode_t *A,
+                                      zm_lock_cb_t cb, zm_ptr_t arg) {
+    A->lock = (zm_mcs_t)L;
+    A->cb = cb;
+    A->arg = arg;
+    A->inbox = my_inbox;
+    zm_atomic_store(&A->qnode.next, ZM_NULL, zm_memord_relaxed);
+    zm_atomic_store(&A->qnode.status, ZM_ASYNC, zm_memord_relaxed);
+    zm_mcs_qnode_t* pred = (zm_mcs_qnode_t*)zm_atomic_exchange_ptr(&L->lock, (zm_ptr_t)&A->qnode, zm_memord_acq_rel);
+    if((zm_ptr_t)pred != ZM_NULL)
+        zm_atomic_store(&pred->next, (zm_ptr_t)&A->qnode, zm_memord_release);
+    else
+        run_ready(A); /* free lock: run the continuation right away */
+    return 0;
+}
+
+/* Wait morphing: append I, whose owner already reset it and waits on its
+ * status, to the queue. The caller holds the lock, so I has a predecessor. */
+static inline int mcs_requeue_c(struct zm_mcs *L, zm_mcs_qnode_t *I) {
+    zm_mcs_qnode_t* pred = (zm_mcs_qnode_t*)zm_atomic_exchange_ptr(&L->lock, (zm_ptr_t)I, zm_memord_acq_rel);
+    assert((zm_ptr_t)pred != ZM_NULL);
+    zm_atomic_store(&pred->next, (zm_ptr_t)I, zm_memord_release);
+    return 0;
+}
+
 static inline int free_lock(struct zm_mcs *L)
 {
     free(L->local_nodes);
@@ -211,3 +300,65 @@ int zm_mcs_release_c(zm_mcs_t L, zm_mcs_qnode_t *I) {
 int zm_mcs_nowaiters_c(zm_mcs_t L, zm_mcs_qnode_t *I) {
     return mcs_nowaiters_c((struct zm_mcs*)(void *)L, I) ;
 }
+
+int zm_mcs_local_qnode(zm_mcs_t L, zm_mcs_qnode_t **I) {
+    assert(tid >= 0);
+    *I = &((struct zm_mcs*)(void *)L)->local_nodes[tid];
+    return 0;
+}
+
+int zm_mcs_requeue_c(zm_mcs_t L, zm_mcs_qnode_t *I) {
+    return mcs_requeue_c((struct zm_mcs*)(void *)L, I);
+}
+
+/* Asynchronous API */
+int zm_mcs_acquire_async(zm_mcs_t L, zm_lock_cb_t cb, zm_ptr_t arg) {
+    zm_mcs_anode_t *A;
+    if (posix_memalign((void **) &A, ZM_CACHELINE_SIZE, sizeof(zm_mcs_anode_t)) != 0)
+        return -1;
+    A->allocated = 1;
+    return mcs_acquire_async_c((struct zm_mcs*)(void *)L, A, cb, arg);
+}
+
+int zm_mcs_acquire_async_c(zm_mcs_t L, zm_mcs_anode_t *A, zm_lock_cb_t cb, zm_ptr_t arg) {
+    A->allocated = 0;
+    return mcs_acquire_async_c((struct zm_mcs*)(void *)L, A, cb, arg);
+}
+
+int zm_mcs_inbox_init(zm_mcs_inbox_t *inbox) {
+    zm_atomic_store(&inbox->head, ZM_NULL, zm_memord_release);
+    return 0;
+}
+
+int zm_mcs_inbox_destroy(zm_mcs_inbox_t *inbox) {
+    assert(zm_atomic_load(&inbox->head, zm_memord_acquire) == ZM_NULL);
+    return 0;
+}
+
+int zm_mcs_inbox_bind(zm_mcs_inbox_t *inbox) {
+    my_inbox = inbox;
+    return 0;
+}
+
+int zm_mcs_inbox_poll(zm_mcs_inbox_t *inbox, int *nran) {
+    zm_mcs_anode_t *A, *fifo = NULL, *next;
+    int n = 0;
+    A = (zm_mcs_anode_t*)(void *)zm_atomic_exchange_ptr(&inbox->head, ZM_NULL, zm_memord_acq_rel);
+    /* the inbox is a stack: reverse it to run the continuations in the
+     * order they were granted the lock */
+    while (A != NULL) {
+        next = A->next_ready;
+        A->next_ready = fifo;
+        fifo = A;
+        A = next;
+    }
+    while (fifo != NULL) {
+        next = fifo->next_ready;
+        run_async(fifo);
+        fifo = next;
+        n++;
+    }
+    if (nran != NULL)
+        *nran = n;
+    return 0;
+}
@@ -4,35 +4,35 @@
  */
 
 #include <stdlib.h>
+#include <pthread.h>
 #include "lock/zm_mmcs.h"
 
+/* The address of this variable identifies the calling thread */
+static zm_thread_local char self_tag;
+#define SELF ((zm_ptr_t)&self_tag)
+
 int zm_mmcs_init(zm_mmcs_t *L)
 {
     zm_atomic_store(&L->lock, ZM_NULL, zm_memord_release);
     L->cur_ctx = (zm_mcs_qnode_t*)ZM_NULL;
+    zm_atomic_store(&L->owner, ZM_NULL, zm_memord_relaxed);
+    L->depth = 0;
     return 0;
 }
 
-int zm_mmcs_acquire(zm_mmcs_t *L, zm_mcs_qnode_t* I) {
-    if((zm_ptr_t)I == ZM_NULL)
-        I = L->cur_ctx;
+static inline void acquire_c(zm_mmcs_t *L, zm_mcs_qnode_t* I) {
     zm_atomic_store(&I->next, ZM_NULL, zm_memord_release);
     zm_mcs_qnode_t* pred = (zm_mcs_qnode_t*)zm_atomic_exchange_ptr(&L->lock, (zm_ptr_t)I, zm_memord_acq_rel);
     if((zm_ptr_t)pred != ZM_NULL) {
         zm_atomic_store(&I->status, ZM_LOCKED, zm_memord_release);
         zm_atomic_store(&pred->next, (zm_ptr_t)I, zm_memord_release);
+        unsigned spins = 0;
         while(zm_atomic_load(&I->status, zm_memord_acquire) != ZM_UNLOCKED)
-            ; /* SPIN */
+            zm_wait_spin(&spins);
     }
-    L->cur_ctx = I; /* save current local context*/
-    return 0;
 }
 
-/* Release the lock */
-int zm_mmcs_release(zm_mmcs_t *L, zm_mcs_qnode_t** ctxt) {
-    zm_mcs_qnode_t* I = L->cur_ctx; /* get current local context */
-    *ctxt = I; /* return previous context*/
-    L->cur_ctx = (zm_mcs_qnode_t*)ZM_NULL;
+static inline void release_c(zm_mmcs_t *L, zm_mcs_qnode_t* I) {
     if (zm_atomic_load(&I->next, zm_memord_acquire) == ZM_NULL) {
         zm_mcs_qnode_t *tmp = I;
         if(zm_atomic_compare_exchange_strong(&L->lock,
@@ -40,11 +40,147 @@ int zm_mmcs_release(zm_mmcs_t *L, zm_mcs_qnode_t** ctxt) {
                                              ZM_NULL,
                                              zm_memord_acq_rel,
                                              zm_memord_acquire))
-            return 0;
+            return;
+        unsigned spins = 0;
         while(zm_atomic_load(&I->next, zm_memord_acquire) == ZM_NULL)
-            ; /* SPIN */
+            zm_wait_spin(&spins);
     }
     zm_atomic_store(&((zm_mcs_qnode_t*)zm_atomic_load(&I->next, zm_memord_acquire))->status, ZM_UNLOCKED, zm_memord_release);
+}
+
+/* Context and recursion depth of a holder that released the lock from a
+ * nested scope and will reacquire it without a context. Frames are kept
+ * per thread, one per lock at most, in an open-addressing hash table on
+ * the lock address that grows to keep the load below one half, so that
+ * finding the frame of a lock does not depend on how many locks the
+ * thread has released this way. The table is freed when the thread
+ * exits. */
+struct zm_mmcs_frame {
+    zm_mmcs_t *lock;            /* NULL for a free slot */
+    zm_mcs_qnode_t *ctx;
+    unsigned depth;
+};
+
+static zm_thread_local struct zm_mmcs_frame *frames = NULL;
+static zm_thread_local unsigned nframes = 0;
+static zm_thread_local unsigned maxframes = 0; /* power of two */
+
+static pthread_key_t frames_key;
+static pthread_once_t frames_key_once = PTHREAD_ONCE_INIT;
+
+static void frames_free(void *arg) {
+    free(arg);
+}
+
+static void frames_key_create(void) {
+    pthread_key_create(&frames_key, frames_free);
+}
+
+/* Fibonacci hashing of the lock address */
+static inline unsigned frame_slot(zm_mmcs_t *L) {
+    return (unsigned)(((uint64_t)(zm_ptr_t)L * 0x9E3779B97F4A7C15ull) >> 32) & (maxframes - 1);
+}
+
+static inline int find_frame(zm_mmcs_t *L) {
+    unsigned i;
+    if (nframes == 0)
+        return -1;
+    for (i = frame_slot(L); frames[i].lock != NULL; i = (i + 1) & (maxframes - 1))
+        if (frames[i].lock == L)
+            return (int)i;
+    return -1;
+}
+
+/* Linear probing: move back the entries that would no longer be found */
+static inline void remove_frame(int f) {
+    unsigned mask = maxframes - 1, i = (unsigned)f, j = i, home;
+    while (1) {
+        j = (j + 1) & mask;
+        if (frames[j].lock == NULL)
+            break;
+        home = frame_slot(frames[j].lock);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            frames[i] = frames[j];
+            i = j;
+        }
+    }
+    frames[i].lock = NULL;
+    nframes--;
+}
+
+static inline void insert_frame(zm_mmcs_t *L, zm_mcs_qnode_t *ctx, unsigned depth) {
+    unsigned i = frame_slot(L);
+    while (frames[i].lock != NULL)
+        i = (i + 1) & (maxframes - 1);
+    frames[i].lock = L;
+    frames[i].ctx = ctx;
+    frames[i].depth = depth;
+    nframes++;
+}
+
+static inline int save_frame(zm_mmcs_t *L, zm_mcs_qnode_t *ctx, unsigned depth) {
+    if (2 * (nframes + 1) > maxframes) {
+        struct zm_mmcs_frame *old = frames;
+        unsigned i, oldmax = maxframes;
+        unsigned max = (maxframes == 0) ? 8 : 2 * maxframes;
+        struct zm_mmcs_frame *tmp = calloc(max, sizeof *frames);
+        if (tmp == NULL)
+            return -1;
+        if (old == NULL)
+            pthread_once(&frames_key_once, frames_key_create);
+        pthread_setspecific(frames_key, tmp);
+        frames = tmp;
+        maxframes = max;
+        nframes = 0;
+        for (i = 0; i < oldmax; i++)
+            if (old[i].lock != NULL)
+                insert_frame(old[i].lock, old[i].ctx, old[i].depth);
+        free(old);
+    }
+    insert_frame(L, ctx, depth);
+    return 0;
+}
+
+/* Memorizing API */
+int zm_mmcs_acquire(zm_mmcs_t *L, zm_mcs_qnode_t* I) {
+    int f;
+    unsigned depth = 1;
+    if (zm_atomic_load(&L->owner, zm_memord_relaxed) == SELF) {
+        L->depth++;
+        return 0;
+    }
+    f = find_frame(L);
+    if((zm_ptr_t)I == ZM_NULL) {
+        if (f < 0)
+            return -1; /* no saved context to reacquire the lock with */
+        I = frames[f].ctx;
+        depth = frames[f].depth;
+        remove_frame(f);
+    } else if (f >= 0) {
+        /* reacquiring with the context returned by zm_mmcs_release
+         * restores the recursion depth; any other context starts a
+         * new outermost scope */
+        if (frames[f].ctx == I)
+            depth = frames[f].depth;
+        remove_frame(f);
+    }
+    acquire_c(L, I);
+    L->cur_ctx = I; /* save current local context*/
+    zm_atomic_store(&L->owner, SELF, zm_memord_relaxed);
+    L->depth = depth;
+    return 0;
+}
+
+/* Release the lock */
+int zm_mmcs_release(zm_mmcs_t *L, zm_mcs_qnode_t** ctxt) {
+    zm_mcs_qnode_t* I = L->cur_ctx; /* get current local context */
+    if (save_frame(L, I, L->depth) != 0)
+        return -1; /* out of memory: the lock is still held */
+    *ctxt = I; /* return previous context*/
+    L->cur_ctx = (zm_mcs_qnode_t*)ZM_NULL;
+    L->depth = 0;
+    zm_atomic_store(&L->owner, ZM_NULL, zm_memord_relaxed);
+    release_c(L, I);
     return 0;
 }
 
@@ -53,6 +189,25 @@ int zm_mmcs_nowaiters(zm_mmcs_t *L) {
     return (zm_atomic_load(&I->next, zm_memord_acquire) == ZM_NULL);
 }
 
+/* Reentrant API */
+int zm_mmcs_acquire_c(zm_mmcs_t *L, zm_mcs_qnode_t* I) {
+    if (zm_atomic_load(&L->owner, zm_memord_relaxed) == SELF) {
+        L->depth++;
+        return 0;
+    }
+    return zm_mmcs_acquire(L, I);
+}
+
+int zm_mmcs_release_c(zm_mmcs_t *L, zm_mcs_qnode_t* I) {
+    zm_mcs_qnode_t* ctx = L->cur_ctx;
+    if (--L->depth > 0)
+        return 0;
+    L->cur_ctx = (zm_mcs_qnode_t*)ZM_NULL;
+    zm_atomic_store(&L->owner, ZM_NULL, zm_memord_relaxed);
+    release_c(L, ctx);
+    return 0;
+}
+
 int zm_mmcs_destroy(zm_mmcs_t *L)
 {
     return 0;
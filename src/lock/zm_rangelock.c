@@ -0,0 +1,158 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include "lock/zm_rangelock.h"
+#include "mem/zm_hzdptr.h"
+#include "mem/zm_pool.h"
+
+/* Requests are appended to the tail of a singly-linked list with a single
+ * exchange, so the list order is the arrival order. The head is advanced
+ * over released requests only (never over a held or waiting one); the
+ * passed nodes go back to the pool once no hazard pointer refers to them
+ * (zm_pool_retire). Before the head passes a node, the node's next pointer
+ * is marked. A traversal that reads an unmarked next pointer after
+ * publishing its hazard pointer on the successor knows that the successor
+ * cannot have been retired. */
+
+#define ZM_RL_MARK     ((zm_ptr_t)1)
+#define ZM_RL_MARKED(p) ((p) & ZM_RL_MARK)
+#define ZM_RL_UNMARK(p) ((p) & ~ZM_RL_MARK)
+
+static zm_pool_t zm_rlnode_pool = ZM_POOL_INITIALIZER(sizeof(zm_rlnode_t),
+                                                      __alignof__(zm_rlnode_t));
+
+static inline int conflicts(zm_rlnode_t *a, zm_rlnode_t *b) {
+    if (a->mode == ZM_RANGELOCK_READ && b->mode == ZM_RANGELOCK_READ)
+        return 0;
+    return (a->start < b->end && b->start < a->end);
+}
+
+static inline zm_rlnode_t *protect_head(zm_rangelock_t *L, zm_hzdptr_t *hzdptrs) {
+    zm_rlnode_t *head;
+    do {
+        head = (zm_rlnode_t*)zm_atomic_load(&L->head, zm_memord_acquire);
+        hzdptrs[0] = (zm_hzdptr_t)head;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+    } while ((zm_ptr_t)head != zm_atomic_load(&L->head, zm_memord_acquire));
+    return head;
+}
+
+/* Returns NULL if out of memory */
+static inline zm_rlnode_t *new_node(zm_ulong_t start, zm_ulong_t end, unsigned mode) {
+    zm_rlnode_t *node = zm_pool_alloc(&zm_rlnode_pool);
+    if (node == NULL)
+        return NULL;
+    node->start = start;
+    node->end = end;
+    node->mode = mode;
+    zm_atomic_store(&node->status, ZM_LOCKED, zm_memord_relaxed);
+    zm_atomic_store(&node->next, ZM_NULL, zm_memord_relaxed);
+    return node;
+}
+
+static inline int acquire(zm_rangelock_t *L, zm_ulong_t start, zm_ulong_t end,
+                          unsigned mode, zm_rlnode_t **ctxt) {
+    zm_rlnode_t *me = new_node(start, end, mode);
+    zm_rlnode_t *pred, *cur;
+    zm_ptr_t next;
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+
+    if (me == NULL)
+        return -1;
+
+    /* enqueue: pred cannot be passed by the head before we link to it */
+    pred = (zm_rlnode_t*)zm_atomic_exchange_ptr(&L->tail, (zm_ptr_t)me, zm_memord_acq_rel);
+    zm_atomic_store(&pred->next, (zm_ptr_t)me, zm_memord_release);
+
+    /* wait for all the older conflicting requests */
+restart:
+    cur = protect_head(L, hzdptrs);
+    while (cur != me) {
+        unsigned spins = 0;
+        if (conflicts(cur, me))
+            while (zm_atomic_load(&cur->status, zm_memord_acquire) == ZM_LOCKED)
+                zm_wait_spin(&spins);
+        while ((next = zm_atomic_load(&cur->next, zm_memord_acquire)) == ZM_NULL)
+            zm_wait_spin(&spins); /* an older request is still linking */
+        if (ZM_RL_MARKED(next))
+            goto restart; /* cur is being passed by the head */
+        hzdptrs[1] = (zm_hzdptr_t)next;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        if (zm_atomic_load(&cur->next, zm_memord_acquire) != next)
+            goto restart;
+        cur = (zm_rlnode_t*)next;
+        hzdptrs[0] = (zm_hzdptr_t)cur;
+    }
+    hzdptrs[0] = ZM_NULL;
+    hzdptrs[1] = ZM_NULL;
+    *ctxt = me;
+    return 0;
+}
+
+static inline void advance_head(zm_rangelock_t *L) {
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    zm_rlnode_t *head;
+    zm_ptr_t next;
+    while (1) {
+        head = protect_head(L, hzdptrs);
+        if (zm_atomic_load(&head->status, zm_memord_acquire) == ZM_LOCKED)
+            break;
+        next = zm_atomic_load(&head->next, zm_memord_acquire);
+        if (next == ZM_NULL)
+            break; /* keep the youngest node as the list anchor */
+        if (!ZM_RL_MARKED(next))
+            zm_atomic_compare_exchange_strong(&head->next, &next, next | ZM_RL_MARK,
+                                              zm_memord_acq_rel, zm_memord_acquire);
+        next = ZM_RL_UNMARK(zm_atomic_load(&head->next, zm_memord_acquire));
+        zm_ptr_t expected = (zm_ptr_t)head;
+        if (zm_atomic_compare_exchange_strong(&L->head, &expected, next,
+                                              zm_memord_acq_rel, zm_memord_acquire)) {
+            hzdptrs[0] = ZM_NULL;
+            zm_pool_retire(&zm_rlnode_pool, head);
+        }
+    }
+    hzdptrs[0] = ZM_NULL;
+}
+
+static inline int release(zm_rangelock_t *L, zm_rlnode_t *node) {
+    zm_atomic_store(&node->status, ZM_UNLOCKED, zm_memord_release);
+    advance_head(L);
+    return 0;
+}
+
+int zm_rangelock_init(zm_rangelock_t *L) {
+    zm_rlnode_t *anchor = new_node(0, 0, ZM_RANGELOCK_READ);
+    if (anchor == NULL)
+        return -1;
+    zm_atomic_store(&anchor->status, ZM_UNLOCKED, zm_memord_relaxed);
+    zm_atomic_store(&L->head, (zm_ptr_t)anchor, zm_memord_release);
+    zm_atomic_store(&L->tail, (zm_ptr_t)anchor, zm_memord_release);
+    return 0;
+}
+
+int zm_rangelock_destroy(zm_rangelock_t *L) {
+    zm_ptr_t cur = zm_atomic_load(&L->head, zm_memord_acquire);
+    while (cur != ZM_NULL) {
+        zm_ptr_t next = ZM_RL_UNMARK(zm_atomic_load(&((zm_rlnode_t*)cur)->next, zm_memord_acquire));
+        zm_pool_free(&zm_rlnode_pool, (void*)cur);
+        cur = next;
+    }
+    zm_atomic_store(&L->head, ZM_NULL, zm_memord_release);
+    zm_atomic_store(&L->tail, ZM_NULL, zm_memord_release);
+    return 0;
+}
+
+int zm_rangelock_acquire(zm_rangelock_t *L, zm_ulong_t start, zm_ulong_t end, zm_rlnode_t **ctxt) {
+    return acquire(L, start, end, ZM_RANGELOCK_WRITE, ctxt);
+}
+
+int zm_rangelock_acquire_rd(zm_rangelock_t *L, zm_ulong_t start, zm_ulong_t end, zm_rlnode_t **ctxt) {
+    return acquire(L, start, end, ZM_RANGELOCK_READ, ctxt);
+}
+
+int zm_rangelock_release(zm_rangelock_t *L, zm_rlnode_t *node) {
+    return release(L, node);
+}
@@ -16,8 +16,9 @@ int zm_ticket_init(zm_ticket_t *lock)
    Then spin on now_serving until it equals my ticket. */
 int zm_ticket_acquire(zm_ticket_t* lock) {
     unsigned my_ticket = zm_atomic_fetch_add(&lock->next_ticket, 1, zm_memord_acq_rel);
+    unsigned spins = 0;
     while(zm_atomic_load(&lock->now_serving, zm_memord_acquire) != my_ticket)
-            ; /* SPIN */
+        zm_wait_spin(&spins);
     return 0;
 }
 
@@ -0,0 +1,124 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lock/zm_topo.h"
+
+#ifndef HMCS_DEFAULT_MAX_LEVELS
+#define HMCS_DEFAULT_MAX_LEVELS 3
+#endif
+
+zm_thread_local int zm_topo_pu = -2;
+
+int zm_topo_nbound_pus(hwloc_topology_t topo) {
+    hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
+    int set_length;
+    hwloc_get_cpubind(topo, cpuset, HWLOC_CPUBIND_THREAD);
+    set_length = hwloc_get_nbobjs_inside_cpuset_by_type(topo, cpuset, HWLOC_OBJ_PU);
+    hwloc_bitmap_free(cpuset);
+    return set_length;
+}
+
+int zm_topo_hwthread_id(hwloc_topology_t topo) {
+    hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
+    hwloc_obj_t obj;
+    hwloc_get_cpubind(topo, cpuset, HWLOC_CPUBIND_THREAD);
+    obj = hwloc_get_obj_inside_cpuset_by_type(topo, cpuset, HWLOC_OBJ_PU, 0);
+    hwloc_bitmap_free(cpuset);
+    return obj->logical_index;
+}
+
+int zm_topo_bound_pu(hwloc_topology_t topo) {
+    return (zm_topo_nbound_pus(topo) == 1) ? zm_topo_hwthread_id(topo) : -1;
+}
+
+hwloc_obj_t zm_topo_package(hwloc_topology_t topo) {
+    hwloc_obj_t pu, pkg = NULL;
+    pu = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PU, zm_topo_hwthread_id(topo));
+    if (pu != NULL)
+        pkg = hwloc_get_ancestor_obj_by_type(topo, HWLOC_OBJ_PACKAGE, pu);
+    if (pkg == NULL)
+        pkg = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PACKAGE, 0);
+    if (pkg == NULL)
+        pkg = hwloc_get_root_obj(topo);
+    return pkg;
+}
+
+int zm_topo_hierarchy(hwloc_topology_t topo, int *max_threads, int** particip_per_level) {
+    int max_depth, levels = 0, max_levels = HMCS_DEFAULT_MAX_LEVELS, explicit_levels = 0;
+    char tmp[20];
+    char *s = getenv("ZM_HMCS_MAX_LEVELS");
+    if (s != NULL)
+        max_levels = atoi(s);
+    int depths[max_levels];
+    int idx = 0;
+    /* advice to users: run `hwloc-ls -s --no-io --no-icaches` and choose
+     * depths of interest in ascending order. The first depth must be `0' */
+
+    s = getenv("ZM_HMCS_EXPLICIT_LEVELS");
+    if (s != NULL) {
+        strcpy(tmp, s);
+        explicit_levels = 1;
+        char* token;
+        token = strtok(tmp,",");
+        while(token != NULL) {
+            depths[idx] = atoi(token);
+            if (idx == 0)
+                assert(depths[idx] == 0 && "the first depth must be machine level (i.e., depth 0), run `hwloc-ls -s --no-io --no-icaches` and choose appropriate depth values");
+            idx++;
+            token = strtok(NULL,",");
+        }
+        assert(idx == max_levels);
+    }
+
+    *max_threads = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_PU);
+
+    max_depth = hwloc_topology_get_depth(topo);
+    assert(max_depth >= 2); /* At least Machine and Core levels exist */
+
+    *particip_per_level = (int*) malloc(max_levels * sizeof(int));
+    int prev_nobjs = -1;
+    if(!explicit_levels) {
+        for (int d = max_depth - 2; d > 1; d--) {
+            int cur_nobjs = hwloc_get_nbobjs_by_depth(topo, d);
+            /* Check if this level has a hierarchical impact */
+            if(cur_nobjs != prev_nobjs) {
+                prev_nobjs = cur_nobjs;
+                (*particip_per_level)[levels] = (*max_threads)/cur_nobjs;
+                levels++;
+                if(levels >= max_levels - 1)
+                    break;
+            }
+        }
+        (*particip_per_level)[levels] = *max_threads;
+        levels++;
+    } else {
+        for(int i = max_levels - 1; i >= 0; i--){
+            int d = depths[i];
+            int cur_nobjs = hwloc_get_nbobjs_by_depth(topo, d);
+            /* Check if this level has a hierarchical impact */
+            if(cur_nobjs != prev_nobjs) {
+                prev_nobjs = cur_nobjs;
+                (*particip_per_level)[levels] = (*max_threads)/cur_nobjs;
+                levels++;
+            } else {
+                assert(0 && "plz choose levels that have a hierarchical impact");
+            }
+        }
+    }
+
+    return levels;
+}
+
+int zm_topo_clusters(hwloc_topology_t topo, int *cluster_size) {
+    int max_threads, levels;
+    int *particip_per_level;
+    levels = zm_topo_hierarchy(topo, &max_threads, &particip_per_level);
+    *cluster_size = (levels >= 2) ? particip_per_level[levels - 2] : max_threads;
+    free(particip_per_level);
+    return max_threads / *cluster_size;
+}
@@ -4,5 +4,6 @@
 #
 
 zm_sources += \
-	mem/zm_hzdptr.c
+	mem/zm_hzdptr.c \
+	mem/zm_pool.c
 
@@ -0,0 +1,268 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "mem/zm_pool.h"
+#include "mem/zm_hzdptr.h"
+
+zm_thread_local zm_poolcache_t zm_pool_caches[ZM_POOL_UNCACHED];
+
+static zm_pool_t *zm_pools[ZM_POOL_MAX];
+static unsigned zm_npools = 0;
+static pthread_mutex_t zm_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* flushes the magazines of a thread when it exits */
+static pthread_key_t zm_pool_key;
+static pthread_once_t zm_pool_key_once = PTHREAD_ONCE_INIT;
+static zm_thread_local int zm_pool_thread_ready = 0;
+static zm_thread_local unsigned zm_pool_hint = 0;
+
+static zm_atomic_ulong_t zm_pool_nmallocs = 0;
+static zm_atomic_ulong_t zm_pool_nfrees = 0;
+
+/*
+     Helper functions
+ */
+
+/* Returns NULL if out of memory */
+static void *zm_pool_sys_alloc(size_t size, size_t align) {
+    void *ptr = NULL;
+    zm_atomic_fetch_add(&zm_pool_nmallocs, 1, zm_memord_relaxed);
+    if (align > sizeof(void*)) {
+        if (posix_memalign(&ptr, align, size) != 0)
+            ptr = NULL;
+    } else {
+        ptr = malloc(size);
+    }
+    return ptr;
+}
+
+static void zm_pool_sys_free(void *ptr) {
+    zm_atomic_fetch_add(&zm_pool_nfrees, 1, zm_memord_relaxed);
+    free(ptr);
+}
+
+/* The depot is an array of slots so that taking a magazine is a plain
+ * exchange, which is immune to ABA. Threads start looking at different
+ * slots. */
+static zm_poolmag_t *zm_pool_depot_get(zm_atomic_ptr_t *slots) {
+    unsigned i, s;
+    zm_ptr_t mag;
+    for (i = 0; i < ZM_POOL_DEPOTSIZE; i++) {
+        s = (zm_pool_hint + i) % ZM_POOL_DEPOTSIZE;
+        if (zm_atomic_load(&slots[s], zm_memord_relaxed) == ZM_NULL)
+            continue;
+        mag = zm_atomic_exchange_ptr(&slots[s], ZM_NULL, zm_memord_acq_rel);
+        if (mag != ZM_NULL) {
+            zm_pool_hint = s;
+            return (zm_poolmag_t*)mag;
+        }
+    }
+    return NULL;
+}
+
+static int zm_pool_depot_put(zm_atomic_ptr_t *slots, zm_poolmag_t *mag) {
+    unsigned i, s;
+    zm_ptr_t expected;
+    for (i = 0; i < ZM_POOL_DEPOTSIZE; i++) {
+        s = (zm_pool_hint + i) % ZM_POOL_DEPOTSIZE;
+        expected = ZM_NULL;
+        if (zm_atomic_load(&slots[s], zm_memord_relaxed) == ZM_NULL &&
+            zm_atomic_compare_exchange_strong(&slots[s], &expected, (zm_ptr_t)mag,
+                                              zm_memord_acq_rel, zm_memord_relaxed)) {
+            zm_pool_hint = s;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static zm_poolmag_t *zm_pool_mag_get_empty(zm_pool_t *pool) {
+    zm_poolmag_t *mag = zm_pool_depot_get(pool->empty);
+    if (mag == NULL) {
+        mag = zm_pool_sys_alloc(sizeof(zm_poolmag_t), 0);
+        if (mag != NULL)
+            mag->count = 0;
+    }
+    return mag;
+}
+
+static void zm_pool_mag_put_empty(zm_pool_t *pool, zm_poolmag_t *mag) {
+    if (!zm_pool_depot_put(pool->empty, mag))
+        zm_pool_sys_free(mag);
+}
+
+/* Give a magazine to the depot; when the depot is full, its objects go
+ * back to the system. Returns the magazine if it is left over, empty */
+static zm_poolmag_t *zm_pool_mag_put_full(zm_pool_t *pool, zm_poolmag_t *mag) {
+    if (zm_pool_depot_put(pool->full, mag))
+        return NULL;
+    while (mag->count > 0)
+        zm_pool_sys_free(mag->objs[--mag->count]);
+    return mag;
+}
+
+/* Move the objects of the retired magazine that are no longer hazardous
+ * to the pool */
+static void zm_pool_reclaim(zm_pool_t *pool, zm_poolcache_t *cache) {
+    zm_poolmag_t *retired = cache->retired;
+    int i, j = 0;
+    for (i = 0; i < retired->count; i++) {
+        void *obj = retired->objs[i];
+        if (zm_hzdptr_hazardous((zm_ptr_t)obj))
+            retired->objs[j++] = obj;
+        else
+            zm_pool_free(pool, obj);
+    }
+    retired->count = j;
+}
+
+static void zm_pool_flush(zm_pool_t *pool, zm_poolcache_t *cache) {
+    zm_poolmag_t *mags[2];
+    int i;
+    if (cache->retired != NULL) {
+        zm_pool_reclaim(pool, cache);
+        /* objects still hazardous at this point are leaked */
+        cache->retired->count = 0;
+        zm_pool_mag_put_empty(pool, cache->retired);
+    }
+    mags[0] = cache->loaded;
+    mags[1] = cache->prev;
+    for (i = 0; i < 2; i++) {
+        zm_poolmag_t *mag = mags[i];
+        if (mag != NULL && mag->count > 0)
+            mag = zm_pool_mag_put_full(pool, mag);
+        if (mag != NULL)
+            zm_pool_mag_put_empty(pool, mag);
+    }
+    cache->loaded = cache->prev = cache->retired = NULL;
+}
+
+static void zm_pool_thread_exit(void *arg) {
+    unsigned i, npools;
+    pthread_mutex_lock(&zm_pool_lock);
+    npools = zm_npools;
+    pthread_mutex_unlock(&zm_pool_lock);
+    for (i = 0; i < npools; i++)
+        zm_pool_flush(zm_pools[i], &zm_pool_caches[i]);
+}
+
+static void zm_pool_key_create(void) {
+    pthread_key_create(&zm_pool_key, zm_pool_thread_exit);
+}
+
+static inline void zm_pool_thread_init(void) {
+    if (zm_likely(zm_pool_thread_ready))
+        return;
+    pthread_once(&zm_pool_key_once, zm_pool_key_create);
+    pthread_setspecific(zm_pool_key, &zm_pool_thread_ready);
+    zm_pool_hint = (unsigned)((zm_ptr_t)&zm_pool_hint / sizeof(zm_pool_caches));
+    zm_pool_thread_ready = 1;
+}
+
+/*
+   Body of the routines
+ */
+
+unsigned zm_pool_register(zm_pool_t *pool) {
+    unsigned id;
+    pthread_mutex_lock(&zm_pool_lock);
+    id = zm_atomic_load(&pool->id, zm_memord_relaxed);
+    if (id == 0) {
+        if (zm_npools < ZM_POOL_MAX) {
+            zm_pools[zm_npools] = pool;
+            id = ++zm_npools;
+        } else {
+            id = ZM_POOL_UNCACHED;
+        }
+        zm_atomic_store(&pool->id, id, zm_memord_release);
+    }
+    pthread_mutex_unlock(&zm_pool_lock);
+    return id;
+}
+
+void *zm_pool_alloc_slow(zm_pool_t *pool) {
+    zm_poolcache_t *cache = zm_pool_cache(pool);
+    zm_poolmag_t *mag;
+
+    if (zm_unlikely(cache == &zm_pool_caches[ZM_POOL_UNCACHED - 1]))
+        return zm_pool_sys_alloc(pool->objsize, pool->align);
+    zm_pool_thread_init();
+    if (cache->prev != NULL && cache->prev->count > 0) {
+        mag = cache->prev;
+        cache->prev = cache->loaded;
+        cache->loaded = mag;
+    } else if ((mag = zm_pool_depot_get(pool->full)) != NULL) {
+        /* keep the loaded magazine, empty, for frees */
+        if (cache->prev != NULL)
+            zm_pool_mag_put_empty(pool, cache->prev);
+        cache->prev = cache->loaded;
+        cache->loaded = mag;
+    } else {
+        return zm_pool_sys_alloc(pool->objsize, pool->align);
+    }
+    return cache->loaded->objs[--cache->loaded->count];
+}
+
+void zm_pool_free_slow(zm_pool_t *pool, void *obj) {
+    zm_poolcache_t *cache = zm_pool_cache(pool);
+    zm_poolmag_t *mag = NULL;
+
+    if (zm_unlikely(cache == &zm_pool_caches[ZM_POOL_UNCACHED - 1])) {
+        zm_pool_sys_free(obj);
+        return;
+    }
+    zm_pool_thread_init();
+    if (cache->prev != NULL && cache->prev->count < ZM_POOL_MAGSIZE) {
+        mag = cache->prev;
+        cache->prev = cache->loaded;
+        cache->loaded = mag;
+    } else {
+        /* both magazines are full (or missing): hand one to the depot */
+        if (cache->prev != NULL)
+            mag = zm_pool_mag_put_full(pool, cache->prev);
+        if (mag == NULL)
+            mag = zm_pool_mag_get_empty(pool);
+        cache->prev = cache->loaded;
+        cache->loaded = mag;
+        if (zm_unlikely(mag == NULL)) {
+            /* no magazine to keep obj in */
+            zm_pool_sys_free(obj);
+            return;
+        }
+    }
+    cache->loaded->objs[cache->loaded->count++] = obj;
+}
+
+void zm_pool_retire(zm_pool_t *pool, void *obj) {
+    zm_poolcache_t *cache = zm_pool_cache(pool);
+
+    if (zm_unlikely(cache == &zm_pool_caches[ZM_POOL_UNCACHED - 1])) {
+        if (zm_hzdptr_hazardous((zm_ptr_t)obj))
+            zm_hzdptr_retire((zm_ptr_t)obj);
+        else
+            zm_pool_sys_free(obj);
+        return;
+    }
+    zm_pool_thread_init();
+    if (zm_unlikely(cache->retired == NULL))
+        cache->retired = zm_pool_mag_get_empty(pool);
+    if (cache->retired != NULL && cache->retired->count == ZM_POOL_MAGSIZE)
+        zm_pool_reclaim(pool, cache);
+    if (zm_unlikely(cache->retired == NULL || cache->retired->count == ZM_POOL_MAGSIZE)) {
+        /* more hazard pointers than a magazine holds, or no magazine at
+         * all: never reuse obj */
+        zm_hzdptr_retire((zm_ptr_t)obj);
+        return;
+    }
+    cache->retired->objs[cache->retired->count++] = obj;
+}
+
+int zm_pool_stats(zm_ulong_t *nmallocs, zm_ulong_t *nfrees) {
+    *nmallocs = zm_atomic_load(&zm_pool_nmallocs, zm_memord_relaxed);
+    *nfrees = zm_atomic_load(&zm_pool_nfrees, zm_memord_relaxed);
+    return 0;
+}
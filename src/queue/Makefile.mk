@@ -9,5 +9,10 @@ zm_sources += \
 	queue/zm_swpqueue.c \
 	queue/zm_faqueue.c \
 	queue/zm_mpbqueue.c \
-	queue/zm_msqueue.c
+	queue/zm_rbqueue.c \
+	queue/zm_lcrqueue.c \
+	queue/zm_spscqueue.c \
+	queue/zm_msqueue.c \
+	queue/zm_iswpqueue.c \
+	queue/zm_imsqueue.c
 
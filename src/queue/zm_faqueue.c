@@ -3,60 +3,554 @@
  * See COPYRIGHT in top-level directory.
  */
 
+/*
+ * Wait-free MPMC queue as described in:
+ *
+ * Yang, Chaoran, and John Mellor-Crummey. "A wait-free queue as fast as
+ * fetch-and-add." PPoPP'16.
+ *
+ * Enqueuers and dequeuers obtain cells with FAA on tail and head. A
+ * dequeuer that reaches a cell before its value marks it with
+ * ZM_FAQUEUE_ALPHA (top); operations that fail ZM_FAQUEUE_PATIENCE times on
+ * the fast path publish a request in their handle, and dequeuers help
+ * pending requests until they complete.
+ *
+ * Segments are reclaimed by one cleaner at a time. Every operation
+ * publishes the segment it starts from in a zm_hzdptr hazard pointer; a
+ * hazard on a segment protects it and all the segments after it. The
+ * cleaner moves seg_head up to the segment of min(head, tail), then frees
+ * the oldest segments, up to the first one that is hazardous. Segments are
+ * freed by the cleaner itself rather than through zm_hzdptr_retire, since
+ * a hazard must also protect the successors of the segment it names.
+ *
+ * Freed segments are kept on a short list of spares and reused by the
+ * queue. With ZM_FAQUEUE_HUGEPAGES, segments are carved from 2 MB chunks
+ * backed by huge pages, are always kept as spares, and go back to the
+ * system only when the queue is destroyed. With ZM_FAQUEUE_PACKED_CELLS,
+ * cells are not padded to a cache line; zm_faseg_cell spreads consecutive
+ * cell indices over different lines instead.
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* posix_memalign, MAP_ANONYMOUS, MAP_HUGETLB */
+#endif
+#if defined(ZM_FAQUEUE_HUGEPAGES)
+#include <sys/mman.h>
+#endif
+#include <string.h>
+#include <assert.h>
 #include "queue/zm_faqueue.h"
 #include "mem/zm_hzdptr.h"
-#include <assert.h>
+
+#define ZM_FAQUEUE_PATIENCE 10  /* fast-path attempts before a request */
+#define ZM_FAQUEUE_SPIN     100 /* polls of a cell whose enqueuer is late */
+#define ZM_FAQUEUE_GARBAGE  2   /* segments behind a dequeuer before cleanup */
+#define ZM_FAQUEUE_SPARES   8   /* freed segments kept for reuse */
+#define ZM_FAQUEUE_CHUNK    (2UL << 20) /* hugepage arena chunk */
+
+#define BOT     ZM_NULL
+#define TOP     ((zm_ptr_t) ZM_FAQUEUE_ALPHA)
+#define EMPTY   ZM_NULL
+
+#define PENDING(s)      ((s) & 1)
+#define IDX(s)          ((s) >> 1)
+#define STATE(p, i)     (((zm_ulong_t)(i) << 1) | (p))
+
+#define LOAD(addr)                  zm_atomic_load(addr, zm_memord_acquire)
+#define STORE(addr, val)            zm_atomic_store(addr, val, zm_memord_release)
+#define FAA(addr, val)              zm_atomic_fetch_add(addr, val, zm_memord_acq_rel)
+#define CAS(addr, expect, desire)   zm_atomic_compare_exchange_strong(addr,\
+                                                                      expect,\
+                                                                      desire,\
+                                                                      zm_memord_seq_cst,\
+                                                                      zm_memord_acquire)
+
+static zm_atomic_ulong_t zm_faqueue_uids = 0;
+
+/* the address of zm_fa_self identifies the calling thread */
+static zm_thread_local char zm_fa_self;
+static zm_thread_local zm_faqueue_t *zm_fa_last_q;
+static zm_thread_local zm_ulong_t zm_fa_last_uid;
+static zm_thread_local zm_fahandle_t *zm_fa_last_h;
 
 /*
      Helper functions
  */
 
-static inline zm_faseg_t *zm_faseg_alloc(zm_ulong_t seg_id) {
-    int i;
-    zm_faseg_t *seg = malloc (sizeof(zm_faseg_t));
+static inline void zm_faqueue_seg_lock(zm_faqueue_t *q) {
+    while (zm_atomic_flag_test_and_set(&q->seg_lock, zm_memord_acquire))
+        zm_cpu_relax();
+}
+
+static inline void zm_faqueue_seg_unlock(zm_faqueue_t *q) {
+    zm_atomic_flag_clear(&q->seg_lock, zm_memord_release);
+}
+
+/* An operation that needs a new segment has already taken a cell index
+ * that other threads may help with, so it cannot back out */
+static void zm_faseg_oom(void) {
+    printf("IZEM:FAQUEUE:ERROR: cannot allocate a segment!\n");
+    exit(EXIT_FAILURE);
+}
+
+#if defined(ZM_FAQUEUE_HUGEPAGES)
+
+/* the chunks of the arena are linked through their first word */
+#define ZM_FAQUEUE_CHUNK_HDR \
+    ((sizeof(zm_ptr_t) + ZM_CACHELINE_SIZE - 1) / ZM_CACHELINE_SIZE * ZM_CACHELINE_SIZE)
+
+/* Carve a segment from the current chunk, mapping a new one if needed.
+ * Called with seg_lock held. */
+static zm_faseg_t *zm_faseg_sys_alloc(zm_faqueue_t *q) {
+    zm_faseg_t *seg;
+    void *chunk;
+    assert(ZM_FAQUEUE_CHUNK_HDR + sizeof(zm_faseg_t) <= ZM_FAQUEUE_CHUNK);
+    if (q->arena_left < sizeof(zm_faseg_t)) {
+        chunk = mmap(NULL, ZM_FAQUEUE_CHUNK, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (chunk == MAP_FAILED) {
+            /* no reserved huge pages: ask for transparent ones */
+            chunk = mmap(NULL, ZM_FAQUEUE_CHUNK, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (chunk == MAP_FAILED)
+                zm_faseg_oom();
+#if defined(MADV_HUGEPAGE)
+            madvise(chunk, ZM_FAQUEUE_CHUNK, MADV_HUGEPAGE);
+#endif
+        }
+        *(zm_ptr_t*)chunk = q->arena;
+        q->arena = (zm_ptr_t)chunk;
+        q->arena_cur = (char*)chunk + ZM_FAQUEUE_CHUNK_HDR;
+        q->arena_left = ZM_FAQUEUE_CHUNK - ZM_FAQUEUE_CHUNK_HDR;
+        zm_atomic_fetch_add(&q->footprint, ZM_FAQUEUE_CHUNK, zm_memord_relaxed);
+    }
+    seg = (zm_faseg_t*)q->arena_cur;
+    q->arena_cur += sizeof(zm_faseg_t);
+    q->arena_left -= sizeof(zm_faseg_t);
+    return seg;
+}
+
+static void zm_faqueue_arena_release(zm_faqueue_t *q) {
+    zm_ptr_t chunk = q->arena, next;
+    while (chunk != ZM_NULL) {
+        next = *(zm_ptr_t*)chunk;
+        munmap((void*)chunk, ZM_FAQUEUE_CHUNK);
+        chunk = next;
+    }
+    q->arena = ZM_NULL;
+    q->arena_cur = NULL;
+    q->arena_left = 0;
+}
+
+#else
+
+static zm_faseg_t *zm_faseg_sys_alloc(zm_faqueue_t *q) {
+    zm_faseg_t *seg;
+    if (posix_memalign((void **) &seg, ZM_CACHELINE_SIZE, sizeof(zm_faseg_t)) != 0)
+        zm_faseg_oom();
+    zm_atomic_fetch_add(&q->footprint, sizeof(zm_faseg_t), zm_memord_relaxed);
+    return seg;
+}
+
+static inline void zm_faseg_sys_free(zm_faqueue_t *q, zm_faseg_t *seg) {
+    zm_atomic_fetch_add(&q->footprint, -(zm_ulong_t)sizeof(zm_faseg_t), zm_memord_relaxed);
+    free(seg);
+}
+
+#endif
+
+static zm_faseg_t *zm_faseg_alloc(zm_faqueue_t *q, zm_ulong_t seg_id) {
+    zm_faseg_t *seg;
+    zm_faqueue_seg_lock(q);
+    seg = (zm_faseg_t*)q->seg_spare;
+    if (seg != NULL) {
+        q->seg_spare = zm_atomic_load(&seg->next, zm_memord_relaxed);
+        q->nspare--;
+    }
+#if defined(ZM_FAQUEUE_HUGEPAGES)
+    else
+        seg = zm_faseg_sys_alloc(q);
+    zm_faqueue_seg_unlock(q);
+#else
+    zm_faqueue_seg_unlock(q);
+    if (seg == NULL)
+        seg = zm_faseg_sys_alloc(q);
+#endif
+    memset(seg->cells, 0, sizeof(seg->cells)); /* BOT everywhere */
     seg->id = seg_id;
     zm_atomic_store(&seg->next, ZM_NULL, zm_memord_release);
-    for(i = 0; i < ZM_MAX_FASEG_SIZE; i++)
-        seg->cells[i].data = ZM_FAQUEUE_ALPHA;
     return seg;
 }
 
-static inline void zm_faseg_free(zm_faseg_t *seg) {
-    zm_hzdptr_retire((zm_ptr_t)seg);
+/* seg is unreachable: keep it for reuse */
+static void zm_faseg_free(zm_faqueue_t *q, zm_faseg_t *seg) {
+    zm_faqueue_seg_lock(q);
+#if !defined(ZM_FAQUEUE_HUGEPAGES)
+    if (q->nspare == ZM_FAQUEUE_SPARES) {
+        zm_faqueue_seg_unlock(q);
+        zm_faseg_sys_free(q, seg);
+        return;
+    }
+#endif
+    zm_atomic_store(&seg->next, q->seg_spare, zm_memord_relaxed);
+    q->seg_spare = (zm_ptr_t)seg;
+    q->nspare++;
+    zm_faqueue_seg_unlock(q);
 }
 
-static inline zm_faseg_t *zm_faseg_advance(zm_faseg_t *seg, zm_ulong_t seg_id){
+static inline zm_faseg_t *zm_faseg_advance(zm_faqueue_t *q, zm_faseg_t *seg,
+                                           zm_ulong_t seg_id) {
     assert(seg->id == seg_id-1);
-    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
-    zm_faseg_t *next =  (zm_faseg_t*) zm_atomic_load(&seg->next,
-                                                           zm_memord_acquire);
-    hzdptrs[0] = (zm_ptr_t)next;
-    if((zm_ptr_t)next == ZM_NULL) {
-        zm_faseg_t *tmp_seg = zm_faseg_alloc (seg_id);
-        if (!zm_atomic_compare_exchange_strong(&seg->next,
-                                               (zm_ptr_t*)&next,
-                                               (zm_ptr_t)tmp_seg,
-                                               zm_memord_acq_rel,
-                                               zm_memord_acquire))
-            zm_faseg_free(tmp_seg);
-
-        next = (zm_faseg_t*) zm_atomic_load(&seg->next,
-                                                zm_memord_acquire);
-    }
-    assert(next->id == seg_id);
-    return next;
-}
-
-/* Search, and allocate a segment if necessary, the cell that cell_id belongs to*/
-static inline zm_facell_t *zm_facell_find(zm_faseg_t *seg, zm_ulong_t cell_id) {
-    zm_faseg_t *cur_seg = seg;
+    zm_ptr_t next = LOAD(&seg->next);
+    if (next == ZM_NULL) {
+        zm_faseg_t *tmp_seg = zm_faseg_alloc(q, seg_id);
+        if (!CAS(&seg->next, &next, (zm_ptr_t)tmp_seg))
+            zm_faseg_free(q, tmp_seg); /* never published */
+        next = LOAD(&seg->next);
+    }
+    assert(((zm_faseg_t*)next)->id == seg_id);
+    return (zm_faseg_t*)next;
+}
+
+/* Cell j of a segment is stored at (j % L) * (S / L) + j / L, where L cells
+ * share a cache line and S is the segment size, so that the cells used by
+ * consecutive operations are on different lines */
+static inline zm_facell_t *zm_faseg_cell(zm_faseg_t *seg, zm_ulong_t cell_id) {
+    zm_ulong_t j = cell_id % ZM_MAX_FASEG_SIZE;
+    if (ZM_FACELLS_PER_LINE > 1)
+        j = (j % ZM_FACELLS_PER_LINE) * (ZM_MAX_FASEG_SIZE / ZM_FACELLS_PER_LINE)
+            + j / ZM_FACELLS_PER_LINE;
+    return &seg->cells[j];
+}
+
+/* Find, allocating segments if necessary, the cell that cell_id belongs
+ * to, starting from and updating *seg */
+static inline zm_facell_t *zm_facell_find(zm_faqueue_t *q, zm_faseg_t **seg,
+                                          zm_ulong_t cell_id) {
+    zm_faseg_t *cur_seg = *seg;
     zm_ulong_t trg_seg = cell_id/ZM_MAX_FASEG_SIZE;
 
-    for (zm_ulong_t i = cur_seg->id; i < trg_seg; i++)
-        cur_seg = zm_faseg_advance (cur_seg, i + 1);
-    assert(cur_seg->id == trg_seg);
+    assert(cur_seg->id <= trg_seg);
+    while (cur_seg->id < trg_seg)
+        cur_seg = zm_faseg_advance(q, cur_seg, cur_seg->id + 1);
+    *seg = cur_seg;
+
+    return zm_faseg_cell(cur_seg, cell_id);
+}
+
+static inline zm_facell_t *zm_facell_find_head(zm_faqueue_t *q, zm_fahandle_t *h,
+                                               zm_ulong_t cell_id) {
+    zm_faseg_t *seg = (zm_faseg_t*) LOAD(&h->head);
+    zm_facell_t *cell = zm_facell_find(q, &seg, cell_id);
+    STORE(&h->head, (zm_ptr_t)seg);
+    return cell;
+}
+
+static inline void zm_faqueue_advance_end(zm_atomic_ulong_t *end, zm_ulong_t cell_id) {
+    zm_ulong_t e = LOAD(end);
+    while (e < cell_id && !CAS(end, &e, cell_id))
+        e = LOAD(end);
+}
+
+/* Publish seg in a hazard pointer; fall back to seg_head if seg may have
+ * been retired */
+static inline zm_faseg_t *zm_faqueue_protect(zm_faqueue_t *q, zm_hzdptr_t *hzdptrs,
+                                             zm_faseg_t *seg, zm_ulong_t seg_id) {
+    zm_ptr_t head;
+    if (seg != NULL) {
+        hzdptrs[0] = (zm_ptr_t)seg;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        if (seg_id >= zm_atomic_load(&q->seg_head_id, zm_memord_seq_cst))
+            return seg;
+    }
+    do {
+        head = zm_atomic_load(&q->seg_head, zm_memord_seq_cst);
+        hzdptrs[0] = head;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+    } while (head != zm_atomic_load(&q->seg_head, zm_memord_seq_cst));
+    return (zm_faseg_t*)head;
+}
+
+static void zm_faqueue_cleanup(zm_faqueue_t *q) {
+    zm_faseg_t *first, *seg, *next;
+    zm_ulong_t head, tail, lim;
+    if (zm_atomic_flag_test_and_set(&q->cleaning, zm_memord_acquire))
+        return;
+    head = LOAD(&q->head);
+    tail = LOAD(&q->tail);
+    /* no operation will start below the cell min(head, tail) */
+    lim = ((head < tail) ? head : tail) / ZM_MAX_FASEG_SIZE;
+    first = (zm_faseg_t*) LOAD(&q->seg_head);
+    if (lim > first->id) {
+        seg = first;
+        while (seg->id < lim)
+            seg = zm_faseg_advance(q, seg, seg->id + 1);
+        zm_atomic_store(&q->seg_head_id, lim, zm_memord_seq_cst);
+        zm_atomic_store(&q->seg_head, (zm_ptr_t)seg, zm_memord_seq_cst);
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        first = seg;
+    }
+    seg = (zm_faseg_t*)q->seg_free;
+    while (seg != first && !zm_hzdptr_hazardous((zm_ptr_t)seg)) {
+        next = (zm_faseg_t*) LOAD(&seg->next);
+        zm_faseg_free(q, seg);
+        seg = next;
+    }
+    q->seg_free = (zm_ptr_t)seg;
+    zm_atomic_flag_clear(&q->cleaning, zm_memord_release);
+}
+
+static zm_fahandle_t *zm_fahandle_get(zm_faqueue_t *q) {
+    zm_fahandle_t *h;
+    zm_ptr_t old;
+    if (zm_likely(zm_fa_last_q == q && zm_fa_last_uid == q->uid))
+        return zm_fa_last_h;
+    /* first use of the queue by this thread, or switching queues */
+    h = (zm_fahandle_t*) LOAD(&q->handles);
+    while (h != NULL && h->owner != &zm_fa_self)
+        h = (zm_fahandle_t*) LOAD(&h->next);
+    if (h == NULL) {
+        if (posix_memalign((void **) &h, ZM_CACHELINE_SIZE, sizeof(zm_fahandle_t)) != 0) {
+            /* the callers have no way to back out either */
+            printf("IZEM:FAQUEUE:ERROR: cannot allocate a thread handle!\n");
+            exit(EXIT_FAILURE);
+        }
+        h->owner = &zm_fa_self;
+        h->tail = NULL;
+        h->tail_id = 0;
+        zm_atomic_store(&h->head, ZM_NULL, zm_memord_relaxed);
+        h->head_id = 0;
+        zm_atomic_store(&h->enq_req.val, ZM_NULL, zm_memord_relaxed);
+        zm_atomic_store(&h->enq_req.state, STATE(0, 0), zm_memord_relaxed);
+        h->enq_peer = h;
+        h->enq_help_id = 0;
+        zm_atomic_store(&h->deq_req.id, 0, zm_memord_relaxed);
+        zm_atomic_store(&h->deq_req.state, STATE(0, 0), zm_memord_relaxed);
+        h->deq_peer = h;
+        do {
+            old = LOAD(&q->handles);
+            zm_atomic_store(&h->next, old, zm_memord_release);
+        } while (!CAS(&q->handles, &old, (zm_ptr_t)h));
+    }
+    zm_fa_last_q = q;
+    zm_fa_last_uid = q->uid;
+    zm_fa_last_h = h;
+    return h;
+}
+
+/* the handles form a ring */
+static inline zm_fahandle_t *zm_fahandle_next(zm_faqueue_t *q, zm_fahandle_t *h) {
+    zm_ptr_t next = LOAD(&h->next);
+    return (zm_fahandle_t*) ((next != ZM_NULL) ? next : LOAD(&q->handles));
+}
+
+static inline int zm_faqueue_try_to_claim_req(zm_atomic_ulong_t *state, zm_ulong_t id,
+                                              zm_ulong_t cell_id) {
+    zm_ulong_t expected = STATE(1, id);
+    return CAS(state, &expected, STATE(0, cell_id));
+}
+
+static inline void zm_faqueue_enq_commit(zm_faqueue_t *q, zm_facell_t *c, zm_ptr_t v,
+                                         zm_ulong_t cell_id) {
+    zm_faqueue_advance_end(&q->tail, cell_id + 1);
+    STORE(&c->data, v);
+}
+
+static inline int zm_faqueue_enq_fast(zm_faqueue_t *q, zm_fahandle_t *h, zm_ptr_t v,
+                                      zm_ulong_t *id) {
+    zm_ulong_t i = FAA(&q->tail, 1);
+    zm_facell_t *c = zm_facell_find(q, &h->tail, i);
+    zm_ptr_t expected = BOT;
+    if (CAS(&c->data, &expected, v))
+        return 1;
+    *id = i;
+    return 0;
+}
+
+static void zm_faqueue_enq_slow(zm_faqueue_t *q, zm_fahandle_t *h, zm_ptr_t v,
+                                zm_ulong_t cell_id) {
+    struct zm_faenq_req *r = &h->enq_req;
+    zm_faseg_t *tmp_tail = h->tail;
+    zm_facell_t *c;
+    zm_ptr_t expected;
+    zm_ulong_t i, id;
+
+    /* publish the request */
+    STORE(&r->val, v);
+    zm_atomic_store(&r->state, STATE(1, cell_id), zm_memord_seq_cst);
+
+    /* reserve a cell for it, unless a helper does first */
+    do {
+        i = FAA(&q->tail, 1);
+        c = zm_facell_find(q, &tmp_tail, i);
+        expected = BOT;
+        if (CAS(&c->enq, &expected, (zm_ptr_t)r) && LOAD(&c->data) == BOT) {
+            zm_faqueue_try_to_claim_req(&r->state, cell_id, i);
+            break;
+        }
+    } while (PENDING(LOAD(&r->state)));
+
+    /* the request is claimed for a cell: commit the value there */
+    id = IDX(LOAD(&r->state));
+    c = zm_facell_find(q, &h->tail, id);
+    zm_faqueue_enq_commit(q, c, v, id);
+}
+
+/* Called by the dequeuer of cell i: returns the value of the cell, TOP if
+ * the cell will not get one, or EMPTY if the queue was empty */
+static zm_ptr_t zm_faqueue_help_enq(zm_faqueue_t *q, zm_fahandle_t *h,
+                                    zm_facell_t *c, zm_ulong_t i) {
+    struct zm_faenq_req *r;
+    zm_fahandle_t *p;
+    zm_ptr_t v, e, expected;
+    zm_ulong_t s;
+    int spins = ZM_FAQUEUE_SPIN;
+
+    /* give an enqueuer that already has this cell a chance to fill it */
+    while ((v = LOAD(&c->data)) == BOT && spins-- > 0 && LOAD(&q->tail) > i)
+        zm_cpu_relax();
+    expected = BOT;
+    if (!CAS(&c->data, &expected, TOP)) {
+        v = LOAD(&c->data);
+        if (v != TOP)
+            return v;
+    }
+
+    /* the cell is TOP: help a slow-path enqueue into it */
+    if (LOAD(&c->enq) == BOT) {
+        while (1) { /* two iterations at most */
+            p = h->enq_peer;
+            r = &p->enq_req;
+            s = LOAD(&r->state);
+            /* stay on this peer until the request I failed to help is done */
+            if (h->enq_help_id == 0 || h->enq_help_id == IDX(s) + 1)
+                break;
+            h->enq_help_id = 0;
+            h->enq_peer = zm_fahandle_next(q, p);
+        }
+        expected = BOT;
+        if (PENDING(s) && IDX(s) <= i && !CAS(&c->enq, &expected, (zm_ptr_t)r))
+            h->enq_help_id = IDX(s) + 1;
+        else
+            h->enq_peer = zm_fahandle_next(q, p);
+        /* no request for this cell: keep other helpers from using it */
+        if (LOAD(&c->enq) == BOT) {
+            expected = BOT;
+            CAS(&c->enq, &expected, TOP);
+        }
+    }
+
+    e = LOAD(&c->enq);
+    if (e == TOP)
+        return (LOAD(&q->tail) <= i) ? EMPTY : TOP;
+
+    r = (struct zm_faenq_req*) e;
+    s = LOAD(&r->state);
+    v = LOAD(&r->val);
+    if (IDX(s) > i) {
+        /* the request cannot use this cell */
+        if (LOAD(&c->data) == TOP && LOAD(&q->tail) <= i)
+            return EMPTY;
+    } else if (zm_faqueue_try_to_claim_req(&r->state, IDX(s), i) ||
+               (s == STATE(0, i) && LOAD(&c->data) == TOP)) {
+        zm_faqueue_enq_commit(q, c, v, i);
+    }
+    return LOAD(&c->data);
+}
+
+static void zm_faqueue_help_deq(zm_faqueue_t *q, zm_fahandle_t *h,
+                                zm_fahandle_t *helpee, zm_hzdptr_t *hzdptrs) {
+    struct zm_fadeq_req *r = &helpee->deq_req;
+    zm_ulong_t s = LOAD(&r->state), id = LOAD(&r->id);
+    zm_ulong_t prior, i, cand, expected;
+    zm_faseg_t *ha, *hc;
+    zm_facell_t *c;
+    zm_ptr_t v, deq_expected;
+
+    if (!PENDING(s) || IDX(s) < id)
+        return;
+    ha = (zm_faseg_t*) LOAD(&helpee->head);
+    if (helpee != h) {
+        /* the helpee protects ha while the request is pending */
+        hzdptrs[1] = (zm_ptr_t)ha;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        s = zm_atomic_load(&r->state, zm_memord_seq_cst);
+        if (!PENDING(s) || LOAD(&r->id) != id)
+            goto out;
+    }
+    s = LOAD(&r->state);
+    prior = id;
+    i = id;
+    cand = 0;
+    while (1) {
+        /* find a candidate cell, unless another helper announced one */
+        for (hc = ha; !cand && IDX(s) == prior;) {
+            c = zm_facell_find(q, &hc, ++i);
+            v = zm_faqueue_help_enq(q, h, c, i);
+            if (v == EMPTY || (v != TOP && LOAD(&c->deq) == BOT))
+                cand = i;
+            else
+                s = LOAD(&r->state);
+        }
+        if (cand) {
+            expected = STATE(1, prior);
+            CAS(&r->state, &expected, STATE(1, cand));
+            s = LOAD(&r->state);
+        }
+        if (!PENDING(s) || LOAD(&r->id) != id)
+            goto out;
+        /* the announced candidate completes the request if it is empty or
+         * if its value is claimed for the request */
+        c = zm_facell_find(q, &ha, IDX(s));
+        deq_expected = BOT;
+        if (LOAD(&c->data) == TOP || CAS(&c->deq, &deq_expected, (zm_ptr_t)r) ||
+            LOAD(&c->deq) == (zm_ptr_t)r) {
+            expected = s;
+            CAS(&r->state, &expected, STATE(0, IDX(s)));
+            goto out;
+        }
+        prior = IDX(s);
+        if (IDX(s) >= i) {
+            cand = 0;
+            i = IDX(s);
+        }
+    }
+  out:
+    hzdptrs[1] = ZM_NULL;
+}
+
+static inline zm_ptr_t zm_faqueue_deq_fast(zm_faqueue_t *q, zm_fahandle_t *h,
+                                           zm_ulong_t *id) {
+    zm_ulong_t i = FAA(&q->head, 1);
+    zm_facell_t *c = zm_facell_find_head(q, h, i);
+    zm_ptr_t v = zm_faqueue_help_enq(q, h, c, i);
+    zm_ptr_t expected = BOT;
+    if (v == EMPTY)
+        return EMPTY;
+    /* the cell has a value: claim it */
+    if (v != TOP && CAS(&c->deq, &expected, TOP))
+        return v;
+    *id = i;
+    return TOP;
+}
+
+static zm_ptr_t zm_faqueue_deq_slow(zm_faqueue_t *q, zm_fahandle_t *h, zm_ulong_t cell_id,
+                                    zm_hzdptr_t *hzdptrs) {
+    struct zm_fadeq_req *r = &h->deq_req;
+    zm_facell_t *c;
+    zm_ptr_t v;
+    zm_ulong_t i;
+
+    /* publish the request and complete it */
+    STORE(&r->id, cell_id);
+    zm_atomic_store(&r->state, STATE(1, cell_id), zm_memord_seq_cst);
+    zm_faqueue_help_deq(q, h, h, hzdptrs);
 
-    return &cur_seg->cells[cell_id % ZM_MAX_FASEG_SIZE];
+    i = IDX(LOAD(&r->state));
+    c = zm_facell_find_head(q, h, i);
+    v = LOAD(&c->data);
+    zm_faqueue_advance_end(&q->head, i + 1);
+    return (v == TOP) ? EMPTY : v;
 }
 
 /*
@@ -64,43 +558,203 @@ static inline zm_facell_t *zm_facell_find(zm_faseg_t *seg, zm_ulong_t cell_id) {
  */
 
 int zm_faqueue_init(zm_faqueue_t *q) {
-    q->head = 0;
-    zm_atomic_store(&q->tail, 0, zm_memord_release);
-    q->seg_head = (zm_ptr_t)(void *)zm_faseg_alloc(0);
-    zm_atomic_store(&q->seg_tail, q->seg_head, zm_memord_release);
+    zm_faseg_t *seg;
+    zm_atomic_flag_clear(&q->seg_lock, zm_memord_relaxed);
+    q->seg_spare = ZM_NULL;
+    q->nspare = 0;
+    q->arena = ZM_NULL;
+    q->arena_cur = NULL;
+    q->arena_left = 0;
+    zm_atomic_store(&q->footprint, 0, zm_memord_relaxed);
+    seg = zm_faseg_alloc(q, 0);
+    zm_atomic_store(&q->head, 0, zm_memord_relaxed);
+    zm_atomic_store(&q->tail, 0, zm_memord_relaxed);
+    zm_atomic_store(&q->seg_head, (zm_ptr_t)seg, zm_memord_relaxed);
+    zm_atomic_store(&q->seg_head_id, 0, zm_memord_relaxed);
+    q->seg_free = (zm_ptr_t)seg;
+    zm_atomic_flag_clear(&q->cleaning, zm_memord_relaxed);
+    zm_atomic_store(&q->handles, ZM_NULL, zm_memord_relaxed);
+    q->uid = zm_atomic_fetch_add(&zm_faqueue_uids, 1, zm_memord_relaxed) + 1;
+    zm_ec_init(&q->ec);
+    return 0;
+}
+
+/* No thread may be using the queue */
+int zm_faqueue_destroy(zm_faqueue_t *q) {
+    zm_fahandle_t *h = (zm_fahandle_t*) LOAD(&q->handles), *next_h;
+#if defined(ZM_FAQUEUE_HUGEPAGES)
+    zm_faqueue_arena_release(q);
+#else
+    zm_faseg_t *seg = (zm_faseg_t*)q->seg_free, *next_seg;
+    while (seg != NULL) {
+        next_seg = (zm_faseg_t*) LOAD(&seg->next);
+        zm_faseg_sys_free(q, seg);
+        seg = next_seg;
+    }
+    seg = (zm_faseg_t*)q->seg_spare;
+    while (seg != NULL) {
+        next_seg = (zm_faseg_t*) LOAD(&seg->next);
+        zm_faseg_sys_free(q, seg);
+        seg = next_seg;
+    }
+#endif
+    q->seg_spare = ZM_NULL;
+    q->nspare = 0;
+    while (h != NULL) {
+        next_h = (zm_fahandle_t*) LOAD(&h->next);
+        free(h);
+        h = next_h;
+    }
+    q->uid = 0;
+    return 0;
+}
+
+int zm_faqueue_footprint(zm_faqueue_t *q, zm_ulong_t *bytes) {
+    *bytes = zm_atomic_load(&q->footprint, zm_memord_relaxed);
     return 0;
 }
 
 int zm_faqueue_enqueue(zm_faqueue_t* q, void *data) {
-    zm_ulong_t cell_id = zm_atomic_fetch_add(&q->tail, 1, zm_memord_acq_rel);
-    zm_facell_t *cell = zm_facell_find ((zm_faseg_t*)q->seg_head, cell_id);
-    cell->data = data;
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    zm_fahandle_t *h = zm_fahandle_get(q);
+    zm_ulong_t cell_id = 0;
+    int p;
+
+    h->tail = zm_faqueue_protect(q, hzdptrs, h->tail, h->tail_id);
+    for (p = 0; p < ZM_FAQUEUE_PATIENCE; p++)
+        if (zm_faqueue_enq_fast(q, h, (zm_ptr_t)data, &cell_id))
+            break;
+    if (p == ZM_FAQUEUE_PATIENCE)
+        zm_faqueue_enq_slow(q, h, (zm_ptr_t)data, cell_id);
+    h->tail_id = h->tail->id;
+    hzdptrs[0] = ZM_NULL;
+
+    zm_ec_notify(&q->ec);
     return 0;
 }
 
 int zm_faqueue_dequeue(zm_faqueue_t* q, void **data) {
-    *data = NULL;
-    zm_ulong_t cell_disp = q->head % ZM_MAX_FASEG_SIZE;
-    zm_ulong_t seg_id = q->head/ ZM_MAX_FASEG_SIZE;
-    zm_faseg_t *seg_head = (zm_faseg_t*)q->seg_head;
-    zm_faseg_t *next =  (zm_faseg_t*) zm_atomic_load(&seg_head->next,
-                                                     zm_memord_acquire);
-    /* q empty or next segment not yet allocated by enqueuers */
-    if ((seg_id > seg_head->id) && (next == NULL))
-        return 0;
-    else if (seg_id > seg_head->id) {   /* next segment allocated */
-        assert(seg_id == seg_head->id + 1);
-        q->seg_head = (zm_ptr_t)next;             /* advance seg_head */
-        zm_faseg_free(seg_head);                 /* free no longer used segment */
-        seg_head = next;
-        assert(seg_id == seg_head->id);
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    zm_fahandle_t *h = zm_fahandle_get(q);
+    zm_ulong_t cell_id = 0;
+    zm_faseg_t *head;
+    zm_ptr_t v = TOP;
+    int p;
+
+    head = zm_faqueue_protect(q, hzdptrs, (zm_faseg_t*) LOAD(&h->head), h->head_id);
+    STORE(&h->head, (zm_ptr_t)head);
+    for (p = 0; p < ZM_FAQUEUE_PATIENCE && v == TOP; p++)
+        v = zm_faqueue_deq_fast(q, h, &cell_id);
+    if (v == TOP)
+        v = zm_faqueue_deq_slow(q, h, cell_id, hzdptrs);
+    if (v != EMPTY) {
+        /* got a value: help a peer */
+        zm_faqueue_help_deq(q, h, h->deq_peer, hzdptrs);
+        h->deq_peer = zm_fahandle_next(q, h->deq_peer);
     }
+    h->head_id = ((zm_faseg_t*) LOAD(&h->head))->id;
+    hzdptrs[0] = ZM_NULL;
 
-    if (seg_head->cells[cell_disp].data == ZM_FAQUEUE_ALPHA) /* general case of empty q */
+    if ((long)(h->head_id - zm_atomic_load(&q->seg_head_id, zm_memord_relaxed)) >= ZM_FAQUEUE_GARBAGE)
+        zm_faqueue_cleanup(q);
+
+    *data = (void*)v;
+    return (v != EMPTY);
+}
+
+/* Reserve n cells with a single FAA on tail. If a dequeuer gave up one of
+ * them, the later cells are given up as well and the remaining elements
+ * are enqueued one by one, so that they stay in order. */
+int zm_faqueue_enqueue_bulk(zm_faqueue_t* q, void *data[], int n) {
+    zm_hzdptr_t *hzdptrs;
+    zm_fahandle_t *h;
+    zm_facell_t *c;
+    zm_ptr_t expected;
+    zm_ulong_t i, cell_id = 0;
+    int k, j, p;
+
+    if (n <= 0)
         return 0;
-    else {
-        *data = seg_head->cells[cell_disp].data;
-        q->head++;
+    hzdptrs = zm_hzdptr_get();
+    h = zm_fahandle_get(q);
+    h->tail = zm_faqueue_protect(q, hzdptrs, h->tail, h->tail_id);
+    i = FAA(&q->tail, n);
+    for (k = 0; k < n; k++) {
+        c = zm_facell_find(q, &h->tail, i + k);
+        expected = BOT;
+        if (!CAS(&c->data, &expected, (zm_ptr_t)data[k]))
+            break;
+    }
+    if (k < n) {
+        for (j = k + 1; j < n; j++) {
+            c = zm_facell_find(q, &h->tail, i + j);
+            expected = BOT;
+            CAS(&c->data, &expected, TOP);
+        }
+        for (; k < n; k++) {
+            for (p = 0; p < ZM_FAQUEUE_PATIENCE; p++)
+                if (zm_faqueue_enq_fast(q, h, (zm_ptr_t)data[k], &cell_id))
+                    break;
+            if (p == ZM_FAQUEUE_PATIENCE)
+                zm_faqueue_enq_slow(q, h, (zm_ptr_t)data[k], cell_id);
+        }
+    }
+    h->tail_id = h->tail->id;
+    hzdptrs[0] = ZM_NULL;
+
+    zm_ec_notify_n(&q->ec, n);
+    return 0;
+}
+
+/* Reserve up to max cells, no more than the queue seems to hold, with a
+ * single FAA on head. Every reserved cell is visited, whether it yields a
+ * value or not. Falls back to a single dequeue when the queue looks empty
+ * or when none of the cells yielded a value. */
+int zm_faqueue_dequeue_bulk(zm_faqueue_t* q, void *data[], int max, int *count) {
+    zm_hzdptr_t *hzdptrs;
+    zm_fahandle_t *h;
+    zm_faseg_t *head;
+    zm_facell_t *c;
+    zm_ptr_t v, expected;
+    zm_ulong_t i, hd, tl, k, j;
+    int n = 0;
+
+    hd = LOAD(&q->head);
+    tl = LOAD(&q->tail);
+    k = (tl > hd) ? tl - hd : 0;
+    if (k > (zm_ulong_t)max)
+        k = max;
+    if (k > 1) {
+        hzdptrs = zm_hzdptr_get();
+        h = zm_fahandle_get(q);
+        head = zm_faqueue_protect(q, hzdptrs, (zm_faseg_t*) LOAD(&h->head), h->head_id);
+        STORE(&h->head, (zm_ptr_t)head);
+        i = FAA(&q->head, k);
+        for (j = 0; j < k; j++) {
+            c = zm_facell_find_head(q, h, i + j);
+            v = zm_faqueue_help_enq(q, h, c, i + j);
+            expected = BOT;
+            if (v != EMPTY && v != TOP && CAS(&c->deq, &expected, TOP))
+                data[n++] = (void*)v;
+        }
+        if (n > 0) {
+            zm_faqueue_help_deq(q, h, h->deq_peer, hzdptrs);
+            h->deq_peer = zm_fahandle_next(q, h->deq_peer);
+        }
+        h->head_id = ((zm_faseg_t*) LOAD(&h->head))->id;
+        hzdptrs[0] = ZM_NULL;
+
+        if ((long)(h->head_id - zm_atomic_load(&q->seg_head_id, zm_memord_relaxed)) >= ZM_FAQUEUE_GARBAGE)
+            zm_faqueue_cleanup(q);
     }
+    if (n == 0 && max > 0 && zm_faqueue_dequeue(q, &data[0]))
+        n = 1;
+    *count = n;
+    return (n > 0);
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_faqueue_dequeue_wait(zm_faqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, (zm_faqueue_dequeue(q, data), *data != NULL));
     return 1;
 }
@@ -4,20 +4,29 @@
  */
 
 #include "queue/zm_glqueue.h"
+#include "mem/zm_pool.h"
+
+static zm_pool_t zm_glqnode_pool = ZM_POOL_INITIALIZER(sizeof(zm_glqnode_t),
+                                                       __alignof__(zm_glqnode_t));
 
 int zm_glqueue_init(zm_glqueue_t *q) {
-    zm_glqnode_t* node = (zm_glqnode_t*) malloc(sizeof(zm_glqnode_t));
+    zm_glqnode_t* node = (zm_glqnode_t*) zm_pool_alloc(&zm_glqnode_pool);
+    if (node == NULL)
+        return -1;
     node->data = NULL;
     node->next = ZM_NULL;
     pthread_mutex_init(&q->lock, NULL);
     q->head = (zm_ptr_t)node;
     q->tail = (zm_ptr_t)node;
+    zm_ec_init(&q->ec);
     return 0;
 }
 
 int zm_glqueue_enqueue(zm_glqueue_t* q, void *data) {
     /* allocate a new node */
-    zm_glqnode_t* node = (zm_glqnode_t*) malloc(sizeof(zm_glqnode_t));
+    zm_glqnode_t* node = (zm_glqnode_t*) zm_pool_alloc(&zm_glqnode_pool);
+    if (node == NULL)
+        return -1;
     /* set the data and next pointers */
     node->data = data;
     node->next = ZM_NULL;
@@ -29,6 +38,8 @@ int zm_glqueue_enqueue(zm_glqueue_t* q, void *data) {
     q->tail = (zm_ptr_t)node;
     /* release the global lock */
     pthread_mutex_unlock(&q->lock);
+    /* wake up a blocked dequeuer, if any */
+    zm_ec_notify(&q->ec);
     return 0;
 }
 
@@ -43,9 +54,71 @@ int zm_glqueue_dequeue(zm_glqueue_t* q, void **data) {
         q->head = head->next;
          /* return the data pointer of the current head */
         *data = ((zm_glqnode_t*)q->head)->data;
-        free(head);
+        zm_pool_free(&zm_glqnode_pool, head);
     }
     /* release the global lock */
     pthread_mutex_unlock(&q->lock);
     return 1;
 }
+
+/* Link the new nodes outside the lock and append them at once */
+int zm_glqueue_enqueue_bulk(zm_glqueue_t* q, void *data[], int n) {
+    zm_glqnode_t *first, *last, *node;
+    int i;
+    if (n <= 0)
+        return 0;
+    first = last = (zm_glqnode_t*) zm_pool_alloc(&zm_glqnode_pool);
+    if (first == NULL)
+        return -1;
+    first->data = data[0];
+    for (i = 1; i < n; i++) {
+        node = (zm_glqnode_t*) zm_pool_alloc(&zm_glqnode_pool);
+        if (node == NULL) {
+            /* nothing was enqueued: give back the partial chain */
+            while (first != last) {
+                node = (zm_glqnode_t*)first->next;
+                zm_pool_free(&zm_glqnode_pool, first);
+                first = node;
+            }
+            zm_pool_free(&zm_glqnode_pool, last);
+            return -1;
+        }
+        node->data = data[i];
+        last->next = (zm_ptr_t)node;
+        last = node;
+    }
+    last->next = ZM_NULL;
+    pthread_mutex_lock(&q->lock);
+    ((zm_glqnode_t*)q->tail)->next = (zm_ptr_t)first;
+    q->tail = (zm_ptr_t)last;
+    pthread_mutex_unlock(&q->lock);
+    zm_ec_notify_n(&q->ec, n);
+    return 0;
+}
+
+int zm_glqueue_dequeue_bulk(zm_glqueue_t* q, void *data[], int max, int *count) {
+    zm_glqnode_t *head, *first, *next;
+    int n = 0;
+    pthread_mutex_lock(&q->lock);
+    first = head = (zm_glqnode_t*)q->head;
+    while (n < max && head->next != ZM_NULL) {
+        head = (zm_glqnode_t*)head->next;
+        data[n++] = head->data;
+    }
+    q->head = (zm_ptr_t)head;
+    pthread_mutex_unlock(&q->lock);
+    /* free the old dummy and the nodes before the new one */
+    while (first != head) {
+        next = (zm_glqnode_t*)first->next;
+        zm_pool_free(&zm_glqnode_pool, first);
+        first = next;
+    }
+    *count = n;
+    return (n > 0);
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_glqueue_dequeue_wait(zm_glqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, (zm_glqueue_dequeue(q, data), *data != NULL));
+    return 1;
+}
@@ -0,0 +1,176 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * Intrusive version of the Michael-Scott queue (zm_msqueue.c). The links of
+ * the elements are the nodes of the queue and the queue's own stub link is
+ * the first dummy. A link that stops being the dummy is retired: it is
+ * kept in a per-thread list until no hazard pointer refers to it, then
+ * handed back to the user through the dispose callback.
+ */
+
+#include "queue/zm_imsqueue.h"
+#include "mem/zm_hzdptr.h"
+
+#define ZM_IMSQUEUE_RETIRED 64  /* retired links per thread */
+
+#define LOAD(addr)  zm_atomic_load(addr, zm_memord_acquire)
+
+typedef struct zm_imsq_retired {
+    zm_qlink_t *link;
+    zm_qlink_dispose_t dispose;
+} zm_imsq_retired_t;
+
+static zm_thread_local zm_imsq_retired_t zm_imsq_retired[ZM_IMSQUEUE_RETIRED];
+static zm_thread_local int zm_imsq_nretired = 0;
+
+/*
+     Helper functions
+ */
+
+/* Dispose the retired links that are not hazardous. Returns the number of
+ * links left */
+static int zm_imsqueue_scan(void) {
+    int i, j = 0;
+    for (i = 0; i < zm_imsq_nretired; i++) {
+        zm_imsq_retired_t r = zm_imsq_retired[i];
+        if (zm_hzdptr_hazardous((zm_ptr_t)r.link))
+            zm_imsq_retired[j++] = r;
+        else
+            r.dispose(r.link);
+    }
+    zm_imsq_nretired = j;
+    return j;
+}
+
+static void zm_imsqueue_retire(zm_imsqueue_t *q, zm_qlink_t *link) {
+    unsigned spins = 0;
+    /* the stub lives as long as the queue */
+    if (link == &q->stub || q->dispose == NULL)
+        return;
+    while (zm_imsq_nretired == ZM_IMSQUEUE_RETIRED && zm_imsqueue_scan() == ZM_IMSQUEUE_RETIRED)
+        zm_wait_spin(&spins);
+    zm_imsq_retired[zm_imsq_nretired].link = link;
+    zm_imsq_retired[zm_imsq_nretired].dispose = q->dispose;
+    zm_imsq_nretired++;
+}
+
+/*
+   Body of the routines
+ */
+
+int zm_imsqueue_init(zm_imsqueue_t *q, zm_qlink_dispose_t dispose) {
+    zm_atomic_store(&q->stub.next, ZM_NULL, zm_memord_relaxed);
+    q->dispose = dispose;
+    zm_atomic_store(&q->head, (zm_ptr_t)&q->stub, zm_memord_release);
+    zm_atomic_store(&q->tail, (zm_ptr_t)&q->stub, zm_memord_release);
+    zm_ec_init(&q->ec);
+    return 0;
+}
+
+/* The last dequeued element is still the dummy: hand it back too */
+int zm_imsqueue_destroy(zm_imsqueue_t *q) {
+    zm_qlink_t *dummy = (zm_qlink_t*) LOAD(&q->head);
+    zm_atomic_store(&q->head, (zm_ptr_t)&q->stub, zm_memord_release);
+    zm_atomic_store(&q->tail, (zm_ptr_t)&q->stub, zm_memord_release);
+    zm_imsqueue_retire(q, dummy);
+    zm_imsqueue_scan();
+    return 0;
+}
+
+int zm_imsqueue_enqueue(zm_imsqueue_t* q, zm_qlink_t *link) {
+    zm_ptr_t tail;
+    zm_ptr_t next;
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    zm_atomic_store(&link->next, ZM_NULL, zm_memord_release);
+    while (1) {
+        tail = LOAD(&q->tail);
+        hzdptrs[0] = tail;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        if (tail != LOAD(&q->tail))
+            continue;
+        next = LOAD(&((zm_qlink_t*)tail)->next);
+        if (next == ZM_NULL) {
+            if (zm_atomic_compare_exchange_strong(&((zm_qlink_t*)tail)->next,
+                                                  &next,
+                                                  (zm_ptr_t)link,
+                                                  zm_memord_acq_rel,
+                                                  zm_memord_acquire))
+                break;
+        } else {
+            zm_atomic_compare_exchange_weak(&q->tail,
+                                            &tail,
+                                            next,
+                                            zm_memord_acq_rel,
+                                            zm_memord_acquire);
+        }
+    }
+    zm_atomic_compare_exchange_weak(&q->tail,
+                                    &tail,
+                                    (zm_ptr_t)link,
+                                    zm_memord_acq_rel,
+                                    zm_memord_acquire);
+    hzdptrs[0] = ZM_NULL;
+    zm_ec_notify(&q->ec);
+    return 0;
+}
+
+int zm_imsqueue_dequeue(zm_imsqueue_t* q, zm_qlink_t **link) {
+    zm_ptr_t head;
+    zm_ptr_t tail;
+    zm_ptr_t next;
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    while (1) {
+        head = LOAD(&q->head);
+        hzdptrs[0] = head;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        if (head != LOAD(&q->head))
+            continue;
+        tail = LOAD(&q->tail);
+        next = LOAD(&((zm_qlink_t*)head)->next);
+        hzdptrs[1] = next;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        /* next is safe to use only if head was not dequeued meanwhile */
+        if (head != LOAD(&q->head))
+            continue;
+        if (head == tail) {
+            if (next == ZM_NULL) {
+                hzdptrs[0] = hzdptrs[1] = ZM_NULL;
+                *link = NULL;
+                /* idle: hand back what can be, rather than wait for a
+                 * full list */
+                if (zm_imsq_nretired > 0)
+                    zm_imsqueue_scan();
+                return 0;
+            }
+            zm_atomic_compare_exchange_weak(&q->tail,
+                                            &tail,
+                                            next,
+                                            zm_memord_acq_rel,
+                                            zm_memord_acquire);
+        } else if (zm_atomic_compare_exchange_strong(&q->head,
+                                                     &head,
+                                                     next,
+                                                     zm_memord_acq_rel,
+                                                     zm_memord_acquire)) {
+            break;
+        }
+    }
+    hzdptrs[0] = hzdptrs[1] = ZM_NULL;
+    *link = (zm_qlink_t*)next;
+    zm_imsqueue_retire(q, (zm_qlink_t*)head);
+    return 1;
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_imsqueue_dequeue_wait(zm_imsqueue_t* q, zm_qlink_t **link) {
+    ZM_EC_WAIT_UNTIL(&q->ec, zm_imsqueue_dequeue(q, link));
+    return 1;
+}
+
+int zm_imsqueue_reclaim(void) {
+    zm_imsqueue_scan();
+    return 0;
+}
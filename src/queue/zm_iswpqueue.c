@@ -0,0 +1,77 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * Intrusive MPSC queue after Dmitry Vyukov's non-intrusive MPSC node-based
+ * queue:
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ *
+ * The queue keeps a stub link of its own. The consumer returns the head
+ * element once its successor is known, and pushes the stub back when it is
+ * about to take the last element, so that the queue never becomes empty of
+ * links.
+ */
+
+#include "queue/zm_iswpqueue.h"
+
+#define LOAD(addr)          zm_atomic_load(addr, zm_memord_acquire)
+#define STORE(addr, val)    zm_atomic_store(addr, val, zm_memord_release)
+
+static inline void zm_iswpqueue_push(zm_iswpqueue_t* q, zm_qlink_t *link) {
+    zm_qlink_t *prev;
+    zm_atomic_store(&link->next, ZM_NULL, zm_memord_relaxed);
+    prev = (zm_qlink_t*)zm_atomic_exchange_ptr(&q->tail, (zm_ptr_t)link, zm_memord_acq_rel);
+    STORE(&prev->next, (zm_ptr_t)link);
+}
+
+int zm_iswpqueue_init(zm_iswpqueue_t *q) {
+    zm_atomic_store(&q->stub.next, ZM_NULL, zm_memord_relaxed);
+    q->head = (zm_ptr_t)&q->stub;
+    zm_atomic_store(&q->tail, (zm_ptr_t)&q->stub, zm_memord_release);
+    zm_ec_init(&q->ec);
+    return 0;
+}
+
+int zm_iswpqueue_enqueue(zm_iswpqueue_t* q, zm_qlink_t *link) {
+    zm_iswpqueue_push(q, link);
+    zm_ec_notify(&q->ec);
+    return 0;
+}
+
+int zm_iswpqueue_dequeue(zm_iswpqueue_t* q, zm_qlink_t **link) {
+    zm_qlink_t *head = (zm_qlink_t*)q->head;
+    zm_qlink_t *next = (zm_qlink_t*)LOAD(&head->next);
+    *link = NULL;
+    if (head == &q->stub) {
+        if (next == NULL)
+            return 0;
+        q->head = (zm_ptr_t)next;
+        head = next;
+        next = (zm_qlink_t*)LOAD(&head->next);
+    }
+    if (next != NULL) {
+        q->head = (zm_ptr_t)next;
+        *link = head;
+        return 1;
+    }
+    /* head looks like the last element: unless a producer is still linking
+     * its successor, put the stub behind it and take it */
+    if ((zm_ptr_t)head != LOAD(&q->tail))
+        return 0;
+    zm_iswpqueue_push(q, &q->stub);
+    next = (zm_qlink_t*)LOAD(&head->next);
+    if (next != NULL) {
+        q->head = (zm_ptr_t)next;
+        *link = head;
+        return 1;
+    }
+    return 0;
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_iswpqueue_dequeue_wait(zm_iswpqueue_t* q, zm_qlink_t **link) {
+    ZM_EC_WAIT_UNTIL(&q->ec, zm_iswpqueue_dequeue(q, link));
+    return 1;
+}
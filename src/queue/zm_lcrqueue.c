@@ -0,0 +1,377 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * Unbounded MPMC queue as described in:
+ *
+ * Morrison, Adam, and Yehuda Afek. "Fast concurrent queues for x86
+ * processors." PPoPP'13.
+ *
+ * Each ring (CRQ) hands out cells with FAA on its head and tail. A cell
+ * holds a value and the index of the round it belongs to; a dequeuer that
+ * arrives before the enqueuer of its round moves the cell to the next round
+ * so that the late enqueuer fails and retries. A ring that fills up, or
+ * whose enqueuers keep failing, is closed and a new ring is appended.
+ *
+ * Rings are reclaimed with hazard pointers: dequeuers unlink rings from
+ * the head of the list and one cleaner at a time frees the unlinked rings,
+ * oldest first, up to the first one that is hazardous.
+ */
+
+#include <string.h>
+#include "zm_config.h"
+#include "queue/zm_lcrqueue.h"
+#include "mem/zm_hzdptr.h"
+
+#define ZM_LCRQUEUE_STARVING 16  /* failed enqueues before closing a ring */
+#define ZM_LCRQUEUE_SPIN     100 /* polls of a cell whose enqueuer is late */
+
+#define BOT             ZM_NULL
+#define TOP_BIT         (1UL << (sizeof(zm_ulong_t) * CHAR_BIT - 1))
+#define UNSAFE(i)       ((i) & TOP_BIT)
+#define INDEX(i)        ((i) & ~TOP_BIT)
+#define CLOSED(t)       ((t) & TOP_BIT)
+
+#define LOAD(addr)                  zm_atomic_load(addr, zm_memord_acquire)
+#define STORE(addr, val)            zm_atomic_store(addr, val, zm_memord_release)
+#define FAA(addr, val)              zm_atomic_fetch_add(addr, val, zm_memord_acq_rel)
+#define CAS(addr, expect, desire)   zm_atomic_compare_exchange_strong(addr,\
+                                                                      expect,\
+                                                                      desire,\
+                                                                      zm_memord_seq_cst,\
+                                                                      zm_memord_acquire)
+
+/*
+     Cell accesses
+ */
+
+#if defined(HAVE_DWCAS)
+
+typedef unsigned __int128 zm_lcrq_dword_t;
+
+static inline void zm_lcrqcell_load(zm_lcrqcell_t *c, zm_ptr_t *val, zm_ulong_t *idx) {
+    /* a torn snapshot is caught by the CAS that acts on it */
+    *idx = LOAD(&c->idx);
+    *val = LOAD(&c->val);
+}
+
+static inline int zm_lcrqcell_cas(zm_lcrqcell_t *c, zm_ptr_t oval, zm_ulong_t oidx,
+                                  zm_ptr_t nval, zm_ulong_t nidx) {
+    zm_lcrq_dword_t o = ((zm_lcrq_dword_t)oidx << 64) | (zm_ulong_t)oval;
+    zm_lcrq_dword_t n = ((zm_lcrq_dword_t)nidx << 64) | (zm_ulong_t)nval;
+    return __sync_bool_compare_and_swap((zm_lcrq_dword_t*)c, o, n);
+}
+
+#else
+
+/* no double-width CAS: cells are updated under striped spinlocks */
+#define ZM_LCRQ_NLOCKS 64
+
+static zm_atomic_flag_t zm_lcrq_locks[ZM_LCRQ_NLOCKS];
+
+static inline zm_atomic_flag_t *zm_lcrqcell_lock(zm_lcrqcell_t *c) {
+    zm_atomic_flag_t *lock = &zm_lcrq_locks[((zm_ptr_t)c / sizeof(*c)) % ZM_LCRQ_NLOCKS];
+    while (zm_atomic_flag_test_and_set(lock, zm_memord_acquire))
+        ; /* spin */
+    return lock;
+}
+
+static inline void zm_lcrqcell_load(zm_lcrqcell_t *c, zm_ptr_t *val, zm_ulong_t *idx) {
+    zm_atomic_flag_t *lock = zm_lcrqcell_lock(c);
+    *idx = zm_atomic_load(&c->idx, zm_memord_relaxed);
+    *val = zm_atomic_load(&c->val, zm_memord_relaxed);
+    zm_atomic_flag_clear(lock, zm_memord_release);
+}
+
+static inline int zm_lcrqcell_cas(zm_lcrqcell_t *c, zm_ptr_t oval, zm_ulong_t oidx,
+                                  zm_ptr_t nval, zm_ulong_t nidx) {
+    int ret = 0;
+    zm_atomic_flag_t *lock = zm_lcrqcell_lock(c);
+    if (zm_atomic_load(&c->val, zm_memord_relaxed) == oval &&
+        zm_atomic_load(&c->idx, zm_memord_relaxed) == oidx) {
+        zm_atomic_store(&c->val, nval, zm_memord_relaxed);
+        zm_atomic_store(&c->idx, nidx, zm_memord_relaxed);
+        ret = 1;
+    }
+    zm_atomic_flag_clear(lock, zm_memord_release);
+    return ret;
+}
+
+#endif /* HAVE_DWCAS */
+
+/* Consecutive indices are spread over different cache lines */
+static inline zm_lcrqcell_t *zm_lcrqcell_get(zm_lcrqring_t *r, zm_ulong_t i) {
+    i &= ZM_LCRQUEUE_RING_SIZE - 1;
+    return &r->cells[(i % ZM_LCRQCELLS_PER_LINE) * (ZM_LCRQUEUE_RING_SIZE / ZM_LCRQCELLS_PER_LINE)
+                     + i / ZM_LCRQCELLS_PER_LINE];
+}
+
+/*
+     Ring (CRQ) routines
+ */
+
+/* Returns NULL if out of memory */
+static zm_lcrqring_t *zm_lcrqring_alloc(void) {
+    zm_lcrqring_t *r;
+    zm_ulong_t i;
+    if (posix_memalign((void **) &r, ZM_CACHELINE_SIZE, sizeof(zm_lcrqring_t)) != 0)
+        return NULL;
+    for (i = 0; i < ZM_LCRQUEUE_RING_SIZE; i++) {
+        zm_lcrqcell_t *c = zm_lcrqcell_get(r, i);
+        zm_atomic_store(&c->val, BOT, zm_memord_relaxed);
+        zm_atomic_store(&c->idx, i, zm_memord_relaxed);
+    }
+    zm_atomic_store(&r->head, 0, zm_memord_relaxed);
+    zm_atomic_store(&r->tail, 0, zm_memord_relaxed);
+    zm_atomic_store(&r->next, ZM_NULL, zm_memord_release);
+    return r;
+}
+
+static inline void zm_lcrqring_close(zm_lcrqring_t *r) {
+    zm_ulong_t t = LOAD(&r->tail);
+    while (!CLOSED(t) && !CAS(&r->tail, &t, t | TOP_BIT))
+        t = LOAD(&r->tail);
+}
+
+/* Let tail catch up with head after dequeuers overtook it */
+static inline void zm_lcrqring_fix_state(zm_lcrqring_t *r) {
+    zm_ulong_t t, h;
+    while (1) {
+        t = LOAD(&r->tail);
+        h = LOAD(&r->head);
+        if (LOAD(&r->tail) != t)
+            continue;
+        if (h <= t || CAS(&r->tail, &t, h))
+            return;
+    }
+}
+
+/* Returns 0 if the ring is closed */
+static int zm_lcrqring_enqueue(zm_lcrqring_t *r, zm_ptr_t val) {
+    int tries = 0;
+    zm_ulong_t t, h, idx;
+    zm_ptr_t cval;
+    zm_lcrqcell_t *c;
+    while (1) {
+        t = FAA(&r->tail, 1);
+        if (CLOSED(t))
+            return 0;
+        c = zm_lcrqcell_get(r, t);
+        zm_lcrqcell_load(c, &cval, &idx);
+        if (cval == BOT && INDEX(idx) <= t &&
+            (!UNSAFE(idx) || LOAD(&r->head) <= t) &&
+            zm_lcrqcell_cas(c, BOT, idx, val, t))
+            return 1;
+        h = LOAD(&r->head);
+        if ((long)(t - h) >= ZM_LCRQUEUE_RING_SIZE || ++tries >= ZM_LCRQUEUE_STARVING) {
+            zm_lcrqring_close(r);
+            return 0;
+        }
+    }
+}
+
+/* Returns BOT if the ring is empty */
+static zm_ptr_t zm_lcrqring_dequeue(zm_lcrqring_t *r) {
+    zm_ulong_t h, t, cidx, idx, unsafe;
+    zm_ptr_t val;
+    zm_lcrqcell_t *c;
+    int spins;
+    while (1) {
+        h = FAA(&r->head, 1);
+        c = zm_lcrqcell_get(r, h);
+        spins = 0;
+        while (1) {
+            zm_lcrqcell_load(c, &val, &cidx);
+            unsafe = UNSAFE(cidx);
+            idx = INDEX(cidx);
+            if (idx > h)
+                break;
+            if (val != BOT) {
+                if (idx == h) {
+                    /* our value: take it and pass the cell to the next round */
+                    if (zm_lcrqcell_cas(c, val, cidx, BOT, unsafe | (h + ZM_LCRQUEUE_RING_SIZE)))
+                        return val;
+                } else {
+                    /* a value of an earlier round: its dequeuer is late */
+                    if (zm_lcrqcell_cas(c, val, cidx, val, TOP_BIT | idx))
+                        break;
+                }
+            } else {
+                t = LOAD(&r->tail);
+                if (!unsafe && !CLOSED(t) && t > h && spins < ZM_LCRQUEUE_SPIN) {
+                    /* the enqueuer of this cell is on its way */
+                    spins++;
+                    continue;
+                }
+                /* make the late enqueuer fail */
+                if (zm_lcrqcell_cas(c, val, cidx, BOT, unsafe | (h + ZM_LCRQUEUE_RING_SIZE)))
+                    break;
+            }
+        }
+        if (INDEX(LOAD(&r->tail)) <= h + 1) {
+            zm_lcrqring_fix_state(r);
+            return BOT;
+        }
+    }
+}
+
+/*
+     Helper functions
+ */
+
+static inline zm_lcrqring_t *zm_lcrqueue_protect(zm_atomic_ptr_t *ring, zm_hzdptr_t *hzdptrs) {
+    zm_ptr_t r;
+    do {
+        r = LOAD(ring);
+        hzdptrs[0] = r;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+    } while (r != LOAD(ring));
+    return (zm_lcrqring_t*)r;
+}
+
+/* Free the rings unlinked from the head of the list that are no longer
+ * hazardous */
+static void zm_lcrqueue_cleanup(zm_lcrqueue_t *q) {
+    zm_lcrqring_t *r, *head, *next;
+    if (zm_atomic_flag_test_and_set(&q->cleaning, zm_memord_acquire))
+        return;
+    head = (zm_lcrqring_t*) zm_atomic_load(&q->head, zm_memord_seq_cst);
+    r = (zm_lcrqring_t*) q->ring_free;
+    while (r != head && !zm_hzdptr_hazardous((zm_ptr_t)r)) {
+        next = (zm_lcrqring_t*) LOAD(&r->next);
+        free(r);
+        r = next;
+    }
+    q->ring_free = (zm_ptr_t)r;
+    zm_atomic_flag_clear(&q->cleaning, zm_memord_release);
+}
+
+/*
+   Body of the routines
+ */
+
+int zm_lcrqueue_init(zm_lcrqueue_t *q) {
+    zm_lcrqring_t *r = zm_lcrqring_alloc();
+    if (r == NULL)
+        return -1;
+    q->ring_free = (zm_ptr_t)r;
+    zm_atomic_flag_clear(&q->cleaning, zm_memord_relaxed);
+    zm_atomic_store(&q->tail, (zm_ptr_t)r, zm_memord_relaxed);
+    zm_atomic_store(&q->head, (zm_ptr_t)r, zm_memord_release);
+    zm_ec_init(&q->ec);
+    return 0;
+}
+
+int zm_lcrqueue_destroy(zm_lcrqueue_t *q) {
+    zm_lcrqring_t *r = (zm_lcrqring_t*) q->ring_free, *next;
+    while (r != NULL) {
+        next = (zm_lcrqring_t*) LOAD(&r->next);
+        free(r);
+        r = next;
+    }
+    q->ring_free = ZM_NULL;
+    return 0;
+}
+
+/* Returns -1, without adding data, if a new ring cannot be allocated */
+static int zm_lcrqueue_put(zm_lcrqueue_t* q, zm_hzdptr_t *hzdptrs, void *data) {
+    zm_lcrqring_t *r, *nr;
+    zm_ptr_t next;
+
+    while (1) {
+        r = zm_lcrqueue_protect(&q->tail, hzdptrs);
+        next = LOAD(&r->next);
+        if (next != ZM_NULL) {
+            zm_ptr_t expected = (zm_ptr_t)r;
+            CAS(&q->tail, &expected, next);
+            continue;
+        }
+        if (zm_lcrqring_enqueue(r, (zm_ptr_t)data))
+            break;
+        /* r is closed: append a new ring that holds our element */
+        nr = zm_lcrqring_alloc();
+        if (nr == NULL) {
+            hzdptrs[0] = ZM_NULL;
+            return -1;
+        }
+        zm_atomic_store(&zm_lcrqcell_get(nr, 0)->val, (zm_ptr_t)data, zm_memord_relaxed);
+        zm_atomic_store(&nr->tail, 1, zm_memord_relaxed);
+        next = ZM_NULL;
+        if (CAS(&r->next, &next, (zm_ptr_t)nr)) {
+            zm_ptr_t expected = (zm_ptr_t)r;
+            CAS(&q->tail, &expected, (zm_ptr_t)nr);
+            break;
+        }
+        free(nr); /* never published */
+    }
+    hzdptrs[0] = ZM_NULL;
+    return 0;
+}
+
+int zm_lcrqueue_enqueue(zm_lcrqueue_t* q, void *data) {
+    if (zm_lcrqueue_put(q, zm_hzdptr_get(), data) != 0)
+        return -1;
+    zm_ec_notify(&q->ec);
+    return 0;
+}
+
+/* Cells of a ring are taken one FAA at a time, so the elements are added
+ * one by one; the waiters are notified once */
+int zm_lcrqueue_enqueue_bulk(zm_lcrqueue_t* q, void *data[], int n) {
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    int i;
+    for (i = 0; i < n; i++)
+        if (zm_lcrqueue_put(q, hzdptrs, data[i]) != 0)
+            break;
+    if (i > 0)
+        zm_ec_notify_n(&q->ec, i);
+    return (i == n) ? 0 : -1;
+}
+
+int zm_lcrqueue_dequeue(zm_lcrqueue_t* q, void **data) {
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    zm_lcrqring_t *r;
+    zm_ptr_t val, next, expected;
+
+    while (1) {
+        r = zm_lcrqueue_protect(&q->head, hzdptrs);
+        val = zm_lcrqring_dequeue(r);
+        if (val != BOT)
+            break;
+        next = LOAD(&r->next);
+        if (next == ZM_NULL)
+            break;
+        /* enqueuers may have completed in r before it was closed */
+        val = zm_lcrqring_dequeue(r);
+        if (val != BOT)
+            break;
+        /* move tail past r first so that tail never lags behind head */
+        expected = (zm_ptr_t)r;
+        CAS(&q->tail, &expected, next);
+        expected = (zm_ptr_t)r;
+        if (CAS(&q->head, &expected, next)) {
+            hzdptrs[0] = ZM_NULL;
+            zm_lcrqueue_cleanup(q);
+        }
+    }
+    hzdptrs[0] = ZM_NULL;
+
+    *data = (void*)val;
+    return (val != BOT);
+}
+
+int zm_lcrqueue_dequeue_bulk(zm_lcrqueue_t* q, void *data[], int max, int *count) {
+    int n = 0;
+    while (n < max && zm_lcrqueue_dequeue(q, &data[n]))
+        n++;
+    *count = n;
+    return (n > 0);
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_lcrqueue_dequeue_wait(zm_lcrqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, zm_lcrqueue_dequeue(q, data));
+    return 1;
+}
@@ -83,19 +83,24 @@ int zm_mpbqueue_init(struct zm_mpbqueue *q, int nbuckets) {
     q->backoff_counters = backoff_counters;
     q->backoff_bounds = backoff_bounds;
     q->bucket_states = (char*) bucket_state_sets;
+    q->last_bucket_set = 0;
+    zm_ec_init(&q->ec);
 
     return 0;
 }
 
 int zm_mpbqueue_enqueue(struct zm_mpbqueue* q, void *data, int bucket_idx) {
 
-    /* Push to the queue at bucket_idx*/
-    zm_swpqueue_enqueue(&q->buckets[bucket_idx], data);
+    /* Push to the queue at bucket_idx; waiters only wait on q->ec */
+    if (zm_swpqueue_enqueue_quiet(&q->buckets[bucket_idx], data) != 0)
+        return -1;
+    zm_ec_notify(&q->ec);
 
     return 0;
 }
 
 int zm_mpbqueue_dequeue(struct zm_mpbqueue* q, void **data) {
+    int found = 0;
 
     *data = NULL;
 
@@ -113,6 +118,7 @@ int zm_mpbqueue_dequeue(struct zm_mpbqueue* q, void **data) {
                 int bucket_idx = offset * bucket_setsz + j;
                 if(!zm_swpqueue_isempty_weak(&q->buckets[bucket_idx])) {
                     zm_swpqueue_dequeue(&q->buckets[bucket_idx], data);
+                    found = 1;
                     break;
                 } else {
                     q->bucket_states[bucket_idx] = EMPTY_BUCKET;
@@ -123,6 +129,27 @@ int zm_mpbqueue_dequeue(struct zm_mpbqueue* q, void **data) {
         }
     }
     q->last_bucket_set = (q->last_bucket_set + i) % nbucket_sets;
+    return found;
+}
+
+/* Dequeue, then check every bucket, bypassing the backoff that may hide a
+ * nonempty one. Returns 1 if an element was dequeued. */
+static inline int try_dequeue(struct zm_mpbqueue* q, void **data) {
+    int i;
+    if (zm_mpbqueue_dequeue(q, data))
+        return 1;
+    for (i = 0; i < q->nbuckets; i++) {
+        if (!zm_swpqueue_isempty_weak(&q->buckets[i])) {
+            zm_swpqueue_dequeue(&q->buckets[i], data);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_mpbqueue_dequeue_wait(struct zm_mpbqueue* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, try_dequeue(q, data));
     return 1;
 }
 
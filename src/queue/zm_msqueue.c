@@ -5,32 +5,44 @@
 
 #include "queue/zm_msqueue.h"
 #include "mem/zm_hzdptr.h"
+#include "mem/zm_pool.h"
+
+/* Dequeued nodes go back to the pool once no hazard pointer refers to
+ * them. A hazard pointer is only trusted after a fence and a check that
+ * the node is still reachable from the queue. */
+static zm_pool_t zm_msqnode_pool = ZM_POOL_INITIALIZER(sizeof(zm_msqnode_t),
+                                                       __alignof__(zm_msqnode_t));
 
 int zm_msqueue_init(zm_msqueue_t *q) {
-    zm_msqnode_t* node = (zm_msqnode_t*) malloc(sizeof(zm_msqnode_t));
+    zm_msqnode_t* node = (zm_msqnode_t*) zm_pool_alloc(&zm_msqnode_pool);
+    if (node == NULL)
+        return -1;
     node->data = NULL;
     node->next = ZM_NULL;
     zm_atomic_store(&q->head, (zm_ptr_t)node, zm_memord_release);
     zm_atomic_store(&q->tail, (zm_ptr_t)node, zm_memord_release);
+    zm_ec_init(&q->ec);
     return 0;
 }
 
-int zm_msqueue_enqueue(zm_msqueue_t* q, void *data) {
+/* Append the chain of nodes first..last. A tail that lags behind by
+ * several nodes is moved forward one node at a time by the other
+ * operations. */
+static inline void zm_msqueue_append(zm_msqueue_t* q, zm_msqnode_t *first,
+                                     zm_msqnode_t *last) {
     zm_ptr_t tail;
     zm_ptr_t next;
     zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
-    zm_msqnode_t* node = (zm_msqnode_t*) malloc(sizeof(zm_msqnode_t));
-    node->data = data;
-    zm_atomic_store(&node->next, ZM_NULL, zm_memord_release);
     while (1) {
         tail = (zm_ptr_t) zm_atomic_load(&q->tail, zm_memord_acquire);
         hzdptrs[0] = tail;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
         if(tail == zm_atomic_load(&q->tail, zm_memord_acquire)) {
             next = (zm_ptr_t) zm_atomic_load(&((zm_msqnode_t*)tail)->next, zm_memord_acquire);
             if (next == ZM_NULL) {
                 if (zm_atomic_compare_exchange_strong(&((zm_msqnode_t*)tail)->next,
                                                       &next,
-                                                      (zm_ptr_t)node,
+                                                      (zm_ptr_t)first,
                                                       zm_memord_acq_rel,
                                                       zm_memord_acquire))
                     break;
@@ -45,9 +57,52 @@ int zm_msqueue_enqueue(zm_msqueue_t* q, void *data) {
     }
     zm_atomic_compare_exchange_weak(&q->tail,
                                     &tail,
-                                    (zm_ptr_t)node,
+                                    (zm_ptr_t)last,
                                     zm_memord_acq_rel,
                                     zm_memord_acquire);
+    hzdptrs[0] = ZM_NULL;
+}
+
+int zm_msqueue_enqueue(zm_msqueue_t* q, void *data) {
+    zm_msqnode_t* node = (zm_msqnode_t*) zm_pool_alloc(&zm_msqnode_pool);
+    if (node == NULL)
+        return -1;
+    node->data = data;
+    zm_atomic_store(&node->next, ZM_NULL, zm_memord_release);
+    zm_msqueue_append(q, node, node);
+    zm_ec_notify(&q->ec);
+    return 0;
+}
+
+/* The nodes are linked privately and appended with a single CAS */
+int zm_msqueue_enqueue_bulk(zm_msqueue_t* q, void *data[], int n) {
+    zm_msqnode_t *first, *last, *node;
+    int i;
+    if (n <= 0)
+        return 0;
+    first = last = (zm_msqnode_t*) zm_pool_alloc(&zm_msqnode_pool);
+    if (first == NULL)
+        return -1;
+    first->data = data[0];
+    for (i = 1; i < n; i++) {
+        node = (zm_msqnode_t*) zm_pool_alloc(&zm_msqnode_pool);
+        if (node == NULL) {
+            /* nothing was enqueued: give back the partial chain */
+            while (first != last) {
+                node = (zm_msqnode_t*) zm_atomic_load(&first->next, zm_memord_relaxed);
+                zm_pool_free(&zm_msqnode_pool, first);
+                first = node;
+            }
+            zm_pool_free(&zm_msqnode_pool, last);
+            return -1;
+        }
+        node->data = data[i];
+        zm_atomic_store(&last->next, (zm_ptr_t)node, zm_memord_relaxed);
+        last = node;
+    }
+    zm_atomic_store(&last->next, ZM_NULL, zm_memord_release);
+    zm_msqueue_append(q, first, last);
+    zm_ec_notify_n(&q->ec, n);
     return 0;
 }
 
@@ -56,33 +111,57 @@ int zm_msqueue_dequeue(zm_msqueue_t* q, void **data) {
     zm_ptr_t tail;
     zm_ptr_t next;
     zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
-    *data = NULL;
     while (1) {
         head = (zm_ptr_t) zm_atomic_load(&q->head, zm_memord_acquire);
         hzdptrs[0] = head;
-        if(head == q->head) {
-            tail = (zm_ptr_t) zm_atomic_load(&q->tail, zm_memord_acquire);
-            next = (zm_ptr_t) zm_atomic_load(&((zm_msqnode_t*)head)->next, zm_memord_acquire);
-            hzdptrs[1] = next;
-            if (head == tail) {
-                if (next == ZM_NULL) return 0;
-                zm_atomic_compare_exchange_weak(&q->tail,
-                                                &tail,
-                                                (zm_ptr_t)next,
-                                                zm_memord_acq_rel,
-                                                zm_memord_acquire);
-            } else {
-                if (zm_atomic_compare_exchange_strong(&q->head,
-                                                      &head,
-                                                      (zm_ptr_t)next,
-                                                      zm_memord_acq_rel,
-                                                      zm_memord_acquire)) {
-                    *data = ((zm_msqnode_t*)next)->data;
-                    break;
-                }
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        if(head != zm_atomic_load(&q->head, zm_memord_acquire))
+            continue;
+        tail = (zm_ptr_t) zm_atomic_load(&q->tail, zm_memord_acquire);
+        next = (zm_ptr_t) zm_atomic_load(&((zm_msqnode_t*)head)->next, zm_memord_acquire);
+        hzdptrs[1] = next;
+        zm_atomic_thread_fence(zm_memord_seq_cst);
+        /* next is safe to use only if head was not dequeued meanwhile */
+        if(head != zm_atomic_load(&q->head, zm_memord_acquire))
+            continue;
+        if (head == tail) {
+            if (next == ZM_NULL) {
+                hzdptrs[0] = hzdptrs[1] = ZM_NULL;
+                *data = NULL;
+                return 0;
             }
+            zm_atomic_compare_exchange_weak(&q->tail,
+                                            &tail,
+                                            (zm_ptr_t)next,
+                                            zm_memord_acq_rel,
+                                            zm_memord_acquire);
+        } else {
+            /* read the data before another dequeuer can retire next */
+            *data = ((zm_msqnode_t*)next)->data;
+            if (zm_atomic_compare_exchange_strong(&q->head,
+                                                  &head,
+                                                  (zm_ptr_t)next,
+                                                  zm_memord_acq_rel,
+                                                  zm_memord_acquire))
+                break;
         }
     }
-    zm_hzdptr_retire(head);
+    hzdptrs[0] = hzdptrs[1] = ZM_NULL;
+    zm_pool_retire(&zm_msqnode_pool, (void*)head);
+    return 1;
+}
+
+/* Dequeuers compete for each node, so elements are taken one at a time */
+int zm_msqueue_dequeue_bulk(zm_msqueue_t* q, void *data[], int max, int *count) {
+    int n = 0;
+    while (n < max && zm_msqueue_dequeue(q, &data[n]))
+        n++;
+    *count = n;
+    return (n > 0);
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_msqueue_dequeue_wait(zm_msqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, (zm_msqueue_dequeue(q, data), *data != NULL));
     return 1;
 }
@@ -8,6 +8,9 @@
 
 int zm_queue_if;
 
+static zm_atomic_uint_t zm_queue_nthreads = 0;
+static zm_thread_local int zm_queue_tid = -1;
+
 struct zm_queue_name_pair {
     int type;
     const char *name;
@@ -18,6 +21,10 @@ static struct zm_queue_name_pair name_pairs[] = {
     { ZM_MSQUEUE_IF, "ms" },
     { ZM_SWPQUEUE_IF, "swp" },
     { ZM_FAQUEUE_IF, "fa" },
+    { ZM_RBQUEUE_IF, "rb" },
+    { ZM_LCRQUEUE_IF, "lcrq" },
+    { ZM_MPBQUEUE_IF, "mpb" },
+    { ZM_SPSCQUEUE_IF, "spsc" },
     { -1, NULL } /* name == NULL indicates the end of the list */
 };
 
@@ -31,3 +38,10 @@ int zm_queue_parse_name(const char *name)
     }
     return -1; /* Matching queue type not found */
 }
+
+int zm_queue_thread_id(void)
+{
+    if (zm_unlikely(zm_queue_tid < 0))
+        zm_queue_tid = (int)zm_atomic_fetch_add(&zm_queue_nthreads, 1, zm_memord_relaxed);
+    return zm_queue_tid;
+}
@@ -0,0 +1,210 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * Bounded MPMC queue derived from Dmitry Vyukov's bounded MPMC queue:
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+
+#include "queue/zm_rbqueue.h"
+
+/*
+     Helper functions
+ */
+
+/* Consecutive positions are spread over different cache lines so that
+ * threads working on neighboring positions do not share a line */
+static inline zm_rbcell_t *zm_rbcell_get(zm_rbqueue_t *q, zm_ulong_t pos) {
+    zm_ulong_t idx = pos & q->mask;
+    return &q->cells[((idx % ZM_RBCELLS_PER_LINE) << q->shift)
+                     | (idx / ZM_RBCELLS_PER_LINE)];
+}
+
+/*
+   Body of the routines
+ */
+
+int zm_rbqueue_init(zm_rbqueue_t *q, zm_ulong_t capacity) {
+    zm_ulong_t size = ZM_RBCELLS_PER_LINE, i;
+    q->shift = 0;
+    while (size < capacity) {
+        size *= 2;
+        q->shift++;
+    }
+    if (posix_memalign((void **) &q->cells, ZM_CACHELINE_SIZE, sizeof(zm_rbcell_t) * size) != 0)
+        return -1;
+    q->mask = size - 1;
+    /* cell of position i is free for the enqueuer of position i */
+    for (i = 0; i < size; i++)
+        zm_atomic_store(&zm_rbcell_get(q, i)->seq, i, zm_memord_relaxed);
+    zm_atomic_store(&q->head, 0, zm_memord_relaxed);
+    zm_atomic_store(&q->tail, 0, zm_memord_release);
+    zm_ec_init(&q->ec);
+    return 0;
+}
+
+int zm_rbqueue_destroy(zm_rbqueue_t *q) {
+    free(q->cells);
+    return 0;
+}
+
+int zm_rbqueue_try_enqueue(zm_rbqueue_t* q, void *data) {
+    zm_rbcell_t *cell;
+    zm_ulong_t pos, seq;
+    long dif;
+    pos = zm_atomic_load(&q->tail, zm_memord_relaxed);
+    while (1) {
+        cell = zm_rbcell_get(q, pos);
+        seq = zm_atomic_load(&cell->seq, zm_memord_acquire);
+        dif = (long) seq - (long) pos;
+        if (dif == 0) {
+            /* the cell is free: claim the position */
+            if (zm_atomic_compare_exchange_weak(&q->tail, &pos, pos + 1,
+                                                zm_memord_relaxed,
+                                                zm_memord_relaxed))
+                break;
+            pos = zm_atomic_load(&q->tail, zm_memord_relaxed);
+        } else if (dif < 0) {
+            /* the cell still holds the element of the previous lap */
+            return 0;
+        } else {
+            /* another enqueuer claimed the position */
+            pos = zm_atomic_load(&q->tail, zm_memord_relaxed);
+        }
+    }
+    cell->data = data;
+    zm_atomic_store(&cell->seq, pos + 1, zm_memord_release);
+    zm_ec_notify(&q->ec);
+    return 1;
+}
+
+int zm_rbqueue_enqueue(zm_rbqueue_t* q, void *data) {
+    unsigned spins = 0;
+    while (!zm_rbqueue_try_enqueue(q, data))
+        zm_wait_spin(&spins);
+    return 0;
+}
+
+int zm_rbqueue_try_dequeue(zm_rbqueue_t* q, void **data) {
+    zm_rbcell_t *cell;
+    zm_ulong_t pos, seq;
+    long dif;
+    *data = NULL;
+    pos = zm_atomic_load(&q->head, zm_memord_relaxed);
+    while (1) {
+        cell = zm_rbcell_get(q, pos);
+        seq = zm_atomic_load(&cell->seq, zm_memord_acquire);
+        dif = (long) seq - (long) (pos + 1);
+        if (dif == 0) {
+            /* the cell is full: claim the position */
+            if (zm_atomic_compare_exchange_weak(&q->head, &pos, pos + 1,
+                                                zm_memord_relaxed,
+                                                zm_memord_relaxed))
+                break;
+            pos = zm_atomic_load(&q->head, zm_memord_relaxed);
+        } else if (dif < 0) {
+            /* the enqueuer of this position has not completed */
+            return 0;
+        } else {
+            /* another dequeuer claimed the position */
+            pos = zm_atomic_load(&q->head, zm_memord_relaxed);
+        }
+    }
+    *data = cell->data;
+    /* free the cell for the enqueuer of the next lap */
+    zm_atomic_store(&cell->seq, pos + q->mask + 1, zm_memord_release);
+    return 1;
+}
+
+int zm_rbqueue_dequeue(zm_rbqueue_t* q, void **data) {
+    return zm_rbqueue_try_dequeue(q, data);
+}
+
+/* Claim as many consecutive free cells as possible, up to n, with a single
+ * CAS on tail. A cell whose seq matches its position is free and no one
+ * else can take it once the position is ours. Returns the number of
+ * elements enqueued. */
+static int zm_rbqueue_try_enqueue_bulk(zm_rbqueue_t* q, void *data[], int n) {
+    zm_ulong_t pos;
+    int k;
+    pos = zm_atomic_load(&q->tail, zm_memord_relaxed);
+    while (1) {
+        for (k = 0; k < n; k++)
+            if (zm_atomic_load(&zm_rbcell_get(q, pos + k)->seq, zm_memord_acquire) != pos + k)
+                break;
+        if (k == 0) {
+            /* full, or another enqueuer claimed pos */
+            if (pos == zm_atomic_load(&q->tail, zm_memord_relaxed))
+                return 0;
+            pos = zm_atomic_load(&q->tail, zm_memord_relaxed);
+            continue;
+        }
+        if (zm_atomic_compare_exchange_weak(&q->tail, &pos, pos + k,
+                                            zm_memord_relaxed,
+                                            zm_memord_relaxed))
+            break;
+        pos = zm_atomic_load(&q->tail, zm_memord_relaxed);
+    }
+    for (n = 0; n < k; n++) {
+        zm_rbcell_t *cell = zm_rbcell_get(q, pos + n);
+        cell->data = data[n];
+        zm_atomic_store(&cell->seq, pos + n + 1, zm_memord_release);
+    }
+    zm_ec_notify_n(&q->ec, k);
+    return k;
+}
+
+/* Waits for room like zm_rbqueue_enqueue */
+int zm_rbqueue_enqueue_bulk(zm_rbqueue_t* q, void *data[], int n) {
+    unsigned spins = 0;
+    int k;
+    while (n > 0) {
+        k = zm_rbqueue_try_enqueue_bulk(q, data, n);
+        if (k == 0) {
+            zm_wait_spin(&spins);
+            continue;
+        }
+        data += k;
+        n -= k;
+    }
+    return 0;
+}
+
+/* Claim the consecutive full cells at head, up to max, with a single CAS */
+int zm_rbqueue_dequeue_bulk(zm_rbqueue_t* q, void *data[], int max, int *count) {
+    zm_ulong_t pos;
+    int k, i;
+    pos = zm_atomic_load(&q->head, zm_memord_relaxed);
+    while (1) {
+        for (k = 0; k < max; k++)
+            if (zm_atomic_load(&zm_rbcell_get(q, pos + k)->seq, zm_memord_acquire) != pos + k + 1)
+                break;
+        if (k == 0) {
+            /* empty, or another dequeuer claimed pos */
+            if (pos == zm_atomic_load(&q->head, zm_memord_relaxed))
+                break;
+            pos = zm_atomic_load(&q->head, zm_memord_relaxed);
+            continue;
+        }
+        if (zm_atomic_compare_exchange_weak(&q->head, &pos, pos + k,
+                                            zm_memord_relaxed,
+                                            zm_memord_relaxed))
+            break;
+        pos = zm_atomic_load(&q->head, zm_memord_relaxed);
+    }
+    for (i = 0; i < k; i++) {
+        zm_rbcell_t *cell = zm_rbcell_get(q, pos + i);
+        data[i] = cell->data;
+        zm_atomic_store(&cell->seq, pos + i + q->mask + 1, zm_memord_release);
+    }
+    *count = k;
+    return (k > 0);
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_rbqueue_dequeue_wait(zm_rbqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, zm_rbqueue_try_dequeue(q, data));
+    return 1;
+}
@@ -0,0 +1,125 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/*
+ * SPSC ring buffer with cached indices and batched index publication, in
+ * the spirit of:
+ *
+ * Giacomoni, John, Tipp Moseley, and Manish Vachharajani. "FastForward for
+ * efficient pipeline parallelism: a cache-optimized concurrent lock-free
+ * queue." PPoPP'08.
+ *
+ * Wang, Junchang, et al. "B-Queue: Efficient and practical queuing for fast
+ * core-to-core communication." IJPP 41.1 (2013): 137-159.
+ */
+
+#include "queue/zm_spscqueue.h"
+
+/*
+     Helper functions
+ */
+
+static inline void zm_spscqueue_publish_tail(zm_spscqueue_t *q) {
+    zm_atomic_store(&q->tail, q->ptail, zm_memord_release);
+    zm_ec_notify(&q->ec_data);
+}
+
+static inline void zm_spscqueue_publish_head(zm_spscqueue_t *q) {
+    zm_atomic_store(&q->head, q->phead, zm_memord_release);
+    zm_ec_notify(&q->ec_space);
+}
+
+static inline int zm_spscqueue_full(zm_spscqueue_t *q) {
+    if (q->ptail - q->head_cache <= q->mask)
+        return 0;
+    q->head_cache = zm_atomic_load(&q->head, zm_memord_acquire);
+    return (q->ptail - q->head_cache > q->mask);
+}
+
+/*
+   Body of the routines
+ */
+
+int zm_spscqueue_init(zm_spscqueue_t *q, zm_ulong_t capacity, int batch) {
+    zm_ulong_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    if (posix_memalign((void **) &q->cells, ZM_CACHELINE_SIZE, sizeof(void*) * size) != 0)
+        return -1;
+    q->mask = size - 1;
+    /* a side cannot wait for more than half of the ring to be published */
+    if (batch < 1)
+        batch = 1;
+    q->batch = ((zm_ulong_t) batch > size / 2) ? size / 2 : (zm_ulong_t) batch;
+    q->phead = 0;
+    q->tail_cache = 0;
+    q->ptail = 0;
+    q->head_cache = 0;
+    zm_atomic_store(&q->head, 0, zm_memord_relaxed);
+    zm_atomic_store(&q->tail, 0, zm_memord_release);
+    zm_ec_init(&q->ec_data);
+    zm_ec_init(&q->ec_space);
+    return 0;
+}
+
+int zm_spscqueue_destroy(zm_spscqueue_t *q) {
+    free(q->cells);
+    return 0;
+}
+
+int zm_spscqueue_try_enqueue(zm_spscqueue_t* q, void *data) {
+    if (zm_spscqueue_full(q))
+        return 0;
+    q->cells[q->ptail & q->mask] = data;
+    q->ptail++;
+    if (q->ptail - zm_atomic_load(&q->tail, zm_memord_relaxed) >= q->batch)
+        zm_spscqueue_publish_tail(q);
+    return 1;
+}
+
+int zm_spscqueue_enqueue(zm_spscqueue_t* q, void *data) {
+    unsigned key;
+    while (!zm_spscqueue_try_enqueue(q, data)) {
+        /* let the consumer see everything before waiting on it */
+        zm_spscqueue_flush(q);
+        zm_ec_prepare_wait(&q->ec_space, &key);
+        if (!zm_spscqueue_full(q)) {
+            zm_ec_cancel_wait(&q->ec_space);
+            continue;
+        }
+        zm_ec_commit_wait(&q->ec_space, key);
+    }
+    return 0;
+}
+
+int zm_spscqueue_flush(zm_spscqueue_t* q) {
+    if (q->ptail != zm_atomic_load(&q->tail, zm_memord_relaxed))
+        zm_spscqueue_publish_tail(q);
+    return 0;
+}
+
+int zm_spscqueue_dequeue(zm_spscqueue_t* q, void **data) {
+    if (q->phead == q->tail_cache) {
+        q->tail_cache = zm_atomic_load(&q->tail, zm_memord_acquire);
+        if (q->phead == q->tail_cache) {
+            /* empty: give the producer all the cells we consumed */
+            if (q->phead != zm_atomic_load(&q->head, zm_memord_relaxed))
+                zm_spscqueue_publish_head(q);
+            *data = NULL;
+            return 0;
+        }
+    }
+    *data = q->cells[q->phead & q->mask];
+    q->phead++;
+    if (q->phead - zm_atomic_load(&q->head, zm_memord_relaxed) >= q->batch)
+        zm_spscqueue_publish_head(q);
+    return 1;
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_spscqueue_dequeue_wait(zm_spscqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec_data, zm_spscqueue_dequeue(q, data));
+    return 1;
+}
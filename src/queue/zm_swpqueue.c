@@ -4,19 +4,28 @@
  */
 
 #include "queue/zm_swpqueue.h"
+#include "mem/zm_pool.h"
+
+static zm_pool_t zm_swpqnode_pool = ZM_POOL_INITIALIZER(sizeof(zm_swpqnode_t),
+                                                        __alignof__(zm_swpqnode_t));
 
 int zm_swpqueue_init(zm_swpqueue_t *q) {
-    zm_swpqnode_t* node = (zm_swpqnode_t*) malloc(sizeof(zm_swpqnode_t));
+    zm_swpqnode_t* node = (zm_swpqnode_t*) zm_pool_alloc(&zm_swpqnode_pool);
+    if (node == NULL)
+        return -1;
     node->data = NULL;
     node->next = ZM_NULL;
     zm_atomic_store(&q->head, (zm_ptr_t)node, zm_memord_release);
     zm_atomic_store(&q->tail, (zm_ptr_t)node, zm_memord_release);
+    zm_ec_init(&q->ec);
     return 0;
 }
 
-int zm_swpqueue_enqueue(zm_swpqueue_t* q, void *data) {
+int zm_swpqueue_enqueue_quiet(zm_swpqueue_t* q, void *data) {
     zm_swpqnode_t* pred;
-    zm_swpqnode_t* node = (zm_swpqnode_t*) malloc(sizeof(zm_swpqnode_t));
+    zm_swpqnode_t* node = (zm_swpqnode_t*) zm_pool_alloc(&zm_swpqnode_pool);
+    if (node == NULL)
+        return -1;
     node->data = data;
     zm_atomic_store(&node->next, ZM_NULL, zm_memord_release);
     pred = (zm_swpqnode_t*)zm_atomic_exchange_ptr(&q->tail, (zm_ptr_t)node, zm_memord_acq_rel);
@@ -24,6 +33,13 @@ int zm_swpqueue_enqueue(zm_swpqueue_t* q, void *data) {
     return 0;
 }
 
+int zm_swpqueue_enqueue(zm_swpqueue_t* q, void *data) {
+    if (zm_swpqueue_enqueue_quiet(q, data) != 0)
+        return -1;
+    zm_ec_notify(&q->ec);
+    return 0;
+}
+
 int zm_swpqueue_dequeue(zm_swpqueue_t* q, void **data) {
     zm_swpqnode_t* head;
     zm_ptr_t next;
@@ -36,8 +52,108 @@ int zm_swpqueue_dequeue(zm_swpqueue_t* q, void **data) {
         next = (zm_ptr_t) zm_atomic_load(&head->next, zm_memord_acquire);
         zm_atomic_store(&q->head, next, zm_memord_release);
         *data = ((zm_swpqnode_t*)next)->data;
-        free(head);
+        zm_pool_free(&zm_swpqnode_pool, head);
+    }
+    return 1;
+}
+
+/* The nodes are linked privately and the chain is spliced in with a
+ * single exchange of the tail */
+int zm_swpqueue_enqueue_bulk(zm_swpqueue_t* q, void *data[], int n) {
+    zm_swpqnode_t *first, *last, *node, *pred;
+    int i;
+    if (n <= 0)
+        return 0;
+    first = last = (zm_swpqnode_t*) zm_pool_alloc(&zm_swpqnode_pool);
+    if (first == NULL)
+        return -1;
+    first->data = data[0];
+    for (i = 1; i < n; i++) {
+        node = (zm_swpqnode_t*) zm_pool_alloc(&zm_swpqnode_pool);
+        if (node == NULL) {
+            /* nothing was enqueued: give back the partial chain */
+            while (first != last) {
+                node = (zm_swpqnode_t*) zm_atomic_load(&first->next, zm_memord_relaxed);
+                zm_pool_free(&zm_swpqnode_pool, first);
+                first = node;
+            }
+            zm_pool_free(&zm_swpqnode_pool, last);
+            return -1;
+        }
+        node->data = data[i];
+        zm_atomic_store(&last->next, (zm_ptr_t)node, zm_memord_relaxed);
+        last = node;
+    }
+    zm_atomic_store(&last->next, ZM_NULL, zm_memord_release);
+    pred = (zm_swpqnode_t*)zm_atomic_exchange_ptr(&q->tail, (zm_ptr_t)last, zm_memord_acq_rel);
+    zm_atomic_store(&pred->next, (zm_ptr_t)first, zm_memord_release);
+    zm_ec_notify_n(&q->ec, n);
+    return 0;
+}
+
+int zm_swpqueue_dequeue_bulk(zm_swpqueue_t* q, void *data[], int max, int *count) {
+    zm_swpqnode_t *head, *next;
+    int n = 0;
+    head = (zm_swpqnode_t*) zm_atomic_load(&q->head, zm_memord_acquire);
+    while (n < max) {
+        next = (zm_swpqnode_t*) zm_atomic_load(&head->next, zm_memord_acquire);
+        if (next == NULL)
+            break;
+        data[n++] = next->data;
+        zm_pool_free(&zm_swpqnode_pool, head);
+        head = next;
+    }
+    zm_atomic_store(&q->head, (zm_ptr_t)head, zm_memord_release);
+    *count = n;
+    return (n > 0);
+}
+
+/* Dequeue, blocking on the eventcount while the queue is empty */
+int zm_swpqueue_dequeue_wait(zm_swpqueue_t* q, void **data) {
+    ZM_EC_WAIT_UNTIL(&q->ec, (zm_swpqueue_dequeue(q, data), *data != NULL));
+    return 1;
+}
+
+/* The tail is swapped with a fresh dummy node, which becomes the head. The
+ * detached chain goes from the old dummy to the old tail. */
+int zm_swpqueue_take_all(zm_swpqueue_t* q, zm_swpqlist_t *list) {
+    zm_swpqnode_t *head, *dummy;
+    head = (zm_swpqnode_t*) zm_atomic_load(&q->head, zm_memord_acquire);
+    if ((zm_ptr_t)head == zm_atomic_load(&q->tail, zm_memord_acquire)) {
+        list->node = list->last = NULL;
+        return 0;
+    }
+    dummy = (zm_swpqnode_t*) zm_pool_alloc(&zm_swpqnode_pool);
+    if (dummy == NULL) {
+        list->node = list->last = NULL;
+        return -1;
+    }
+    dummy->data = NULL;
+    zm_atomic_store(&dummy->next, ZM_NULL, zm_memord_relaxed);
+    zm_atomic_store(&q->head, (zm_ptr_t)dummy, zm_memord_release);
+    list->last = (zm_swpqnode_t*)zm_atomic_exchange_ptr(&q->tail, (zm_ptr_t)dummy,
+                                                        zm_memord_acq_rel);
+    list->node = head;
+    return 1;
+}
+
+int zm_swpqueue_list_next(zm_swpqlist_t *list, void **data) {
+    zm_swpqnode_t *node = list->node, *next;
+    unsigned spins = 0;
+    *data = NULL;
+    if (node == NULL)
+        return 0;
+    if (node == list->last) {
+        zm_pool_free(&zm_swpqnode_pool, node);
+        list->node = list->last = NULL;
+        return 0;
     }
+    /* a producer may have swapped the tail but not linked its node yet */
+    while ((next = (zm_swpqnode_t*) zm_atomic_load(&node->next, zm_memord_acquire)) == NULL)
+        zm_wait_spin(&spins);
+    zm_pool_free(&zm_swpqnode_pool, node);
+    list->node = next;
+    *data = next->data;
     return 1;
 }
 
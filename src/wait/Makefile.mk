@@ -0,0 +1,8 @@
+# -*- Mode: Makefile; -*-
+#
+# See COPYRIGHT in top-level directory.
+#
+
+zm_sources += \
+	wait/zm_wait.c \
+	wait/zm_ult.c
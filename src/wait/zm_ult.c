@@ -0,0 +1,214 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "zm_config.h"
+#include "wait/zm_ult.h"
+
+#if defined(HAVE_UCONTEXT_H)
+#include <ucontext.h>
+
+#define ULT_READY   0
+#define ULT_BLOCKED 1
+#define ULT_DONE    2
+
+struct ult {
+    ucontext_t ctx;
+    void *stack;
+    zm_ult_fn_t fn;
+    zm_ptr_t arg;
+    int state;
+    zm_atomic_uint_t *addr; /* blocked on *addr == val */
+    unsigned val;
+    struct ult *next;
+};
+
+struct ult_list {
+    struct ult *head;
+    struct ult *tail;
+};
+
+/* Scheduler state of the calling OS thread */
+static zm_thread_local ucontext_t sched_ctx;
+static zm_thread_local struct ult *current = NULL;
+static zm_thread_local struct ult_list ready = {NULL, NULL};
+static zm_thread_local struct ult_list blocked = {NULL, NULL};
+static zm_thread_local int nlive = 0;
+
+static zm_wait_hooks_t prev_hooks;
+
+static inline void list_push(struct ult_list *l, struct ult *u) {
+    u->next = NULL;
+    if (l->tail != NULL)
+        l->tail->next = u;
+    else
+        l->head = u;
+    l->tail = u;
+}
+
+static inline struct ult *list_pop(struct ult_list *l) {
+    struct ult *u = l->head;
+    if (u != NULL) {
+        l->head = u->next;
+        if (l->head == NULL)
+            l->tail = NULL;
+    }
+    return u;
+}
+
+/* Move the blocked ULTs that match to the ready list. With addr == NULL,
+ * move those whose address changed. */
+static int unblock(zm_atomic_uint_t *addr, int n) {
+    struct ult *u = blocked.head, *prev = NULL, *next;
+    int moved = 0;
+    while (u != NULL && moved < n) {
+        next = u->next;
+        if ((addr != NULL) ? (u->addr == addr)
+                           : (zm_atomic_load(u->addr, zm_memord_acquire) != u->val)) {
+            if (prev != NULL)
+                prev->next = next;
+            else
+                blocked.head = next;
+            if (blocked.tail == u)
+                blocked.tail = prev;
+            u->state = ULT_READY;
+            list_push(&ready, u);
+            moved++;
+        } else {
+            prev = u;
+        }
+        u = next;
+    }
+    return moved;
+}
+
+static void ult_yield_hook() {
+    if (current == NULL) {
+        prev_hooks.yield();
+        return;
+    }
+    current->state = ULT_READY;
+    swapcontext(&current->ctx, &sched_ctx);
+}
+
+static void ult_block_hook(zm_atomic_uint_t *addr, unsigned val) {
+    if (current == NULL) {
+        prev_hooks.block(addr, val);
+        return;
+    }
+    if (zm_atomic_load(addr, zm_memord_acquire) != val)
+        return;
+    current->state = ULT_BLOCKED;
+    current->addr = addr;
+    current->val = val;
+    swapcontext(&current->ctx, &sched_ctx);
+}
+
+static void ult_block_timed_hook(zm_atomic_uint_t *addr, unsigned val, long timeout_ns) {
+    if (current == NULL) {
+        prev_hooks.block_timed(addr, val, timeout_ns);
+        return;
+    }
+    /* let the other ULTs run; the caller checks its deadline */
+    ult_yield_hook();
+}
+
+static void ult_wake_hook(zm_atomic_uint_t *addr, int n) {
+    /* waiters on other OS threads are either ULTs, which their scheduler
+     * polls, or OS threads blocked through the previous hooks */
+    n -= unblock(addr, n);
+    if (n > 0)
+        prev_hooks.wake(addr, n);
+}
+
+static void ult_entry() {
+    current->fn(current->arg);
+    current->state = ULT_DONE;
+    /* returns to sched_ctx through uc_link */
+}
+
+int zm_ult_init() {
+    zm_wait_hooks_t hooks = { ult_yield_hook, ult_block_hook, ult_wake_hook,
+                              ult_block_timed_hook };
+    prev_hooks = zm_wait_hooks;
+    zm_wait_set_hooks(&hooks);
+    return 0;
+}
+
+int zm_ult_finalize() {
+    zm_wait_set_hooks(&prev_hooks);
+    return 0;
+}
+
+int zm_ult_create(zm_ult_fn_t fn, zm_ptr_t arg) {
+    struct ult *u = (struct ult*) malloc(sizeof(struct ult));
+    if (u == NULL)
+        return -1;
+    u->stack = malloc(ZM_ULT_STACK_SIZE);
+    if (u->stack == NULL) {
+        free(u);
+        return -1;
+    }
+    u->fn = fn;
+    u->arg = arg;
+    u->state = ULT_READY;
+    getcontext(&u->ctx);
+    u->ctx.uc_stack.ss_sp = u->stack;
+    u->ctx.uc_stack.ss_size = ZM_ULT_STACK_SIZE;
+    u->ctx.uc_link = &sched_ctx;
+    makecontext(&u->ctx, ult_entry, 0);
+    list_push(&ready, u);
+    nlive++;
+    return 0;
+}
+
+int zm_ult_run() {
+    struct ult *u;
+    while (nlive > 0) {
+        /* ULTs woken from other OS threads only see their address change;
+         * check them on every round, since a ready ULT may be spinning on
+         * a lock that one of them has been granted */
+        if (blocked.head != NULL)
+            unblock(NULL, nlive);
+        u = list_pop(&ready);
+        if (u == NULL) {
+            prev_hooks.yield();
+            continue;
+        }
+        current = u;
+        swapcontext(&sched_ctx, &u->ctx);
+        current = NULL;
+        if (u->state == ULT_DONE) {
+            free(u->stack);
+            free(u);
+            nlive--;
+        } else if (u->state == ULT_READY) {
+            list_push(&ready, u);
+        } else {
+            list_push(&blocked, u);
+        }
+    }
+    return 0;
+}
+
+int zm_ult_yield() {
+    zm_wait_yield();
+    return 0;
+}
+
+#else
+
+int zm_ult_init() {
+    printf("IZEM:ULT:ERROR: ucontext is not available!\n");
+    return 1;
+}
+
+int zm_ult_finalize() { return 0; }
+int zm_ult_create(zm_ult_fn_t fn, zm_ptr_t arg) { return 1; }
+int zm_ult_run() { return 1; }
+int zm_ult_yield() { return 1; }
+
+#endif /* HAVE_UCONTEXT_H */
@@ -0,0 +1,86 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include <limits.h>
+#include <sched.h>
+#include <time.h>
+#include "zm_config.h"
+#include "wait/zm_wait.h"
+#if defined(HAVE_LINUX_FUTEX_H)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+static void default_yield() {
+    sched_yield();
+}
+
+#if defined(HAVE_LINUX_FUTEX_H) && defined(SYS_futex)
+static void default_block(zm_atomic_uint_t *addr, unsigned val) {
+    syscall(SYS_futex, (void *)addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void default_wake(zm_atomic_uint_t *addr, int n) {
+    syscall(SYS_futex, (void *)addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static void default_block_timed(zm_atomic_uint_t *addr, unsigned val, long timeout_ns) {
+    /* FUTEX_WAIT takes a relative timeout */
+    struct timespec ts = { timeout_ns / 1000000000L, timeout_ns % 1000000000L };
+    syscall(SYS_futex, (void *)addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+}
+#else
+static void default_block(zm_atomic_uint_t *addr, unsigned val) {
+    if (zm_atomic_load(addr, zm_memord_acquire) == val)
+        sched_yield();
+}
+
+static void default_wake(zm_atomic_uint_t *addr, int n) {
+}
+
+static void default_block_timed(zm_atomic_uint_t *addr, unsigned val, long timeout_ns) {
+    default_block(addr, val);
+}
+#endif
+
+/* for hooks registered without block_timed */
+static void yield_block_timed(zm_atomic_uint_t *addr, unsigned val, long timeout_ns) {
+    zm_wait_hooks.yield();
+}
+
+zm_wait_hooks_t zm_wait_hooks = {
+    default_yield,
+    default_block,
+    default_wake,
+    default_block_timed
+};
+
+long zm_wait_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+int zm_wait_get_default_hooks(zm_wait_hooks_t *hooks) {
+    hooks->yield = default_yield;
+    hooks->block = default_block;
+    hooks->wake = default_wake;
+    hooks->block_timed = default_block_timed;
+    return 0;
+}
+
+int zm_wait_set_hooks(const zm_wait_hooks_t *hooks) {
+    if (hooks == NULL)
+        zm_wait_get_default_hooks(&zm_wait_hooks);
+    else
+        zm_wait_hooks = *hooks;
+    if (zm_wait_hooks.block_timed == NULL)
+        zm_wait_hooks.block_timed = yield_block_timed;
+    return 0;
+}
@@ -0,0 +1,68 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <omp.h>
+#include <cond/zm_barrier.h>
+
+/* Latency of back-to-back barrier episodes for each barrier kind, with the
+ * OpenMP barrier as a reference. Thread i is expected to run on hardware
+ * thread i (e.g., OMP_PLACES=threads OMP_PROC_BIND=close) for the
+ * hierarchical barrier to follow the topology. Latency in microseconds per
+ * episode. */
+
+#define TEST_NEPISODES (1<<14)
+
+static const int kinds[] = {
+    ZM_BARRIER_CENTRAL,
+    ZM_BARRIER_DISSEMINATION,
+    ZM_BARRIER_TOURNAMENT,
+    ZM_BARRIER_HIERARCHICAL
+};
+#define NKINDS 4
+
+static void test_latency()
+{
+    int nthreads = omp_get_max_threads();
+    int cur_nthreads, k;
+
+    printf("nthreads,central,dissemination,tournament,hierarchical,omp\n");
+    for (cur_nthreads = 1; cur_nthreads <= nthreads; cur_nthreads *= 2) {
+        double latency[NKINDS + 1];
+        for (k = 0; k <= NKINDS; k++) {
+            zm_barrier_t barrier;
+            double start_time = 0.0;
+            if (k < NKINDS)
+                zm_barrier_init(&barrier, kinds[k], cur_nthreads);
+            #pragma omp parallel num_threads(cur_nthreads)
+            {
+                int tid = omp_get_thread_num();
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    start_time = omp_get_wtime();
+                }
+                for (int ep = 0; ep < TEST_NEPISODES; ep++) {
+                    if (k < NKINDS)
+                        zm_barrier_wait(barrier, tid);
+                    else {
+                        #pragma omp barrier
+                    }
+                }
+            }
+            latency[k] = (omp_get_wtime() - start_time) * 1e6 / TEST_NEPISODES;
+            if (k < NKINDS)
+                zm_barrier_destroy(&barrier);
+        }
+        printf("%d,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf\n", cur_nthreads,
+               latency[0], latency[1], latency[2], latency[3], latency[4]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    test_latency();
+    return 0;
+}
@@ -0,0 +1,128 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <omp.h>
+#include <hwloc.h>
+#include <lock/zm_lock.h>
+#include <cond/zm_ccond.h>
+#include <cond/zm_ncond.h>
+
+/* Multi-socket handoff test: threads bound to consecutive hardware threads
+ * share a small pool of tokens. A thread takes a token, waiting on the
+ * condition variable selected with ZMTEST_USE_* while the pool is empty,
+ * updates a shared buffer, and returns the token with a signal. It reports
+ * the handoffs per second and, among the takes that had to wait, the
+ * fraction that received a token returned from another package. */
+
+#define TEST_NITER (1<<16)
+#define BUFLEN 16
+
+#if defined(ZMTEST_USE_NCOND)
+#define COND_NAME "ncond"
+typedef zm_ncond_t zmtest_cond_t;
+#define zmtest_cond_init(C)             zm_ncond_init(C)
+#define zmtest_cond_destroy(C)          zm_ncond_destroy(C)
+#define zmtest_cond_wait(C, L, I)       zm_ncond_wait_c(*(C), L, I)
+#define zmtest_cond_signal(C)           zm_ncond_signal(*(C))
+#else
+#define COND_NAME "ccond"
+typedef struct zm_ccond zmtest_cond_t;
+#define zmtest_cond_init(C)             zm_ccond_init(C)
+#define zmtest_cond_destroy(C)          zm_ccond_destroy(C)
+#define zmtest_cond_wait(C, L, I)       zm_ccond_wait_c(C, L, I)
+#define zmtest_cond_signal(C)           zm_ccond_signal(C)
+#endif
+
+zm_lock_t lock;
+zmtest_cond_t cond;
+int tokens;
+int last_pkg = -1;  /* package of the thread that last returned a token */
+long buffer[BUFLEN];
+
+static int bind_thread(hwloc_topology_t topo, int tid) {
+    int npus = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_PU);
+    hwloc_obj_t pu = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PU, tid % npus);
+    hwloc_obj_t pkg = hwloc_get_ancestor_obj_by_type(topo, HWLOC_OBJ_PACKAGE, pu);
+    hwloc_set_cpubind(topo, pu->cpuset, HWLOC_CPUBIND_THREAD);
+    return (pkg != NULL) ? pkg->logical_index : 0;
+}
+
+static void handoff(int my_pkg, int niter, long *waited, long *remote) {
+    zm_lock_ctxt_t ctxt;
+    int iter, i, did_wait;
+    for (iter = 0; iter < niter; iter++) {
+        zm_lock_acquire_c(&lock, &ctxt);
+        did_wait = 0;
+        while (tokens == 0) {
+            zmtest_cond_wait(&cond, &lock, &ctxt);
+            did_wait = 1;
+        }
+        tokens--;
+        if (did_wait) {
+            (*waited)++;
+            if (last_pkg != my_pkg)
+                (*remote)++;
+        }
+        zm_lock_release_c(&lock, &ctxt);
+
+        for (i = 0; i < BUFLEN; i++)
+            buffer[i] += my_pkg;
+
+        zm_lock_acquire_c(&lock, &ctxt);
+        tokens++;
+        last_pkg = my_pkg;
+        zmtest_cond_signal(&cond);
+        zm_lock_release_c(&lock, &ctxt);
+    }
+}
+
+static void test_handoff()
+{
+    int nthreads = omp_get_max_threads();
+    int cur_nthreads;
+    hwloc_topology_t topo;
+
+    if (nthreads < 2)
+        nthreads = 2;
+    hwloc_topology_init(&topo);
+    hwloc_topology_load(topo);
+    zm_lock_init(&lock);
+    zmtest_cond_init(&cond);
+
+    printf("cond,nthreads,handoffs_per_sec,waited_ratio,remote_ratio\n");
+    for (cur_nthreads = 2; cur_nthreads <= nthreads; cur_nthreads *= 2) {
+        int niter = TEST_NITER / cur_nthreads;
+        long waited = 0, remote = 0;
+        double start_time, stop_time;
+
+        tokens = (cur_nthreads / 4 > 0) ? cur_nthreads / 4 : 1;
+        #pragma omp parallel num_threads(cur_nthreads) reduction(+:waited,remote)
+        {
+            int my_pkg = bind_thread(topo, omp_get_thread_num());
+            #pragma omp barrier
+            #pragma omp single
+            {
+                start_time = omp_get_wtime();
+            }
+            handoff(my_pkg, niter, &waited, &remote);
+        }
+        stop_time = omp_get_wtime();
+        printf("%s,%d,%.2lf,%.4lf,%.4lf\n", COND_NAME, cur_nthreads,
+               (double)niter * cur_nthreads / (stop_time - start_time),
+               (double)waited / ((double)niter * cur_nthreads),
+               (waited > 0) ? (double)remote / waited : 0.0);
+    }
+
+    zmtest_cond_destroy(&cond);
+    zm_lock_destroy(&lock);
+    hwloc_topology_destroy(topo);
+}
+
+int main(int argc, char **argv)
+{
+    test_handoff();
+    return 0;
+}
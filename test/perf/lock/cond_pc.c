@@ -0,0 +1,150 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <omp.h>
+#include <lock/zm_lock.h>
+#include <lock/zm_mcs.h>
+#include <cond/zm_ccond.h>
+#include <cond/zm_fcond.h>
+#include <cond/zm_mcond.h>
+
+/* Producer/consumer over a bounded buffer protected by one lock and two
+ * condition variables (not full, not empty), with the condition variable
+ * selected with ZMTEST_USE_*. Half of the threads produce and the other
+ * half consume. Besides the throughput, it reports how many times per item
+ * a thread waited, and how many times a woken thread found the predicate
+ * still false and had to wait again. ccond and fcond waiters contend for
+ * the lock again once woken; mcond waiters are handed the lock through its
+ * queue. */
+
+#define TEST_NITEMS (1<<18)
+#define BUFSZ 8
+
+#if defined(ZMTEST_USE_MCOND)
+#define COND_NAME "mcond"
+typedef struct zm_mcond zmtest_cond_t;
+typedef zm_mcs_t zmtest_lock_t;
+typedef zm_mcs_qnode_t zmtest_ctxt_t;
+#define zmtest_lock_init(L)             zm_mcs_init(L)
+#define zmtest_lock_destroy(L)          zm_mcs_destroy(L)
+#define zmtest_lock_acquire(L, I)       zm_mcs_acquire_c(*(L), I)
+#define zmtest_lock_release(L, I)       zm_mcs_release_c(*(L), I)
+#define zmtest_cond_init(C)             zm_mcond_init(C)
+#define zmtest_cond_destroy(C)          zm_mcond_destroy(C)
+#define zmtest_cond_wait(C, L, I)       zm_mcond_wait_c(C, *(L), I)
+#define zmtest_cond_signal(C)           zm_mcond_signal(C)
+#else
+typedef zm_lock_t zmtest_lock_t;
+typedef zm_lock_ctxt_t zmtest_ctxt_t;
+#define zmtest_lock_init(L)             zm_lock_init(L)
+#define zmtest_lock_destroy(L)          zm_lock_destroy(L)
+#define zmtest_lock_acquire(L, I)       zm_lock_acquire_c(L, I)
+#define zmtest_lock_release(L, I)       zm_lock_release_c(L, I)
+#if defined(ZMTEST_USE_FCOND)
+#define COND_NAME "fcond"
+typedef struct zm_fcond zmtest_cond_t;
+#define zmtest_cond_init(C)             zm_fcond_init(C)
+#define zmtest_cond_destroy(C)          zm_fcond_destroy(C)
+#define zmtest_cond_wait(C, L, I)       zm_fcond_wait_c(C, L, I)
+#define zmtest_cond_signal(C)           zm_fcond_signal(C)
+#else
+#define COND_NAME "ccond"
+typedef struct zm_ccond zmtest_cond_t;
+#define zmtest_cond_init(C)             zm_ccond_init(C)
+#define zmtest_cond_destroy(C)          zm_ccond_destroy(C)
+#define zmtest_cond_wait(C, L, I)       zm_ccond_wait_c(C, L, I)
+#define zmtest_cond_signal(C)           zm_ccond_signal(C)
+#endif
+#endif
+
+zmtest_lock_t lock;
+zmtest_cond_t notfull, notempty;
+int buffer[BUFSZ];
+int head = 0, count = 0;
+
+static void produce(int nitems, long *waits, long *rewaits) {
+    zmtest_ctxt_t ctxt;
+    int i, woken;
+    for (i = 0; i < nitems; i++) {
+        zmtest_lock_acquire(&lock, &ctxt);
+        woken = 0;
+        while (count == BUFSZ) {
+            if (woken)
+                (*rewaits)++;
+            (*waits)++;
+            zmtest_cond_wait(&notfull, &lock, &ctxt);
+            woken = 1;
+        }
+        buffer[(head + count) % BUFSZ] = i;
+        count++;
+        zmtest_cond_signal(&notempty);
+        zmtest_lock_release(&lock, &ctxt);
+    }
+}
+
+static void consume(int nitems, long *waits, long *rewaits) {
+    zmtest_ctxt_t ctxt;
+    int i, woken;
+    for (i = 0; i < nitems; i++) {
+        zmtest_lock_acquire(&lock, &ctxt);
+        woken = 0;
+        while (count == 0) {
+            if (woken)
+                (*rewaits)++;
+            (*waits)++;
+            zmtest_cond_wait(&notempty, &lock, &ctxt);
+            woken = 1;
+        }
+        head = (head + 1) % BUFSZ;
+        count--;
+        zmtest_cond_signal(&notfull);
+        zmtest_lock_release(&lock, &ctxt);
+    }
+}
+
+static void test_pc()
+{
+    int nthreads = omp_get_max_threads();
+    int cur_nthreads;
+
+    if (nthreads < 2)
+        nthreads = 2;
+    zmtest_lock_init(&lock);
+    zmtest_cond_init(&notfull);
+    zmtest_cond_init(&notempty);
+
+    printf("cond,nthreads,items_per_sec,waits_per_item,rewaits_per_item\n");
+    for (cur_nthreads = 2; cur_nthreads <= nthreads; cur_nthreads += 2) {
+        int npairs = cur_nthreads / 2;
+        int nitems = TEST_NITEMS / npairs;
+        long waits = 0, rewaits = 0;
+        double start_time, stop_time;
+
+        start_time = omp_get_wtime();
+        #pragma omp parallel num_threads(cur_nthreads) reduction(+:waits,rewaits)
+        {
+            if (omp_get_thread_num() % 2)
+                consume(nitems, &waits, &rewaits);
+            else
+                produce(nitems, &waits, &rewaits);
+        }
+        stop_time = omp_get_wtime();
+        printf("%s,%d,%.2lf,%.4lf,%.4lf\n", COND_NAME, cur_nthreads,
+               (double)nitems * npairs / (stop_time - start_time),
+               (double)waits / (nitems * npairs),
+               (double)rewaits / (nitems * npairs));
+    }
+
+    zmtest_cond_destroy(&notempty);
+    zmtest_cond_destroy(&notfull);
+    zmtest_lock_destroy(&lock);
+}
+
+int main(int argc, char **argv)
+{
+    test_pc();
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <omp.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "zmtest_abslock.h"
+#include "lock/zm_dlg.h"
+#include "lock/zm_ccsynch.h"
+
+/* Runs the critical section of thread_scale.c with the lock selected with
+ * ZMTEST_USE_*, through the delegation server, and through CC-Synch and
+ * H-Synch combining. */
+
+#define TEST_NITER (1<<22)
+#define WARMUP_ITER 128
+
+#define CACHELINE_SZ 64
+#define ARRAY_LEN 10
+
+char cache_lines[CACHELINE_SZ*ARRAY_LEN] = {0};
+
+#if ARRAY_LEN == 10
+int indices [] = {3,6,1,7,0,2,9,4,8,5};
+#elif ARRAY_LEN == 4
+int indices [] = {2,1,3,0};
+#endif
+
+zm_abslock_t lock;
+zm_dlg_t dlg;
+zm_ccsynch_t ccsynch;
+zm_hsynch_t hsynch;
+
+static zm_ptr_t critical_section(zm_ptr_t arg) {
+    for(int i = 0; i < ARRAY_LEN; i++)
+         cache_lines[indices[i]] += cache_lines[indices[ARRAY_LEN-1-i]];
+    return arg;
+}
+
+static void test_thruput()
+{
+    unsigned nthreads = omp_get_max_threads();
+    zm_dlg_client_t clients[nthreads];
+    zm_ccsynch_node_t *nodes[nthreads];
+
+    zm_abslock_init(&lock);
+    zm_dlg_init(&dlg, nthreads);
+    zm_ccsynch_init(&ccsynch);
+    zm_hsynch_init(&hsynch);
+    for(int i = 0; i < nthreads; i++) {
+        clients[i] = ZM_NULL;
+        zm_ccsynch_node_alloc(&nodes[i]);
+    }
+
+    int cur_nthreads;
+    /* Throughput = critical sections per second */
+    printf("nthreads,lock_thruput,dlg_thruput,ccsynch_thruput,hsynch_thruput\n");
+    for(cur_nthreads=1; cur_nthreads <= nthreads; cur_nthreads+= ((cur_nthreads==1) ? 1 : 2)) {
+        double start_time, lock_time, dlg_time, ccsynch_time, hsynch_time;
+        #pragma omp parallel num_threads(cur_nthreads)
+        {
+            int tid = omp_get_thread_num();
+            if (clients[tid] == ZM_NULL)
+                zm_dlg_register(dlg, &clients[tid]);
+
+            /* Warmup */
+            for(int iter=0; iter < WARMUP_ITER; iter++) {
+                zm_abslock_acquire(&lock);
+                critical_section(ZM_NULL);
+                zm_abslock_release(&lock);
+                zm_dlg_execute(clients[tid], critical_section, ZM_NULL, NULL);
+                zm_ccsynch_apply(&ccsynch, &nodes[tid], critical_section, ZM_NULL, NULL);
+                zm_hsynch_apply(hsynch, &nodes[tid], critical_section, ZM_NULL, NULL);
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                start_time = omp_get_wtime();
+            }
+            #pragma omp for schedule(static)
+            for(int iter = 0; iter < TEST_NITER; iter++) {
+                zm_abslock_acquire(&lock);
+                critical_section(ZM_NULL);
+                zm_abslock_release(&lock);
+            }
+            #pragma omp single
+            {
+                lock_time = omp_get_wtime() - start_time;
+                start_time = omp_get_wtime();
+            }
+            #pragma omp for schedule(static)
+            for(int iter = 0; iter < TEST_NITER; iter++)
+                zm_dlg_execute(clients[tid], critical_section, ZM_NULL, NULL);
+            #pragma omp single
+            {
+                dlg_time = omp_get_wtime() - start_time;
+                start_time = omp_get_wtime();
+            }
+            #pragma omp for schedule(static)
+            for(int iter = 0; iter < TEST_NITER; iter++)
+                zm_ccsynch_apply(&ccsynch, &nodes[tid], critical_section, ZM_NULL, NULL);
+            #pragma omp single
+            {
+                ccsynch_time = omp_get_wtime() - start_time;
+                start_time = omp_get_wtime();
+            }
+            #pragma omp for schedule(static)
+            for(int iter = 0; iter < TEST_NITER; iter++)
+                zm_hsynch_apply(hsynch, &nodes[tid], critical_section, ZM_NULL, NULL);
+        }
+        hsynch_time = omp_get_wtime() - start_time;
+        printf("%d,%.2lf,%.2lf,%.2lf,%.2lf\n", cur_nthreads,
+               (double)TEST_NITER/lock_time, (double)TEST_NITER/dlg_time,
+               (double)TEST_NITER/ccsynch_time, (double)TEST_NITER/hsynch_time);
+    }
+
+    for(int i = 0; i < nthreads; i++)
+        zm_ccsynch_node_free(nodes[i]);
+    zm_hsynch_destroy(&hsynch);
+    zm_ccsynch_destroy(&ccsynch);
+    zm_dlg_destroy(&dlg);
+    zm_abslock_destroy(&lock);
+}
+
+int main(int argc, char **argv)
+{
+  test_thruput();
+  return 0;
+}
@@ -0,0 +1,134 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <omp.h>
+#include "zmtest_abslock.h"
+#include "lock/zm_locktable.h"
+
+/* Compares one lock per object (the lock selected with ZMTEST_USE_*) with a
+ * striped lock table (the stripe lock selected with --with-locktable-lock)
+ * in memory footprint and in throughput of random object updates. */
+
+#define TEST_NITER (1<<20)
+#define TEST_NOBJS (1<<12)
+#define TEST_NSTRIPES 256
+
+struct object {
+    long counter;
+    char pad[64 - sizeof(long)];
+};
+
+static size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo mi = mallinfo();
+    return (size_t)mi.uordblks + (size_t)mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static void test_locktable(int nobjs, int nstripes)
+{
+    unsigned nthreads = omp_get_max_threads();
+    struct object *objs;
+    zm_abslock_t *locks;
+    zm_locktable_t table;
+    size_t heap, perobj_bytes, table_bytes;
+    int i, cur_nthreads, nrounds = 0;
+
+    posix_memalign((void **) &objs, 64, sizeof(struct object) * nobjs);
+    for (i = 0; i < nobjs; i++)
+        objs[i].counter = 0;
+
+    /* Memory footprint */
+    heap = heap_in_use();
+    locks = malloc(sizeof(zm_abslock_t) * nobjs);
+    for (i = 0; i < nobjs; i++)
+        zm_abslock_init(&locks[i]);
+    perobj_bytes = heap_in_use() - heap;
+
+    heap = heap_in_use();
+    zm_locktable_init(&table, nstripes);
+    table_bytes = heap_in_use() - heap + sizeof(table);
+
+    printf("# objects=%d stripes=%u\n", nobjs, table.nstripes);
+    printf("# memory per-object=%zu B (%.1lf B/object) locktable=%zu B\n",
+           perobj_bytes, (double)perobj_bytes/nobjs, table_bytes);
+
+    /* Throughput = object updates per second */
+    printf("nthreads,perobj_thruput,locktable_thruput\n");
+    for(cur_nthreads=1; cur_nthreads <= nthreads; cur_nthreads+= ((cur_nthreads==1) ? 1 : 2)) {
+        double start_time, perobj_time, table_time;
+
+        #pragma omp parallel num_threads(cur_nthreads)
+        {
+            unsigned seed = omp_get_thread_num() + 1;
+            #pragma omp barrier
+            #pragma omp single
+            {
+                start_time = omp_get_wtime();
+            }
+            #pragma omp for schedule(static)
+            for(int iter = 0; iter < TEST_NITER; iter++) {
+                int obj = rand_r(&seed) % nobjs;
+                zm_abslock_acquire(&locks[obj]);
+                objs[obj].counter++;
+                zm_abslock_release(&locks[obj]);
+            }
+            #pragma omp single
+            {
+                perobj_time = omp_get_wtime() - start_time;
+                start_time = omp_get_wtime();
+            }
+            #pragma omp for schedule(static)
+            for(int iter = 0; iter < TEST_NITER; iter++) {
+                int obj = rand_r(&seed) % nobjs;
+                zm_locktable_acquire(&table, (zm_ptr_t)&objs[obj]);
+                objs[obj].counter++;
+                zm_locktable_release(&table, (zm_ptr_t)&objs[obj]);
+            }
+        }
+        table_time = omp_get_wtime() - start_time;
+        nrounds++;
+        printf("%d,%.2lf,%.2lf\n", cur_nthreads,
+               (double)TEST_NITER/perobj_time, (double)TEST_NITER/table_time);
+    }
+
+    long total = 0;
+    for (i = 0; i < nobjs; i++)
+        total += objs[i].counter;
+    if (total != 2L * TEST_NITER * nrounds)
+        printf("# warning: lost updates (%ld)\n", total);
+
+    zm_locktable_destroy(&table);
+    for (i = 0; i < nobjs; i++)
+        zm_abslock_destroy(&locks[i]);
+    free(locks);
+    free(objs);
+}
+
+int main(int argc, char **argv)
+{
+    int c, nobjs = TEST_NOBJS, nstripes = TEST_NSTRIPES;
+    while((c = getopt(argc, argv, "n:s:")) != -1) {
+        switch (c) {
+            case 'n':
+                nobjs = atoi(optarg);
+                break;
+            case 's':
+                nstripes = atoi(optarg);
+                break;
+        }
+    }
+    test_locktable(nobjs, nstripes);
+    return 0;
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <omp.h>
+#include <semaphore.h>
+#include <cond/zm_sem.h>
+
+/* Bounded resource pool: threads repeatedly take a permit, touch the
+ * resource it guards, and give it back. Compares zm_sem with POSIX
+ * semaphores for pools smaller than, and as large as, the number of
+ * threads. Throughput = permits taken per second. */
+
+#define TEST_NITER (1<<20)
+#define RESOURCE_SZ 8
+
+long resources[64][RESOURCE_SZ] __attribute__((aligned(64)));
+
+static inline void use_resource(int tid) {
+    for (int i = 0; i < RESOURCE_SZ; i++)
+        resources[tid % 64][i]++;
+}
+
+static void test_pool()
+{
+    int nthreads = omp_get_max_threads();
+    int cur_nthreads, npermits;
+    struct zm_sem zsem;
+    sem_t psem;
+
+    printf("nthreads,npermits,zm_sem_thruput,posix_sem_thruput\n");
+    for (cur_nthreads = 1; cur_nthreads <= nthreads; cur_nthreads *= 2) {
+        for (npermits = 1; npermits <= cur_nthreads; npermits *= 2) {
+            double start_time, zm_time, posix_time;
+            zm_sem_init(&zsem, npermits);
+            sem_init(&psem, 0, npermits);
+            #pragma omp parallel num_threads(cur_nthreads)
+            {
+                int tid = omp_get_thread_num();
+                #pragma omp single
+                {
+                    start_time = omp_get_wtime();
+                }
+                #pragma omp for schedule(static)
+                for (int iter = 0; iter < TEST_NITER; iter++) {
+                    zm_sem_wait(&zsem);
+                    use_resource(tid);
+                    zm_sem_post(&zsem, 1);
+                }
+                #pragma omp single
+                {
+                    zm_time = omp_get_wtime() - start_time;
+                    start_time = omp_get_wtime();
+                }
+                #pragma omp for schedule(static)
+                for (int iter = 0; iter < TEST_NITER; iter++) {
+                    sem_wait(&psem);
+                    use_resource(tid);
+                    sem_post(&psem);
+                }
+            }
+            posix_time = omp_get_wtime() - start_time;
+            printf("%d,%d,%.2lf,%.2lf\n", cur_nthreads, npermits,
+                   (double)TEST_NITER / zm_time, (double)TEST_NITER / posix_time);
+            sem_destroy(&psem);
+            zm_sem_destroy(&zsem);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    test_pool();
+    return 0;
+}
@@ -8,6 +8,11 @@
 #include "zmtest_absqueue.h"
 #define TEST_NELEMTS  1000
 
+#if !defined(ZMTEST_ALLOC_QELEM)
+/* outlives the producers, which may finish before the consumers */
+static int input = 1;
+#endif
+
 /*-------------------------------------------------------------------------
  * Function: run
  *
@@ -22,8 +27,9 @@ static inline void run() {
     int max_threads = omp_get_max_threads();
     zm_absqueue_t* queues = malloc (max_threads/2 * sizeof(zm_absqueue_t));
     double t1, t2;
+    zm_ulong_t allocs;
 
-    printf("#threads \t throughput ops/s\n");
+    printf("#threads \t throughput ops/s \t allocator calls/op\n");
 
     int nthreads;
     for (nthreads = 2; nthreads <= max_threads; nthreads += 2) {
@@ -35,6 +41,7 @@ static inline void run() {
         nelem_enq = TEST_NELEMTS/(nthreads/2);
         nelem_deq = nelem_enq;
 
+        allocs = zmtest_allocator_calls();
         t1 = omp_get_wtime();
 
         #pragma omp parallel num_threads(nthreads)
@@ -43,8 +50,6 @@ static inline void run() {
             int tid, producer_b, qidx;
         #if defined(ZMTEST_ALLOC_QELEM)
             int *input;
-        #else
-            int input = 1;
         #endif
             tid = omp_get_thread_num();
             producer_b = (tid % 2 == 0);
@@ -62,6 +67,7 @@ static inline void run() {
                     zm_absqueue_enqueue(&queues[qidx], (void*) &input);
         #endif
                 }
+                zm_absqueue_flush(&queues[qidx]);
             } else {           /* consumer */
                 while(deq_count < nelem_deq) {
                     int* elem = NULL;
@@ -77,7 +83,9 @@ static inline void run() {
         }
 
         t2 = omp_get_wtime();
-        printf("%d \t %lf\n", nthreads, (double)nelem_deq*nthreads/(t2-t1));
+        allocs = zmtest_allocator_calls() - allocs;
+        printf("%d \t %lf \t %lf\n", nthreads, (double)nelem_deq*nthreads/(t2-t1),
+               (double)allocs/(nelem_deq*nthreads));
     }
 
 } /* end run() */
@@ -0,0 +1,83 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <omp.h>
+#include "queue/zm_faqueue.h"
+#define TEST_NELEMTS (1024*256)
+#define TEST_SAMPLE  1024 /* dequeues between footprint samples */
+
+static int input = 1;
+
+/*-------------------------------------------------------------------------
+ * Function: run
+ *
+ * Purpose: Measure the throughput of an fa queue shared by half of the
+ *  threads as producers and the other half as consumers, along with the
+ *  peak and final memory held in segments. Built once per segment layout
+ *  (padded or packed cells, malloc or hugepage arena).
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static inline void run() {
+    int max_threads = omp_get_max_threads();
+    zm_faqueue_t queue;
+    double t1, t2;
+    zm_ulong_t peak, bytes;
+
+    printf("#segment %lu B (%d cells of %lu B)\n", (unsigned long)sizeof(zm_faseg_t),
+           ZM_MAX_FASEG_SIZE, (unsigned long)sizeof(zm_facell_t));
+    printf("#threads \t throughput ops/s \t peak footprint B \t final footprint B\n");
+
+    int nthreads;
+    for (nthreads = 2; nthreads <= max_threads; nthreads += 2) {
+        zm_atomic_ulong_t deq_count = 0;
+        zm_atomic_ulong_t peak_bytes = 0;
+        zm_faqueue_init(&queue);
+        int nelem_enq = TEST_NELEMTS/(nthreads/2);
+        zm_ulong_t nelem_deq = nelem_enq * (nthreads/2);
+
+        t1 = omp_get_wtime();
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int tid = omp_get_thread_num();
+            int elem;
+            if (tid % 2 == 0) { /* producer */
+                for(elem=0; elem < nelem_enq; elem++)
+                    zm_faqueue_enqueue(&queue, (void*) &input);
+            } else {           /* consumer */
+                zm_ulong_t ndeq = 0, b;
+                while(zm_atomic_load(&deq_count, zm_memord_relaxed) < nelem_deq) {
+                    int* elem = NULL;
+                    zm_faqueue_dequeue(&queue, (void**)&elem);
+                    if ((elem != NULL) && (*elem == 1))
+                        zm_atomic_fetch_add(&deq_count, 1, zm_memord_relaxed);
+                    if (tid == 1 && ++ndeq % TEST_SAMPLE == 0) {
+                        zm_faqueue_footprint(&queue, &b);
+                        if (b > zm_atomic_load(&peak_bytes, zm_memord_relaxed))
+                            zm_atomic_store(&peak_bytes, b, zm_memord_relaxed);
+                    }
+                }
+            }
+        }
+
+        t2 = omp_get_wtime();
+        zm_faqueue_footprint(&queue, &bytes);
+        peak = zm_atomic_load(&peak_bytes, zm_memord_relaxed);
+        if (bytes > peak)
+            peak = bytes;
+        printf("%d \t %lf \t %lu \t %lu\n", nthreads, (double)nelem_deq/(t2-t1),
+               (unsigned long)peak, (unsigned long)bytes);
+        zm_faqueue_destroy(&queue);
+    }
+
+} /* end run() */
+
+int main(int argc, char **argv) {
+  run();
+} /* end main() */
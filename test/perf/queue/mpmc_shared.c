@@ -0,0 +1,70 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <omp.h>
+#include "zmtest_absqueue.h"
+#define TEST_NELEMTS (1024*256)
+
+/* outlives the producers, which may finish before the consumers */
+static int input = 1;
+
+/*-------------------------------------------------------------------------
+ * Function: run
+ *
+ * Purpose: Measure the throughput of a single queue shared by half of the
+ *  threads as producers and the other half as consumers. Elements are not
+ *  allocated, so the only allocator traffic is the queue's own.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static inline void run() {
+    int max_threads = omp_get_max_threads();
+    zm_absqueue_t queue;
+    double t1, t2;
+    zm_ulong_t allocs;
+
+    printf("#threads \t throughput ops/s \t allocator calls/op\n");
+
+    int nthreads;
+    for (nthreads = 2; nthreads <= max_threads; nthreads += 2) {
+        zm_atomic_ulong_t deq_count = 0;
+        zm_absqueue_init(&queue);
+        int nelem_enq = TEST_NELEMTS/(nthreads/2);
+        zm_ulong_t nelem_deq = nelem_enq * (nthreads/2);
+
+        allocs = zmtest_allocator_calls();
+        t1 = omp_get_wtime();
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int tid = omp_get_thread_num();
+            int elem;
+            if (tid % 2 == 0) { /* producer */
+                for(elem=0; elem < nelem_enq; elem++)
+                    zm_absqueue_enqueue(&queue, (void*) &input);
+            } else {           /* consumer */
+                while(zm_atomic_load(&deq_count, zm_memord_relaxed) < nelem_deq) {
+                    int* elem = NULL;
+                    zm_absqueue_dequeue(&queue, (void**)&elem);
+                    if ((elem != NULL) && (*elem == 1))
+                        zm_atomic_fetch_add(&deq_count, 1, zm_memord_relaxed);
+                }
+            }
+        }
+
+        t2 = omp_get_wtime();
+        allocs = zmtest_allocator_calls() - allocs;
+        printf("%d \t %lf \t %lf\n", nthreads, (double)nelem_deq/(t2-t1),
+               (double)allocs/(2.0*nelem_deq));
+    }
+
+} /* end run() */
+
+int main(int argc, char **argv) {
+  run();
+} /* end main() */
@@ -0,0 +1,138 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Cost of selecting the queue interface at runtime: each zm_queue_t
+ * carries its type, so queues of different types can live in the same
+ * process. The enqueue-dequeue loop below runs on an fa queue selected at
+ * runtime and on one selected at compile time (queue_dispatch_static.c). */
+
+#define ZM_QUEUE_CONF ZM_RUNTIMEQUEUE_IF
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <omp.h>
+#include <queue/zm_queue.h>
+
+#define TEST_NELEMTS  1000000
+#define TEST_NRUNS    5
+#define TEST_NMIXED   100000
+
+int zmtest_static_init(zm_queue_t *q);
+void zmtest_static_pairs(zm_queue_t *q, int nelem);
+
+static void zmtest_runtime_pairs(zm_queue_t *q, int nelem) {
+    static int input = 1;
+    void *elem;
+    int i;
+    for (i = 0; i < nelem; i++) {
+        zm_queue_enqueue(q, &input);
+        zm_queue_dequeue(q, &elem);
+    }
+}
+
+static double time_pairs(void (*pairs)(zm_queue_t*, int), zm_queue_t *q) {
+    double t1 = omp_get_wtime();
+    pairs(q, TEST_NELEMTS);
+    return (omp_get_wtime() - t1) * 1e9 / TEST_NELEMTS;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: run_dispatch
+ *
+ * Purpose: Compare the time of enqueue-dequeue pairs on an fa queue
+ *  selected at runtime and at compile time
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int run_dispatch() {
+    zm_queue_t rt_queue, static_queue;
+    double t, rt_ns = 0.0, static_ns = 0.0;
+    int run;
+
+    if (zm_queue_init_type(&rt_queue, ZM_FAQUEUE_IF) != 0 ||
+        zmtest_static_init(&static_queue) != 0)
+        return 1;
+
+    /* warm up, then keep the best of runs that alternate between both */
+    zmtest_static_pairs(&static_queue, TEST_NELEMTS / 10);
+    zmtest_runtime_pairs(&rt_queue, TEST_NELEMTS / 10);
+    for (run = 0; run < TEST_NRUNS; run++) {
+        t = time_pairs(zmtest_static_pairs, &static_queue);
+        if (run == 0 || t < static_ns)
+            static_ns = t;
+        t = time_pairs(zmtest_runtime_pairs, &rt_queue);
+        if (run == 0 || t < rt_ns)
+            rt_ns = t;
+    }
+
+    printf("selection \t ns/pair\n");
+    printf("compile-time \t %lf\n", static_ns);
+    printf("runtime \t %lf\n", rt_ns);
+    printf("overhead \t %lf%%\n", (rt_ns - static_ns) * 100.0 / static_ns);
+    return 0;
+}
+
+static zm_queue_t channel;
+
+static void *producer(void *arg) {
+    static int input = 1;
+    int i;
+    for (i = 0; i < TEST_NMIXED; i++)
+        zm_queue_enqueue(&channel, &input);
+    return NULL;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: run_mixed
+ *
+ * Purpose: Use an spsc queue as a channel between two threads while the
+ *  consumer moves the elements through an fa queue of its own
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int run_mixed() {
+    zm_queue_t local;
+    pthread_t thread;
+    void *elem;
+    int count = 0;
+    double t1, t2;
+
+    if (zm_queue_init_type(&channel, ZM_SPSCQUEUE_IF) != 0 ||
+        zm_queue_init_type(&local, ZM_FAQUEUE_IF) != 0)
+        return 1;
+
+    t1 = omp_get_wtime();
+    pthread_create(&thread, NULL, producer, NULL);
+    while (count < TEST_NMIXED) {
+        if (zm_queue_dequeue(&channel, &elem) && elem != NULL) {
+            zm_queue_enqueue(&local, elem);
+            zm_queue_dequeue(&local, &elem);
+            if (elem != NULL && *(int*)elem == 1)
+                count++;
+        }
+    }
+    pthread_join(thread, NULL);
+    t2 = omp_get_wtime();
+
+    printf("spsc -> fa \t %lf ops/s\n", (double)TEST_NMIXED / (t2 - t1));
+    zm_queue_dequeue(&channel, &elem);
+    return (elem != NULL);
+}
+
+int main(int argc, char **argv) {
+    int errs = 0;
+    errs += run_dispatch();
+    errs += run_mixed();
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
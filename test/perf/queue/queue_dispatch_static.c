@@ -0,0 +1,26 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* The same loop as in queue_dispatch.c, with the queue interface fixed to
+ * fa at compile time, so that the compiler resolves the dispatch */
+
+#define ZM_QUEUE_CONF ZM_FAQUEUE_IF
+#include <stdio.h>
+#include <stdlib.h>
+#include <queue/zm_queue.h>
+
+int zmtest_static_init(zm_queue_t *q) {
+    return zm_queue_init(q);
+}
+
+void zmtest_static_pairs(zm_queue_t *q, int nelem) {
+    static int input = 1;
+    void *elem;
+    int i;
+    for (i = 0; i < nelem; i++) {
+        zm_queue_enqueue(q, &input);
+        zm_queue_dequeue(q, &elem);
+    }
+}
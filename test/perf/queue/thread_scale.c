@@ -23,8 +23,9 @@ static inline void run() {
     unsigned test_counter = 0;
     zm_absqueue_t queue;
     double t1, t2;
+    zm_ulong_t allocs;
 
-    printf("#threads \t throughput ops/s\n");
+    printf("#threads \t throughput ops/s \t allocator calls/op\n");
 
     int nthreads;
     for (nthreads = 2; nthreads <= omp_get_max_threads(); nthreads ++) {
@@ -42,6 +43,7 @@ static inline void run() {
             nelem_deq = nelem_enq;
         #endif
 
+        allocs = zmtest_allocator_calls();
         t1 = omp_get_wtime();
 
         #pragma omp parallel num_threads(nthreads)
@@ -91,7 +93,9 @@ static inline void run() {
         }
 
         t2 = omp_get_wtime();
-        printf("%d \t %lf\n", nthreads, (double)nelem_deq*NITER/(t2-t1));
+        allocs = zmtest_allocator_calls() - allocs;
+        printf("%d \t %lf \t %lf\n", nthreads, (double)nelem_deq*NITER/(t2-t1),
+               (double)allocs/(2.0*nelem_deq*NITER));
     }
 
 } /* end run() */
@@ -39,7 +39,55 @@
 #define zm_absqueue_init    zm_msqueue_init
 #define zm_absqueue_enqueue zm_msqueue_enqueue
 #define zm_absqueue_dequeue zm_msqueue_dequeue
+#elif defined(ZMTEST_USE_RBQUEUE)
+#include <queue/zm_rbqueue.h>
+#ifndef ZMTEST_RBQUEUE_CAPACITY
+#define ZMTEST_RBQUEUE_CAPACITY 1024
+#endif
+/* types */
+#define zm_absqueue_t       zm_rbqueue_t
+#define zm_absqnode_t       zm_rbcell_t
+/* routines */
+#define zm_absqueue_init(q) zm_rbqueue_init(q, ZMTEST_RBQUEUE_CAPACITY)
+#define zm_absqueue_enqueue zm_rbqueue_enqueue
+#define zm_absqueue_dequeue zm_rbqueue_dequeue
+#elif defined(ZMTEST_USE_LCRQUEUE)
+#include <queue/zm_lcrqueue.h>
+/* types */
+#define zm_absqueue_t       zm_lcrqueue_t
+/* routines */
+#define zm_absqueue_init    zm_lcrqueue_init
+#define zm_absqueue_enqueue zm_lcrqueue_enqueue
+#define zm_absqueue_dequeue zm_lcrqueue_dequeue
+#elif defined(ZMTEST_USE_SPSCQUEUE)
+#include <queue/zm_spscqueue.h>
+#ifndef ZMTEST_SPSCQUEUE_CAPACITY
+#define ZMTEST_SPSCQUEUE_CAPACITY 1024
+#endif
+#ifndef ZMTEST_SPSCQUEUE_BATCH
+#define ZMTEST_SPSCQUEUE_BATCH 32
+#endif
+/* types */
+#define zm_absqueue_t       zm_spscqueue_t
+/* routines */
+#define zm_absqueue_init(q) zm_spscqueue_init(q, ZMTEST_SPSCQUEUE_CAPACITY, ZMTEST_SPSCQUEUE_BATCH)
+#define zm_absqueue_enqueue zm_spscqueue_enqueue
+#define zm_absqueue_dequeue zm_spscqueue_dequeue
+#define zm_absqueue_flush   zm_spscqueue_flush
 #else
 #error "No queue implementation specified"
 #endif
+
+/* queues that publish elements in batches define a flush routine */
+#ifndef zm_absqueue_flush
+#define zm_absqueue_flush(q)
+#endif
+
+/* calls to the system allocator made by the node pools of the queues */
+#include <mem/zm_pool.h>
+static inline zm_ulong_t zmtest_allocator_calls(void) {
+    zm_ulong_t nmallocs, nfrees;
+    zm_pool_stats(&nmallocs, &nfrees);
+    return nmallocs + nfrees;
+}
 #endif
@@ -0,0 +1,90 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <cond/zm_barrier.h>
+
+/* Each barrier kind is run for a number of episodes by a thread count that
+   is not a power of two. In every episode the threads count their arrival
+   before the barrier, and check after it that all the threads of the
+   episode arrived. The latch is counted down by all the threads, one of
+   them by two units, and waited on by the main thread. */
+
+#define TEST_NTHREADS 6
+#define TEST_NEPISODES 2000
+
+zm_barrier_t barrier;
+struct zm_latch latch;
+zm_atomic_uint_t arrivals[TEST_NEPISODES];
+zm_atomic_uint_t errors = 0;
+
+static void* run(void *arg) {
+    int tid = (int)(intptr_t) arg;
+    int ep;
+    for (ep = 0; ep < TEST_NEPISODES; ep++) {
+        zm_atomic_fetch_add(&arrivals[ep], 1, zm_memord_acq_rel);
+        zm_barrier_wait(barrier, tid);
+        if (zm_atomic_load(&arrivals[ep], zm_memord_acquire) != TEST_NTHREADS)
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+    }
+    zm_latch_count_down(&latch, (tid == 0) ? 2 : 1);
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_barrier
+ *
+ * Purpose: Test that no thread leaves a barrier episode before all the
+ *          threads arrived, for the given barrier kind.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_barrier(int kind, const char *name) {
+    pthread_t threads[TEST_NTHREADS];
+    int th, ep, success, errs = 0;
+
+    for (ep = 0; ep < TEST_NEPISODES; ep++)
+        zm_atomic_store(&arrivals[ep], 0, zm_memord_relaxed);
+    zm_atomic_store(&errors, 0, zm_memord_relaxed);
+    zm_barrier_init(&barrier, kind, TEST_NTHREADS);
+    zm_latch_init(&latch, TEST_NTHREADS + 1);
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, (void*)(intptr_t) th);
+    zm_latch_wait(&latch);
+    zm_latch_trywait(&latch, &success);
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_join(threads[th], NULL);
+
+    if (errors != 0) {
+        fprintf(stderr, "%s: %u early departures\n", name, errors);
+        errs++;
+    }
+    if (!success) {
+        fprintf(stderr, "%s: latch not open after the wait\n", name);
+        errs++;
+    }
+
+    zm_latch_destroy(&latch);
+    zm_barrier_destroy(&barrier);
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    int errs = 0;
+    errs += test_barrier(ZM_BARRIER_CENTRAL, "central");
+    errs += test_barrier(ZM_BARRIER_DISSEMINATION, "dissemination");
+    errs += test_barrier(ZM_BARRIER_TOURNAMENT, "tournament");
+    errs += test_barrier(ZM_BARRIER_HIERARCHICAL, "hierarchical");
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
@@ -0,0 +1,140 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <lock/zm_mcs.h>
+#include <cond/zm_mcond.h>
+
+/* Same as fcond_test.c with the wait-morphing condition variable: waiters
+   return holding the MCS lock, which is checked with a non-atomic update of
+   a counter next to each wait. In the first phase the main thread hands out
+   one token per signal on tcond, and every waiter must eventually get
+   exactly one. In the second phase the waiters wait on gcond for a new
+   generation that the main thread publishes with a single broadcast, which
+   must release all of them. */
+
+#define TEST_NTHREADS 8
+#define TEST_NROUNDS 100
+
+struct zm_mcond tcond;
+struct zm_mcond gcond;
+zm_mcs_t glock;
+long nwakes = 0;
+zm_atomic_uint_t in_cs = 0;
+zm_atomic_uint_t overlaps = 0;
+int tokens = 0;
+int consumed = 0;
+int waiting = 0; /* threads waiting for the broadcast */
+int generation = 0;
+
+/* called right after a wait returns: nobody else may hold the lock */
+static inline void check_owner() {
+    if (zm_atomic_fetch_add(&in_cs, 1, zm_memord_acq_rel) != 0)
+        zm_atomic_fetch_add(&overlaps, 1, zm_memord_acq_rel);
+    long tmp = nwakes;
+    __asm__ __volatile__("" ::: "memory");
+    nwakes = tmp + 1;
+    zm_atomic_fetch_add(&in_cs, -1, zm_memord_acq_rel);
+}
+
+static void* run(void *arg) {
+    int round, gen;
+    zm_mcs_qnode_t node;
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        /* signal phase */
+        zm_mcs_acquire_c(glock, &node);
+        while (tokens == 0) {
+            zm_mcond_wait_c(&tcond, glock, &node);
+            check_owner();
+        }
+        tokens--;
+        consumed++;
+        zm_mcs_release_c(glock, &node);
+
+        /* broadcast phase */
+        zm_mcs_acquire_c(glock, &node);
+        gen = generation;
+        waiting++;
+        while (generation == gen) {
+            zm_mcond_wait_c(&gcond, glock, &node);
+            check_owner();
+        }
+        zm_mcs_release_c(glock, &node);
+    }
+    return 0;
+}
+
+static inline void wait_for_waiters(int n) {
+    zm_mcs_qnode_t node;
+    int w;
+    do {
+        zm_mcs_acquire_c(glock, &node);
+        w = waiting;
+        zm_mcs_release_c(glock, &node);
+    } while (w != n);
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_mcond
+ *
+ * Purpose: Test signal-one and broadcast with many waiters on a single
+ *          wait-morphing condition variable.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_mcond() {
+    pthread_t threads[TEST_NTHREADS];
+    zm_mcs_qnode_t node;
+    int th, round, i, errs = 0;
+
+    zm_mcond_init(&tcond);
+    zm_mcond_init(&gcond);
+    zm_mcs_init(&glock);
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, NULL);
+
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        for (i = 0; i < TEST_NTHREADS; i++) {
+            zm_mcs_acquire_c(glock, &node);
+            tokens++;
+            zm_mcond_signal(&tcond);
+            zm_mcs_release_c(glock, &node);
+        }
+        /* every waiter took its token and now waits for the broadcast */
+        wait_for_waiters(TEST_NTHREADS);
+        zm_mcs_acquire_c(glock, &node);
+        if (consumed != (round + 1) * TEST_NTHREADS || tokens != 0)
+            errs++;
+        waiting = 0;
+        generation++;
+        zm_mcond_bcast(&gcond);
+        zm_mcs_release_c(glock, &node);
+    }
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_join(threads[th], NULL);
+
+    zm_mcs_destroy(&glock);
+    zm_mcond_destroy(&tcond);
+    zm_mcond_destroy(&gcond);
+
+    /* every waiter is woken at least once per broadcast */
+    if (overlaps != 0 || nwakes < (long)TEST_NTHREADS * TEST_NROUNDS)
+        errs++;
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    return test_mcond();
+}
@@ -0,0 +1,117 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <lock/zm_lock.h>
+#include <cond/zm_ncond.h>
+
+/* Same as fcond_test.c with the topology-aware condition variable; the wake
+   ordering across sockets is measured by test/perf/lock/cond_numa.c.
+
+   Several threads wait on the condition variables. In the first phase the
+   main thread hands out one token per signal on tcond, and every waiter
+   must eventually get exactly one. In the second phase the waiters
+   wait on gcond for a new generation that the main thread publishes with a
+   single broadcast, which must release all of them. */
+
+#define TEST_NTHREADS 8
+#define TEST_NROUNDS 100
+
+zm_ncond_t tcond;
+zm_ncond_t gcond;
+zm_lock_t glock;
+int tokens = 0;
+int consumed = 0;
+int waiting = 0; /* threads waiting for the broadcast */
+int generation = 0;
+
+static void* run(void *arg) {
+    int round, gen;
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        /* signal phase */
+        zm_lock_acquire(&glock);
+        while (tokens == 0)
+            zm_ncond_wait(tcond, &glock);
+        tokens--;
+        consumed++;
+        zm_lock_release(&glock);
+
+        /* broadcast phase */
+        zm_lock_acquire(&glock);
+        gen = generation;
+        waiting++;
+        while (generation == gen)
+            zm_ncond_wait(gcond, &glock);
+        zm_lock_release(&glock);
+    }
+    return 0;
+}
+
+static inline void wait_for_waiters(int n) {
+    int w;
+    do {
+        zm_lock_acquire(&glock);
+        w = waiting;
+        zm_lock_release(&glock);
+    } while (w != n);
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_ncond
+ *
+ * Purpose: Test signal-one and broadcast with many waiters on a single
+ *          topology-aware condition variable.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_ncond() {
+    pthread_t threads[TEST_NTHREADS];
+    int th, round, i, errs = 0;
+
+    zm_ncond_init(&tcond);
+    zm_ncond_init(&gcond);
+    zm_lock_init(&glock);
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, NULL);
+
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        for (i = 0; i < TEST_NTHREADS; i++) {
+            zm_lock_acquire(&glock);
+            tokens++;
+            zm_ncond_signal(tcond);
+            zm_lock_release(&glock);
+        }
+        /* every waiter took its token and now waits for the broadcast */
+        wait_for_waiters(TEST_NTHREADS);
+        zm_lock_acquire(&glock);
+        if (consumed != (round + 1) * TEST_NTHREADS || tokens != 0)
+            errs++;
+        waiting = 0;
+        generation++;
+        zm_ncond_bcast(gcond);
+        zm_lock_release(&glock);
+    }
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_join(threads[th], NULL);
+
+    zm_lock_destroy(&glock);
+    zm_ncond_destroy(&tcond);
+    zm_ncond_destroy(&gcond);
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    return test_ncond();
+}
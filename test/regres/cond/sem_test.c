@@ -0,0 +1,130 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <cond/zm_sem.h>
+
+/* Threads take permits of a pool with zm_sem_wait, zm_sem_trywait and
+   zm_sem_timedwait, and give them back one at a time or in batches with
+   zm_sem_post. The number of permits in use must never exceed the size of
+   the pool, and all the permits must be back at the end. A last check
+   makes sure that a timed wait on an empty semaphore times out. */
+
+#define TEST_NTHREADS 8
+#define TEST_NITER 2000
+#define TEST_NPERMITS 3
+#define TEST_BATCH 2
+
+struct zm_sem sem;
+zm_atomic_uint_t in_use = 0;
+zm_atomic_uint_t errors = 0;
+
+static inline void use_permits(int n) {
+    if (zm_atomic_fetch_add(&in_use, n, zm_memord_acq_rel) + n > TEST_NPERMITS)
+        zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+    zm_atomic_fetch_add(&in_use, -n, zm_memord_acq_rel);
+}
+
+static void* run(void *arg) {
+    int tid = (int)(intptr_t) arg;
+    int iter, success, n;
+    for (iter = 0; iter < TEST_NITER; iter++) {
+        switch ((iter + tid) % 4) {
+            case 0:
+                zm_sem_wait(&sem);
+                use_permits(1);
+                zm_sem_post(&sem, 1);
+                break;
+            case 1:
+                zm_sem_trywait(&sem, &success);
+                if (success) {
+                    use_permits(1);
+                    zm_sem_post(&sem, 1);
+                }
+                break;
+            case 2:
+                zm_sem_timedwait(&sem, 1000, &success);
+                if (success) {
+                    use_permits(1);
+                    zm_sem_post(&sem, 1);
+                }
+                break;
+            case 3:
+                /* take up to a batch and give it back at once; the extra
+                 * permits are only tried so that no thread holds some
+                 * while blocking */
+                zm_sem_wait(&sem);
+                for (n = 1; n < TEST_BATCH; n++) {
+                    zm_sem_trywait(&sem, &success);
+                    if (!success)
+                        break;
+                }
+                use_permits(n);
+                zm_sem_post(&sem, n);
+                break;
+        }
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_sem
+ *
+ * Purpose: Test that the semaphore never hands out more permits than
+ *          available and loses none.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_sem() {
+    pthread_t threads[TEST_NTHREADS];
+    int th, value, success, errs = 0;
+
+    zm_sem_init(&sem, TEST_NPERMITS);
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, (void*)(intptr_t) th);
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_join(threads[th], NULL);
+
+    if (errors != 0) {
+        fprintf(stderr, "%u times more than %d permits in use\n", errors, TEST_NPERMITS);
+        errs++;
+    }
+    zm_sem_getvalue(&sem, &value);
+    if (value != TEST_NPERMITS) {
+        fprintf(stderr, "%d permits left instead of %d\n", value, TEST_NPERMITS);
+        errs++;
+    }
+
+    /* drain the pool: a timed wait must then fail */
+    for (th = 0; th < TEST_NPERMITS; th++)
+        zm_sem_wait(&sem);
+    zm_sem_timedwait(&sem, 1000000, &success);
+    if (success) {
+        fprintf(stderr, "timed wait succeeded on an empty semaphore\n");
+        errs++;
+    }
+    zm_sem_post(&sem, TEST_NPERMITS);
+    zm_sem_getvalue(&sem, &value);
+    if (value != TEST_NPERMITS) {
+        fprintf(stderr, "%d permits after the timeout instead of %d\n", value, TEST_NPERMITS);
+        errs++;
+    }
+
+    zm_sem_destroy(&sem);
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    return test_sem();
+}
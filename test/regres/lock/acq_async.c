@@ -0,0 +1,115 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "lock/zm_mcs.h"
+
+/* Threads mix blocking and asynchronous acquisitions of an MCS lock. The
+   continuations of thread 0 are delivered to its inbox, which it polls;
+   those of the other threads are run by whoever releases the lock to them.
+   Every critical section performs a non-atomic update of the counter. */
+
+#define TEST_NTHREADS 4
+#define TEST_NITER 2000
+
+zm_mcs_t lock;
+long counter = 0;
+zm_atomic_uint_t in_cs = 0;
+zm_atomic_uint_t errors = 0;
+zm_atomic_uint_t completed[TEST_NTHREADS];
+
+static inline void critical_section() {
+    if (zm_atomic_fetch_add(&in_cs, 1, zm_memord_acq_rel) != 0)
+        zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+    long tmp = counter;
+    __asm__ __volatile__("" ::: "memory");
+    counter = tmp + 1;
+    zm_atomic_fetch_add(&in_cs, -1, zm_memord_acq_rel);
+}
+
+static void continuation(zm_ptr_t arg) {
+    critical_section();
+    zm_atomic_fetch_add(&completed[arg], 1, zm_memord_release);
+}
+
+static void* run(void *arg) {
+    int tid = (int)(intptr_t) arg;
+    int iter, issued = 0;
+    zm_mcs_qnode_t node;
+    zm_mcs_inbox_t inbox;
+
+    if (tid == 0) {
+        zm_mcs_inbox_init(&inbox);
+        zm_mcs_inbox_bind(&inbox);
+    }
+    for(iter=0; iter<TEST_NITER; iter++) {
+        if (iter % 2) {
+            zm_mcs_acquire_c(lock, &node);
+            critical_section();
+            zm_mcs_release_c(lock, &node);
+        } else {
+            zm_mcs_acquire_async(lock, continuation, tid);
+            issued++;
+        }
+        if (tid == 0)
+            zm_mcs_inbox_poll(&inbox, NULL);
+    }
+    if (tid == 0) {
+        /* the event loop runs until its continuations are done */
+        while (zm_atomic_load(&completed[tid], zm_memord_acquire) != issued)
+            zm_mcs_inbox_poll(&inbox, NULL);
+        zm_mcs_inbox_bind(NULL);
+        zm_mcs_inbox_destroy(&inbox);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_acq_async
+ *
+ * Purpose: Test mutual exclusion and completion of asynchronous MCS
+ *  acquisitions mixed with blocking ones
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_acq_async() {
+    void *res;
+    pthread_t threads[TEST_NTHREADS];
+    int th;
+
+    zm_mcs_init(&lock);
+
+    for (th=0; th<TEST_NTHREADS; th++) {
+        zm_atomic_store(&completed[th], 0, zm_memord_relaxed);
+        pthread_create(&threads[th], NULL, run, (void*)(intptr_t) th);
+    }
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_join(threads[th], &res);
+
+    /* the continuations of the other threads are done once the lock is
+     * free again */
+    for (th=1; th<TEST_NTHREADS; th++)
+        while (zm_atomic_load(&completed[th], zm_memord_acquire) != TEST_NITER / 2)
+            ;
+
+    zm_mcs_destroy(&lock);
+
+    if (counter != (long)TEST_NTHREADS * TEST_NITER || errors != 0) {
+        printf("Fail: counter %ld (expected %ld), %u exclusion errors\n",
+               counter, (long)TEST_NTHREADS * TEST_NITER, errors);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+
+} /* end test_acq_async() */
+
+int main(int argc, char **argv)
+{
+  return test_acq_async();
+} /* end main() */
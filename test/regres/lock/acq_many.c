@@ -0,0 +1,105 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <lock/zm_lock_many.h>
+
+/* Each thread repeatedly picks a random subset (with possible duplicates)
+   of the locks, takes them all with zm_lock_acquire_many_c and performs
+   non-atomic updates of the protected counters. Lock ordering issues would
+   result in a deadlock, and broken mutual exclusion in lost updates. */
+
+#define TEST_NTHREADS 4
+#define TEST_NITER 2000
+#define TEST_NLOCKS 8
+#define TEST_MAXHELD 8
+
+zm_lock_t locks[TEST_NLOCKS];
+long counters[TEST_NLOCKS] = {0};
+long increments[TEST_NTHREADS][TEST_NLOCKS] = {{0}};
+
+static void* run(void *arg) {
+    int tid = (intptr_t) arg;
+    unsigned seed = tid + 1;
+    int iter, i;
+    for(iter=0; iter<TEST_NITER; iter++) {
+        zm_lock_t *held[TEST_MAXHELD];
+        zm_lock_ctxt_t ctxts[TEST_MAXHELD];
+        int n = 2 + rand_r(&seed) % (TEST_MAXHELD - 1);
+        for (i = 0; i < n; i++)
+            held[i] = &locks[rand_r(&seed) % TEST_NLOCKS];
+        zm_lock_acquire_many_c(held, ctxts, n);
+        for (i = 0; i < n; i++) {
+            int idx = held[i] - locks;
+            if (i > 0 && held[i] == held[i-1])
+                continue;
+            long tmp = counters[idx];
+            __asm__ __volatile__("" ::: "memory");
+            counters[idx] = tmp + 1;
+            increments[tid][idx]++;
+        }
+        zm_lock_release_many_c(held, ctxts, n);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_acq_many
+ *
+ * Purpose: Test deadlock freedom and mutual exclusion of multi-lock
+ *  acquisitions
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_acq_many() {
+    void *res;
+    pthread_t threads[TEST_NTHREADS];
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int th, i;
+
+    for (i = 0; i < TEST_NLOCKS; i++)
+        zm_lock_init(&locks[i]);
+
+    for (th=0; th<TEST_NTHREADS; th++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(th % ncpus, &cpuset);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        pthread_create(&threads[th], &attr, run, (void*)(intptr_t) th);
+        pthread_attr_destroy(&attr);
+    }
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_join(threads[th], &res);
+
+    for (i = 0; i < TEST_NLOCKS; i++) {
+        long expected = 0;
+        for (th=0; th<TEST_NTHREADS; th++)
+            expected += increments[th][i];
+        if (counters[i] != expected) {
+            printf("Fail: counter %d is %ld instead of %ld\n", i, counters[i], expected);
+            return 1;
+        }
+    }
+    for (i = 0; i < TEST_NLOCKS; i++)
+        zm_lock_destroy(&locks[i]);
+    printf("Pass\n");
+    return 0;
+
+} /* end test_acq_many() */
+
+int main(int argc, char **argv)
+{
+  return test_acq_many();
+} /* end main() */
@@ -0,0 +1,157 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <lock/zm_ticket.h>
+#include <lock/zm_biased.h>
+
+/* A lock mostly taken by one thread (the owner) and, in the second phase,
+   rarely by an intruder thread. Reports the cost per acquisition of the
+   biased lock against the ticket lock and the biased lock statistics. */
+
+#define TEST_NITER (1<<20)
+#define TEST_NINTRUDE 16
+
+char cache_lines[640] = {0};
+int indices [] = {3,6,1,7,0,2,9,4,8,5};
+long counter = 0;
+
+zm_ticket_t ticket;
+zm_biased_t biased;
+int use_biased;
+int intrude;
+zm_atomic_uint_t progress = 0;
+
+static inline void lock() {
+    if (use_biased)
+        zm_biased_acquire(&biased);
+    else
+        zm_ticket_acquire(&ticket);
+}
+
+static inline void unlock() {
+    if (use_biased)
+        zm_biased_release(&biased);
+    else
+        zm_ticket_release(&ticket);
+}
+
+static inline void cs() {
+    for(int i = 0; i < 10; i++)
+        cache_lines[indices[i]] += cache_lines[indices[9-i]];
+    counter++;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void* run_owner(void *arg) {
+    int iter;
+    double *elapsed = (double*) arg;
+    double start = now();
+    for(iter=0; iter<TEST_NITER; iter++) {
+        lock();
+        cs();
+        unlock();
+        if (intrude && (iter & 0xff) == 0)
+            zm_atomic_store(&progress, iter, zm_memord_relaxed);
+    }
+    *elapsed = now() - start;
+    return 0;
+}
+
+static void* run_intruder(void *arg) {
+    int i;
+    for(i=0; i<TEST_NINTRUDE; i++) {
+        unsigned target = (unsigned)(i + 1) * (TEST_NITER / (TEST_NINTRUDE + 1));
+        while(zm_atomic_load(&progress, zm_memord_relaxed) < target)
+            sched_yield();
+        lock();
+        cs();
+        unlock();
+    }
+    return 0;
+}
+
+static int run_phase(int biased_lock, int with_intruder, double *elapsed) {
+    pthread_t owner, intruder;
+    void *res;
+    long expected;
+
+    use_biased = biased_lock;
+    intrude = with_intruder;
+    counter = 0;
+    zm_atomic_store(&progress, 0, zm_memord_relaxed);
+
+    pthread_create(&owner, NULL, run_owner, (void*) elapsed);
+    if (intrude)
+        pthread_create(&intruder, NULL, run_intruder, NULL);
+    pthread_join(owner, &res);
+    if (intrude)
+        pthread_join(intruder, &res);
+
+    expected = TEST_NITER + (intrude ? TEST_NINTRUDE : 0);
+    if (counter != expected) {
+        printf("Fail: counter %ld (expected %ld)\n", counter, expected);
+        return 1;
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_biased_thruput
+ *
+ * Purpose: Compare the biased lock with its underlying ticket lock when a
+ *  single thread takes the lock most of the time
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_biased_thruput() {
+    double t_tkt, t_biased, t_tkt_intr, t_biased_intr;
+    zm_biased_stats_t stats;
+
+    zm_ticket_init(&ticket);
+    if (run_phase(0, 0, &t_tkt) || run_phase(0, 1, &t_tkt_intr))
+        return 1;
+    zm_ticket_destroy(&ticket);
+
+    zm_biased_init(&biased);
+    if (run_phase(1, 0, &t_biased))
+        return 1;
+    zm_biased_destroy(&biased);
+    zm_biased_init(&biased);
+    if (run_phase(1, 1, &t_biased_intr))
+        return 1;
+    zm_biased_get_stats(&biased, &stats);
+    zm_biased_destroy(&biased);
+
+    printf("# ns per acquisition\n");
+    printf("scenario,ticket,biased\n");
+    printf("owner_only,%.2lf,%.2lf\n", t_tkt * 1e9 / TEST_NITER, t_biased * 1e9 / TEST_NITER);
+    printf("intruder,%.2lf,%.2lf\n", t_tkt_intr * 1e9 / TEST_NITER, t_biased_intr * 1e9 / TEST_NITER);
+    printf("# biased with intruder: fast=%lu slow=%lu revocations=%lu rebiases=%lu\n",
+           stats.fast_acqs, stats.slow_acqs, stats.revocations, stats.rebiases);
+
+    if (stats.fast_acqs + stats.slow_acqs != TEST_NITER + TEST_NINTRUDE) {
+        printf("Fail: %lu acquisitions counted\n", stats.fast_acqs + stats.slow_acqs);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+
+} /* end test_biased_thruput() */
+
+int main(int argc, char **argv)
+{
+  return test_biased_thruput();
+} /* end main() */
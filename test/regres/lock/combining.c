@@ -0,0 +1,88 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "lock/zm_ccsynch.h"
+
+/* Each thread adds its id to a shared counter through CC-Synch and H-Synch
+   and checks that the operation returned the counter value it produced.
+   Lost updates reveal broken mutual exclusion; wrong return values reveal
+   a combiner writing back to the wrong node. */
+
+#define TEST_NTHREADS 4
+#define TEST_NITER 5000
+
+zm_ccsynch_t ccsynch;
+zm_hsynch_t hsynch;
+long counter = 0;
+zm_atomic_uint_t errors = 0;
+
+static zm_ptr_t add(zm_ptr_t arg) {
+    counter += arg;
+    return (zm_ptr_t) counter;
+}
+
+static void* run(void *arg) {
+    zm_ptr_t inc = (zm_ptr_t) arg + 1;
+    zm_ptr_t ret;
+    zm_ccsynch_node_t *node;
+    int iter;
+    zm_ccsynch_node_alloc(&node);
+    for(iter=0; iter<TEST_NITER; iter++) {
+        zm_ccsynch_apply(&ccsynch, &node, add, inc, &ret);
+        if (ret < inc)
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+        zm_hsynch_apply(hsynch, &node, add, inc, &ret);
+        if (ret < inc)
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+    }
+    zm_ccsynch_node_free(node);
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_combining
+ *
+ * Purpose: Test that CC-Synch and H-Synch apply every operation exactly
+ *  once and under mutual exclusion
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_combining() {
+    void *res;
+    pthread_t threads[TEST_NTHREADS];
+    long expected = 0;
+    int th;
+
+    zm_ccsynch_init(&ccsynch);
+    zm_hsynch_init(&hsynch);
+
+    for (th=0; th<TEST_NTHREADS; th++) {
+        pthread_create(&threads[th], NULL, run, (void*)(intptr_t) th);
+        expected += 2L * TEST_NITER * (th + 1);
+    }
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_join(threads[th], &res);
+
+    zm_hsynch_destroy(&hsynch);
+    zm_ccsynch_destroy(&ccsynch);
+
+    if (counter != expected || errors != 0) {
+        printf("Fail: counter %ld (expected %ld), %u bad return values\n",
+               counter, expected, errors);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+
+} /* end test_combining() */
+
+int main(int argc, char **argv)
+{
+  return test_combining();
+} /* end main() */
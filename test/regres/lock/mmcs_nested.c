@@ -0,0 +1,106 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "lock/zm_mmcs.h"
+
+/* Each thread enters a critical section, reenters it from a nested scope,
+   then releases the lock from the nested scope with the memorizing API and
+   reacquires it without a context, as done for lock passing in nested
+   scopes. The owner of the lock checks that nobody else gets in. There are
+   more threads than the lock used to keep saved contexts for. */
+
+#define TEST_NTHREADS 24
+#define TEST_NITER 2000
+
+zm_mmcs_t lock;
+zm_atomic_uint_t in_cs = 0;
+long counter = 0;
+zm_atomic_uint_t errors = 0;
+
+static inline void enter() {
+    if (zm_atomic_fetch_add(&in_cs, 1, zm_memord_acq_rel) != 0)
+        zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+}
+
+static inline void leave() {
+    zm_atomic_fetch_add(&in_cs, -1, zm_memord_acq_rel);
+}
+
+static void* run(void *arg) {
+    int iter;
+    zm_mcs_qnode_t node, nested_node, *ctxt;
+    for(iter=0; iter<TEST_NITER; iter++) {
+        zm_mmcs_acquire_c(&lock, &node);
+        enter();
+        counter++;
+        /* nested scope */
+        zm_mmcs_acquire_c(&lock, &nested_node);
+        counter++;
+        /* pass the lock to other threads from the nested scope */
+        leave();
+        zm_mmcs_release(&lock, &ctxt);
+        if (ctxt != &node)
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+        if (zm_mmcs_acquire(&lock, NULL) != 0) {
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+            zm_mmcs_acquire(&lock, ctxt);
+        }
+        enter();
+        counter++;
+        /* leave the nested scope then the outer one */
+        zm_mmcs_release_c(&lock, &nested_node);
+        counter++;
+        leave();
+        zm_mmcs_release_c(&lock, &node);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_mmcs_nested
+ *
+ * Purpose: Test reentrant acquisitions and context-less reacquisitions
+ *  of the memorizing MCS lock
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_mmcs_nested() {
+    void *res;
+    pthread_t threads[TEST_NTHREADS];
+    int th;
+
+    zm_mmcs_init(&lock);
+
+    /* nothing to reacquire the lock with */
+    if (zm_mmcs_acquire(&lock, NULL) == 0) {
+        printf("Fail: context-less acquisition without a saved context\n");
+        return 1;
+    }
+
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, NULL);
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_join(threads[th], &res);
+
+    zm_mmcs_destroy(&lock);
+
+    if (counter != 4L * TEST_NTHREADS * TEST_NITER || errors != 0) {
+        printf("Fail: counter %ld (expected %ld), %u exclusion errors\n",
+               counter, 4L * TEST_NTHREADS * TEST_NITER, errors);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+
+} /* end test_mmcs_nested() */
+
+int main(int argc, char **argv)
+{
+  return test_mmcs_nested();
+} /* end main() */
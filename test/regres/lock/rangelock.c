@@ -0,0 +1,113 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "lock/zm_rangelock.h"
+#include "mem/zm_pool.h"
+
+#define TEST_NTHREADS 4
+#define TEST_NITER 2000
+#define TEST_NSLOTS 64
+#define TEST_MAXLEN 8
+
+zm_rangelock_t lock;
+int slots[TEST_NSLOTS] = {0};
+int increments[TEST_NTHREADS][TEST_NSLOTS] = {{0}};
+zm_atomic_uint_t errors = 0;
+
+static void* run(void *arg) {
+    int tid = (int)(intptr_t) arg;
+    unsigned seed = tid + 1;
+    int iter, i;
+    for(iter=0; iter<TEST_NITER; iter++) {
+        zm_rlnode_t *node;
+        zm_ulong_t start = rand_r(&seed) % TEST_NSLOTS;
+        zm_ulong_t end = start + 1 + rand_r(&seed) % TEST_MAXLEN;
+        if (end > TEST_NSLOTS)
+            end = TEST_NSLOTS;
+        if (rand_r(&seed) % 2) {
+            /* writer: non-atomic read-modify-write of every slot */
+            zm_rangelock_acquire(&lock, start, end, &node);
+            for(i = start; i < end; i++) {
+                int tmp = slots[i];
+                __asm__ __volatile__("" ::: "memory");
+                slots[i] = tmp + 1;
+                increments[tid][i]++;
+            }
+            zm_rangelock_release(&lock, node);
+        } else {
+            /* reader: the range must not change while it is held */
+            int snapshot[TEST_MAXLEN];
+            zm_rangelock_acquire_rd(&lock, start, end, &node);
+            for(i = start; i < end; i++)
+                snapshot[i - start] = slots[i];
+            __asm__ __volatile__("" ::: "memory");
+            for(i = start; i < end; i++)
+                if (snapshot[i - start] != slots[i])
+                    zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+            zm_rangelock_release(&lock, node);
+        }
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_rangelock
+ *
+ * Purpose: Test mutual exclusion of overlapping ranges by having writers
+ *  perform non-atomic updates and readers check that their ranges are stable,
+ *  and that request nodes are reused rather than leaked
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_rangelock() {
+    void *res;
+    pthread_t threads[TEST_NTHREADS];
+    int th, i, expected;
+    zm_ulong_t nmallocs, nfrees, allocs;
+
+    zm_pool_stats(&nmallocs, &nfrees);
+    allocs = nmallocs;
+    zm_rangelock_init(&lock);
+
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, (void*)(intptr_t) th);
+    for (th=0; th<TEST_NTHREADS; th++)
+        pthread_join(threads[th], &res);
+
+    zm_rangelock_destroy(&lock);
+    zm_pool_stats(&nmallocs, &nfrees);
+    allocs = nmallocs - allocs;
+
+    for (i=0; i<TEST_NSLOTS; i++) {
+        expected = 0;
+        for (th=0; th<TEST_NTHREADS; th++)
+            expected += increments[th][i];
+        if (slots[i] != expected) {
+            printf("Fail: slot %d is %d instead of %d\n", i, slots[i], expected);
+            return 1;
+        }
+    }
+    if (errors != 0) {
+        printf("Fail: %u readers observed concurrent writes\n", errors);
+        return 1;
+    }
+    if (allocs > TEST_NTHREADS * TEST_NITER / 10) {
+        printf("Fail: %lu allocations for %d acquisitions\n",
+               (unsigned long)allocs, TEST_NTHREADS * TEST_NITER);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+
+} /* end test_rangelock() */
+
+int main(int argc, char **argv)
+{
+  return test_rangelock();
+} /* end main() */
@@ -67,7 +67,7 @@
 #include <lock/zm_hmcs.h>
 /* types */
 #define zm_abslock_t                   zm_hmcs_t
-#define zm_abslock_localctx_t          int /*dummy*/
+#define zm_abslock_localctx_t          zm_hmcs_qnode_t
 #define zm_abslock_init                zm_hmcs_init
 #define zm_abslock_destroy                       zm_hmcs_destroy
 /* Context-less routines */
@@ -77,11 +77,31 @@
 #define zm_abslock_tryacq_l(global_lock, suc)    zm_hmcs_acquire(*(global_lock), suc)
 #define zm_abslock_release(global_lock)          zm_hmcs_release(*(global_lock))
 /* Context-full routines */
-#define zm_abslock_acquire_c(global_lock, local_context)  zm_hmcs_acquire(*(global_lock))
-#define zm_abslock_tryacq_c(global_lock, local_ctx, suc)  zm_hmcs_tryacq(*(global_lock), suc)
-#define zm_abslock_acquire_lc(global_lock, local_context) zm_hmcs_acquire(*(global_lock))
-#define zm_abslock_tryacq_lc(global_lock, local_ctx, suc) zm_hmcs_tryacq(*(global_lock), suc)
-#define zm_abslock_release_c(global_lock, local_context)  zm_hmcs_release(*(global_lock))
+#define zm_abslock_acquire_c(global_lock, local_context)  zm_hmcs_acquire_c(*(global_lock), local_context)
+#define zm_abslock_tryacq_c(global_lock, local_ctx, suc)  zm_hmcs_tryacq_c(*(global_lock), local_ctx, suc)
+#define zm_abslock_acquire_lc(global_lock, local_context) zm_hmcs_acquire_c(*(global_lock), local_context)
+#define zm_abslock_tryacq_lc(global_lock, local_ctx, suc) zm_hmcs_tryacq_c(*(global_lock), local_ctx, suc)
+#define zm_abslock_release_c(global_lock, local_context)  zm_hmcs_release_c(*(global_lock), local_context)
+
+#elif defined(ZMTEST_USE_BIASED)
+#include <lock/zm_biased.h>
+/* types */
+#define zm_abslock_t                   zm_biased_t
+#define zm_abslock_localctx_t          int /*dummy*/
+#define zm_abslock_init(global_lock)             zm_biased_init(global_lock)
+#define zm_abslock_destroy(global_lock)          zm_biased_destroy(global_lock)
+/* Context-less routines */
+#define zm_abslock_acquire(global_lock)          zm_biased_acquire(global_lock)
+#define zm_abslock_tryacq(global_lock, suc)      zm_biased_tryacq(global_lock, suc)
+#define zm_abslock_acquire_l(global_lock)        zm_biased_acquire(global_lock)
+#define zm_abslock_tryacq_l(global_lock, suc)    zm_biased_tryacq(global_lock, suc)
+#define zm_abslock_release(global_lock)          zm_biased_release(global_lock)
+/* Context-full routines */
+#define zm_abslock_acquire_c(global_lock, local_context)  zm_biased_acquire(global_lock)
+#define zm_abslock_tryacq_c(global_lock, local_ctx, suc)  zm_biased_tryacq(global_lock, suc)
+#define zm_abslock_acquire_lc(global_lock, local_context) zm_biased_acquire(global_lock)
+#define zm_abslock_tryacq_lc(global_lock, local_ctx, suc) zm_biased_tryacq(global_lock, suc)
+#define zm_abslock_release_c(global_lock, local_context)  zm_biased_release(global_lock)
 
 #else
 #error "No lock implementation specified"
@@ -0,0 +1,169 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "mem/zm_pool.h"
+#include "mem/zm_hzdptr.h"
+
+/* Objects that go back to a pool are reused without calling the system
+   allocator, also when they are freed by another thread than the one that
+   allocated them, and retired objects are not reused while a hazard
+   pointer refers to them. */
+
+#define TEST_OBJSIZE  64
+#define TEST_NOBJS    1000
+#define TEST_NROUNDS  200
+#define TEST_BATCH    256
+
+static zm_pool_t pool = ZM_POOL_INITIALIZER(TEST_OBJSIZE, TEST_OBJSIZE);
+
+static void *objs[TEST_NOBJS];
+
+static zm_ulong_t allocator_calls(void) {
+    zm_ulong_t nmallocs, nfrees;
+    zm_pool_stats(&nmallocs, &nfrees);
+    return nmallocs + nfrees;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_reuse
+ *
+ * Purpose: Test that freed objects are handed out again, distinct and
+ *          aligned, without system allocations.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_reuse() {
+    zm_ulong_t calls;
+    int i, round, errs = 0;
+
+    for (i = 0; i < TEST_NOBJS; i++)
+        objs[i] = zm_pool_alloc(&pool);
+    for (i = 0; i < TEST_NOBJS; i++)
+        zm_pool_free(&pool, objs[i]);
+
+    calls = allocator_calls();
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        for (i = 0; i < TEST_NOBJS; i++) {
+            objs[i] = zm_pool_alloc(&pool);
+            if ((zm_ptr_t)objs[i] % TEST_OBJSIZE != 0)
+                errs++;
+            memset(objs[i], i, TEST_OBJSIZE);
+        }
+        for (i = 0; i < TEST_NOBJS; i++) {
+            if (*(unsigned char*)objs[i] != (unsigned char)i)
+                errs++;
+            zm_pool_free(&pool, objs[i]);
+        }
+    }
+    calls = allocator_calls() - calls;
+    if (calls != 0) {
+        fprintf(stderr, "reuse: %lu allocator calls\n", (unsigned long)calls);
+        errs++;
+    }
+    return (errs != 0);
+}
+
+/* batches of objects handed from the producer to the consumer */
+static void *batch[TEST_BATCH];
+static zm_atomic_uint_t batch_full = 0;
+
+static void* consumer(void *arg) {
+    int round, i;
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        while (!zm_atomic_load(&batch_full, zm_memord_acquire))
+            ;
+        for (i = 0; i < TEST_BATCH; i++)
+            zm_pool_free(&pool, batch[i]);
+        zm_atomic_store(&batch_full, 0, zm_memord_release);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_remote_free
+ *
+ * Purpose: Test that objects freed by another thread come back to the
+ *          allocating thread through the depot.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_remote_free() {
+    pthread_t thread;
+    zm_ulong_t calls;
+    int round, i;
+
+    calls = allocator_calls();
+    pthread_create(&thread, NULL, consumer, NULL);
+    for (round = 0; round < TEST_NROUNDS; round++) {
+        while (zm_atomic_load(&batch_full, zm_memord_acquire))
+            ;
+        for (i = 0; i < TEST_BATCH; i++)
+            batch[i] = zm_pool_alloc(&pool);
+        zm_atomic_store(&batch_full, 1, zm_memord_release);
+    }
+    pthread_join(thread, NULL);
+    calls = allocator_calls() - calls;
+    /* the consumer keeps up to two magazines to itself */
+    if (calls > (zm_ulong_t)TEST_NROUNDS * TEST_BATCH / 10) {
+        fprintf(stderr, "remote free: %lu allocator calls for %d objects\n",
+                (unsigned long)calls, TEST_NROUNDS * TEST_BATCH);
+        return 1;
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_retire
+ *
+ * Purpose: Test that a retired object protected by a hazard pointer is not
+ *          handed out again.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_retire() {
+    zm_hzdptr_t *hzdptrs = zm_hzdptr_get();
+    void *protected = zm_pool_alloc(&pool);
+    int i, errs = 0;
+
+    hzdptrs[0] = (zm_ptr_t)protected;
+    zm_pool_retire(&pool, protected);
+    for (i = 0; i < TEST_NOBJS; i++)
+        objs[i] = zm_pool_alloc(&pool);
+    for (i = 0; i < TEST_NOBJS; i++)
+        zm_pool_retire(&pool, objs[i]);
+    for (i = 0; i < TEST_NOBJS; i++) {
+        objs[i] = zm_pool_alloc(&pool);
+        if (objs[i] == protected)
+            errs++;
+    }
+    hzdptrs[0] = ZM_NULL;
+    for (i = 0; i < TEST_NOBJS; i++)
+        zm_pool_free(&pool, objs[i]);
+    if (errs)
+        fprintf(stderr, "retire: a hazardous object was reused\n");
+    return (errs != 0);
+}
+
+int main(int argc, char **argv) {
+    int errs = 0;
+    errs += test_reuse();
+    errs += test_remote_free();
+    errs += test_retire();
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
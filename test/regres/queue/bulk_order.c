@@ -0,0 +1,108 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "queue/zm_queue.h"
+#define TEST_NPRODUCERS 2
+#define TEST_NELEMTS    20000
+#define TEST_BATCH      37  /* does not divide the segment or ring sizes */
+
+/* Elements encode their producer and sequence number: (seq << 8) | producer.
+   Producers enqueue in batches of varying size; consumers dequeue in
+   batches and check that the elements of each producer come out in order
+   and exactly once. */
+
+#if defined(ZMTEST_MPSC)
+#define TEST_NCONSUMERS 1
+#else
+#define TEST_NCONSUMERS 2
+#endif
+
+#define TEST_NDEQ (TEST_NPRODUCERS * TEST_NELEMTS)
+
+zm_queue_t queue;
+zm_atomic_uint_t test_counter = 0;
+zm_atomic_uint_t errors = 0;
+unsigned char seen[TEST_NPRODUCERS][TEST_NELEMTS];
+
+static void* producer(void *arg) {
+    int tid = (int)(size_t)arg;
+    void *batch[TEST_BATCH];
+    int seq = 0, n, i;
+    while (seq < TEST_NELEMTS) {
+        n = 1 + seq % TEST_BATCH;
+        if (n > TEST_NELEMTS - seq)
+            n = TEST_NELEMTS - seq;
+        for (i = 0; i < n; i++, seq++)
+            batch[i] = (void*)(((size_t)(seq + 1) << 8) | tid);
+        zm_queue_enqueue_bulk(&queue, batch, n);
+    }
+    return 0;
+}
+
+static void* consumer(void *arg) {
+    void *batch[TEST_BATCH];
+    long last[TEST_NPRODUCERS];
+    int count, i, p;
+    long seq;
+    for (p = 0; p < TEST_NPRODUCERS; p++)
+        last[p] = -1;
+    while (zm_atomic_load(&test_counter, zm_memord_acquire) < TEST_NDEQ) {
+        zm_queue_dequeue_bulk(&queue, batch, TEST_BATCH, &count);
+        for (i = 0; i < count; i++) {
+            p = (int)((size_t)batch[i] & 0xff);
+            seq = (long)((size_t)batch[i] >> 8) - 1;
+            if (p >= TEST_NPRODUCERS || seq < 0 || seq >= TEST_NELEMTS ||
+                seq <= last[p] || seen[p][seq]) {
+                zm_atomic_fetch_add(&errors, 1, zm_memord_relaxed);
+                continue;
+            }
+            seen[p][seq] = 1;
+            last[p] = seq;
+        }
+        if (count > 0)
+            zm_atomic_fetch_add(&test_counter, count, zm_memord_acq_rel);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: run
+ *
+ * Purpose: Test that bulk enqueues and dequeues deliver every element once
+ *  and keep the order of the elements of each producer
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int run() {
+    pthread_t producers[TEST_NPRODUCERS], consumers[TEST_NCONSUMERS];
+    int th;
+
+    zm_queue_init(&queue);
+    for (th = 0; th < TEST_NCONSUMERS; th++)
+        pthread_create(&consumers[th], NULL, consumer, NULL);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_create(&producers[th], NULL, producer, (void*)(size_t)th);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_join(producers[th], NULL);
+    for (th = 0; th < TEST_NCONSUMERS; th++)
+        pthread_join(consumers[th], NULL);
+
+    if (errors != 0 || test_counter != TEST_NDEQ) {
+        printf("Failed: %u errors, got %u elements instead of %d\n",
+               errors, test_counter, TEST_NDEQ);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    return run();
+}
@@ -0,0 +1,151 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "queue/zm_glqueue.h"
+#include "queue/zm_msqueue.h"
+#include "queue/zm_swpqueue.h"
+#include "queue/zm_faqueue.h"
+#include "queue/zm_mpbqueue.h"
+#include "queue/zm_rbqueue.h"
+#include "queue/zm_lcrqueue.h"
+
+/* Producers enqueue in bursts separated by pauses long enough for the
+   consumers to park in dequeue_wait. Once the producers are done, the main
+   thread enqueues one stop element per consumer. Every element must be
+   received, and every consumer must return. The element count stays below
+   one faqueue segment; the rbqueue holds less than a burst, so that its
+   producers also wait for free cells. */
+
+#define TEST_NPRODUCERS 2
+#define TEST_NELEMTS    400
+#define TEST_BURST      50
+#define TEST_NBUCKETS   8
+
+#define ELEM ((void*) 1)
+#define STOP ((void*) 2)
+
+enum { GL, MS, SWP, FA, MPB, RB, LCRQ };
+
+zm_queue_t queue;
+int kind;
+zm_atomic_uint_t test_counter = 0;
+zm_atomic_uint_t errors = 0;
+
+static void enqueue(void *data, int tid) {
+    switch (kind) {
+        case GL:  zm_glqueue_enqueue(&queue.glqueue, data); break;
+        case MS:  zm_msqueue_enqueue(&queue.msqueue, data); break;
+        case SWP: zm_swpqueue_enqueue(&queue.swpqueue, data); break;
+        case FA:  zm_faqueue_enqueue(&queue.faqueue, data); break;
+        case MPB: zm_mpbqueue_enqueue(&queue.mpbqueue, data, tid % TEST_NBUCKETS); break;
+        case RB:  zm_rbqueue_enqueue(&queue.rbqueue, data); break;
+        case LCRQ: zm_lcrqueue_enqueue(&queue.lcrqueue, data); break;
+    }
+}
+
+static void dequeue_wait(void **data) {
+    switch (kind) {
+        case GL:  zm_glqueue_dequeue_wait(&queue.glqueue, data); break;
+        case MS:  zm_msqueue_dequeue_wait(&queue.msqueue, data); break;
+        case SWP: zm_swpqueue_dequeue_wait(&queue.swpqueue, data); break;
+        case FA:  zm_faqueue_dequeue_wait(&queue.faqueue, data); break;
+        case MPB: zm_mpbqueue_dequeue_wait(&queue.mpbqueue, data); break;
+        case RB:  zm_rbqueue_dequeue_wait(&queue.rbqueue, data); break;
+        case LCRQ: zm_lcrqueue_dequeue_wait(&queue.lcrqueue, data); break;
+    }
+}
+
+static void* producer(void *arg) {
+    int tid = (int)(intptr_t) arg;
+    int elem;
+    for (elem = 0; elem < TEST_NELEMTS; elem++) {
+        enqueue(ELEM, tid);
+        if (elem % TEST_BURST == TEST_BURST - 1)
+            usleep(2000);
+    }
+    return 0;
+}
+
+static void* consumer(void *arg) {
+    void *elem;
+    while (1) {
+        dequeue_wait(&elem);
+        if (elem == STOP)
+            break;
+        if (elem == ELEM)
+            zm_atomic_fetch_add(&test_counter, 1, zm_memord_acq_rel);
+        else
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_dequeue_wait
+ *
+ * Purpose: Test that blocking dequeues return every element enqueued,
+ *          including the ones enqueued while the consumers are parked.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_dequeue_wait(int k, int nconsumers, const char *name) {
+    pthread_t producers[TEST_NPRODUCERS], consumers[2];
+    int th;
+
+    kind = k;
+    switch (kind) {
+        case GL:  zm_glqueue_init(&queue.glqueue); break;
+        case MS:  zm_msqueue_init(&queue.msqueue); break;
+        case SWP: zm_swpqueue_init(&queue.swpqueue); break;
+        case FA:  zm_faqueue_init(&queue.faqueue); break;
+        case MPB: zm_mpbqueue_init(&queue.mpbqueue, TEST_NBUCKETS); break;
+        case RB:  zm_rbqueue_init(&queue.rbqueue, TEST_BURST / 2); break;
+        case LCRQ: zm_lcrqueue_init(&queue.lcrqueue); break;
+    }
+    zm_atomic_store(&test_counter, 0, zm_memord_relaxed);
+    zm_atomic_store(&errors, 0, zm_memord_relaxed);
+
+    for (th = 0; th < nconsumers; th++)
+        pthread_create(&consumers[th], NULL, consumer, NULL);
+    /* let the consumers park on the empty queue */
+    usleep(10000);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_create(&producers[th], NULL, producer, (void*)(intptr_t) th);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_join(producers[th], NULL);
+    for (th = 0; th < nconsumers; th++)
+        enqueue(STOP, 0);
+    for (th = 0; th < nconsumers; th++)
+        pthread_join(consumers[th], NULL);
+
+    if (test_counter != TEST_NPRODUCERS * TEST_NELEMTS || errors != 0) {
+        fprintf(stderr, "%s: got %u elements instead of %d, %u errors\n", name,
+                test_counter, TEST_NPRODUCERS * TEST_NELEMTS, errors);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int errs = 0;
+    errs += test_dequeue_wait(GL, 2, "glqueue");
+    errs += test_dequeue_wait(MS, 2, "msqueue");
+    errs += test_dequeue_wait(SWP, 1, "swpqueue");
+    errs += test_dequeue_wait(FA, 1, "faqueue");
+    errs += test_dequeue_wait(MPB, 1, "mpbqueue");
+    errs += test_dequeue_wait(RB, 2, "rbqueue");
+    errs += test_dequeue_wait(LCRQ, 2, "lcrqueue");
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
@@ -0,0 +1,191 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "queue/zm_iswpqueue.h"
+#include "queue/zm_imsqueue.h"
+#include "queue/zm_ifaqueue.h"
+#define TEST_NPRODUCERS 2
+#define TEST_NELEMTS    20000
+#define TEST_NOBJS      256 /* objects per producer, recycled */
+
+/* Producers enqueue objects that embed a zm_qlink_t and carry a producer
+   id and a sequence number; consumers check that every sequence number
+   arrives once and in the order of its producer. Objects are recycled:
+   with the imsqueue they go back to their producer when the queue disposes
+   of their link, with the other queues once they are dequeued. */
+
+#if defined(ZMTEST_USE_ISWPQUEUE)
+#define TEST_NCONSUMERS 1
+#else
+#define TEST_NCONSUMERS 2
+#endif
+
+typedef struct test_obj test_obj_t;
+struct test_obj {
+    int producer;
+    int seq;
+    zm_atomic_uint_t busy;  /* owned by the queue */
+    zm_qlink_t link;
+};
+
+static test_obj_t objs[TEST_NPRODUCERS][TEST_NOBJS];
+/* free objects of each producer */
+static zm_atomic_ptr_t free_objs[TEST_NPRODUCERS][TEST_NOBJS];
+static zm_atomic_uint_t free_head[TEST_NPRODUCERS], free_tail[TEST_NPRODUCERS];
+
+static zm_atomic_uint_t test_counter = 0;
+static zm_atomic_uint_t errors = 0;
+
+#if defined(ZMTEST_USE_ISWPQUEUE)
+static zm_iswpqueue_t queue;
+#define queue_enqueue(l)  zm_iswpqueue_enqueue(&queue, l)
+#define queue_dequeue(l)  zm_iswpqueue_dequeue(&queue, l)
+#elif defined(ZMTEST_USE_IMSQUEUE)
+static zm_imsqueue_t queue;
+#define queue_enqueue(l)  zm_imsqueue_enqueue(&queue, l)
+#define queue_dequeue(l)  zm_imsqueue_dequeue(&queue, l)
+static zm_atomic_uint_t nconsumers_done = 0;
+#elif defined(ZMTEST_USE_IFAQUEUE)
+static zm_ifaqueue_t queue;
+#define queue_enqueue(l)  zm_ifaqueue_enqueue(&queue, l)
+#define queue_dequeue(l)  zm_ifaqueue_dequeue(&queue, l)
+#endif
+
+/* single-producer single-consumer ring of free objects per producer */
+static void obj_put(test_obj_t *obj) {
+    int p = obj->producer;
+    unsigned t = zm_atomic_fetch_add(&free_tail[p], 1, zm_memord_acq_rel);
+    zm_atomic_store(&free_objs[p][t % TEST_NOBJS], (zm_ptr_t)obj, zm_memord_release);
+}
+
+static test_obj_t *obj_get(int p) {
+    unsigned h = zm_atomic_load(&free_head[p], zm_memord_relaxed);
+    zm_ptr_t obj;
+    while ((obj = zm_atomic_load(&free_objs[p][h % TEST_NOBJS], zm_memord_acquire)) == ZM_NULL)
+        ;
+    zm_atomic_store(&free_objs[p][h % TEST_NOBJS], ZM_NULL, zm_memord_relaxed);
+    zm_atomic_store(&free_head[p], h + 1, zm_memord_relaxed);
+    return (test_obj_t*)obj;
+}
+
+static void obj_release(test_obj_t *obj) {
+    if (zm_atomic_load(&obj->busy, zm_memord_acquire) != 1)
+        zm_atomic_fetch_add(&errors, 1, zm_memord_relaxed);
+    zm_atomic_store(&obj->busy, 0, zm_memord_release);
+    obj_put(obj);
+}
+
+#if defined(ZMTEST_USE_IMSQUEUE)
+static void dispose(zm_qlink_t *link) {
+    test_obj_t *obj = zm_qlink_entry(link, test_obj_t, link);
+    /* the dummy is never disposed */
+    if (zm_atomic_load(&queue.head, zm_memord_acquire) == (zm_ptr_t)link)
+        zm_atomic_fetch_add(&errors, 1, zm_memord_relaxed);
+    obj_release(obj);
+}
+#endif
+
+static void* producer(void *arg) {
+    int p = (int)(size_t)arg;
+    int seq;
+    for (seq = 0; seq < TEST_NELEMTS; seq++) {
+        test_obj_t *obj = obj_get(p);
+        if (zm_atomic_load(&obj->busy, zm_memord_acquire) != 0)
+            zm_atomic_fetch_add(&errors, 1, zm_memord_relaxed);
+        zm_atomic_store(&obj->busy, 1, zm_memord_relaxed);
+        obj->seq = seq;
+        queue_enqueue(&obj->link);
+    }
+    return 0;
+}
+
+static void* consumer(void *arg) {
+    int last[TEST_NPRODUCERS], p;
+    zm_qlink_t *link;
+    for (p = 0; p < TEST_NPRODUCERS; p++)
+        last[p] = -1;
+    while (zm_atomic_load(&test_counter, zm_memord_acquire) < TEST_NPRODUCERS * TEST_NELEMTS) {
+        if (!queue_dequeue(&link))
+            continue;
+        test_obj_t *obj = zm_qlink_entry(link, test_obj_t, link);
+        p = obj->producer;
+        if (obj->seq <= last[p])
+            zm_atomic_fetch_add(&errors, 1, zm_memord_relaxed);
+        last[p] = obj->seq;
+#if !defined(ZMTEST_USE_IMSQUEUE)
+        obj_release(obj);
+#endif
+        zm_atomic_fetch_add(&test_counter, 1, zm_memord_acq_rel);
+    }
+#if defined(ZMTEST_USE_IMSQUEUE)
+    /* no hazard pointers are left once every consumer is here */
+    zm_atomic_fetch_add(&nconsumers_done, 1, zm_memord_acq_rel);
+    while (zm_atomic_load(&nconsumers_done, zm_memord_acquire) < TEST_NCONSUMERS)
+        ;
+    zm_imsqueue_reclaim();
+#endif
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: run
+ *
+ * Purpose: Test that an intrusive queue delivers every element once and in
+ *  per-producer order, and that elements can be reused once the queue hands
+ *  them back
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int run() {
+    pthread_t producers[TEST_NPRODUCERS], consumers[TEST_NCONSUMERS];
+    int th, p, i, nfree = 0;
+
+    for (p = 0; p < TEST_NPRODUCERS; p++)
+        for (i = 0; i < TEST_NOBJS; i++) {
+            objs[p][i].producer = p;
+            obj_put(&objs[p][i]);
+        }
+#if defined(ZMTEST_USE_ISWPQUEUE)
+    zm_iswpqueue_init(&queue);
+#elif defined(ZMTEST_USE_IMSQUEUE)
+    zm_imsqueue_init(&queue, dispose);
+#elif defined(ZMTEST_USE_IFAQUEUE)
+    zm_ifaqueue_init(&queue);
+#endif
+
+    for (th = 0; th < TEST_NCONSUMERS; th++)
+        pthread_create(&consumers[th], NULL, consumer, NULL);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_create(&producers[th], NULL, producer, (void*)(size_t)th);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_join(producers[th], NULL);
+    for (th = 0; th < TEST_NCONSUMERS; th++)
+        pthread_join(consumers[th], NULL);
+
+#if defined(ZMTEST_USE_IMSQUEUE)
+    /* hands back the dummy */
+    zm_imsqueue_destroy(&queue);
+#endif
+
+    /* every object is free again */
+    for (p = 0; p < TEST_NPRODUCERS; p++)
+        nfree += free_tail[p] - free_head[p];
+    if (errors != 0 || nfree != TEST_NPRODUCERS * TEST_NOBJS) {
+        printf("Failed: %u errors, %d free objects instead of %d\n",
+               errors, nfree, TEST_NPRODUCERS * TEST_NOBJS);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    return run();
+}
@@ -0,0 +1,114 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "queue/zm_queue.h"
+
+/* Queues of different types live side by side in one process through the
+   runtime interface. Each queue gets one producer and one consumer, which
+   all run at the same time; every element carries the index of its queue
+   and its sequence number so that the consumers can check that it comes
+   out of the right queue exactly once. */
+
+#define TEST_NELEMTS  10000
+
+static const int types[] = {
+    ZM_GLQUEUE_IF, ZM_MSQUEUE_IF, ZM_SWPQUEUE_IF, ZM_FAQUEUE_IF,
+    ZM_MPBQUEUE_IF, ZM_RBQUEUE_IF, ZM_LCRQUEUE_IF, ZM_SPSCQUEUE_IF
+};
+#define TEST_NQUEUES  ((int) (sizeof(types) / sizeof(types[0])))
+
+static zm_queue_t queues[TEST_NQUEUES];
+static unsigned char seen[TEST_NQUEUES][TEST_NELEMTS];
+static zm_atomic_uint_t errors = 0;
+
+static void* producer(void *arg) {
+    int q = (int)(size_t) arg;
+    size_t elem;
+    for (elem = 0; elem < TEST_NELEMTS; elem++)
+        zm_queue_enqueue(&queues[q], (void*)((size_t) q * TEST_NELEMTS + elem + 1));
+    return 0;
+}
+
+static void* consumer(void *arg) {
+    int q = (int)(size_t) arg;
+    int ndeq = 0;
+    void *elem;
+    while (ndeq < TEST_NELEMTS) {
+        size_t val;
+        zm_queue_dequeue(&queues[q], &elem);
+        if (elem == NULL)
+            continue;
+        val = (size_t) elem - 1;
+        if (val / TEST_NELEMTS != (size_t) q) {
+            fprintf(stderr, "queue %d: got an element of queue %zu\n", q,
+                    val / TEST_NELEMTS);
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+        } else {
+            seen[q][val % TEST_NELEMTS]++;
+        }
+        ndeq++;
+    }
+    /* nothing may be left over */
+    zm_queue_dequeue(&queues[q], &elem);
+    if (elem != NULL) {
+        fprintf(stderr, "queue %d: extra element %p\n", q, elem);
+        zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_mixed_types
+ *
+ * Purpose: Test that queues of different types initialized with
+ *          zm_queue_init_type in the same process each deliver their own
+ *          elements exactly once.
+ *
+ * Return: Success: 0
+ *         Failure: number of errors
+ *-------------------------------------------------------------------------
+ */
+static int test_mixed_types() {
+    pthread_t threads[2 * TEST_NQUEUES];
+    int q, i, errs;
+
+    for (q = 0; q < TEST_NQUEUES; q++) {
+        if (zm_queue_init_type(&queues[q], types[q]) != 0) {
+            fprintf(stderr, "cannot initialize a queue of type %d\n", types[q]);
+            return 1;
+        }
+    }
+
+    for (q = 0; q < TEST_NQUEUES; q++) {
+        pthread_create(&threads[2 * q], NULL, consumer, (void*)(size_t) q);
+        pthread_create(&threads[2 * q + 1], NULL, producer, (void*)(size_t) q);
+    }
+    for (i = 0; i < 2 * TEST_NQUEUES; i++)
+        pthread_join(threads[i], NULL);
+
+    errs = zm_atomic_load(&errors, zm_memord_acquire);
+    for (q = 0; q < TEST_NQUEUES; q++) {
+        for (i = 0; i < TEST_NELEMTS; i++) {
+            if (seen[q][i] != 1) {
+                fprintf(stderr, "queue %d: element %d dequeued %d times\n",
+                        q, i, seen[q][i]);
+                errs++;
+            }
+        }
+    }
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    int errs = test_mixed_types();
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
@@ -0,0 +1,93 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "queue/zm_spscqueue.h"
+
+/* A producer pushes a numbered sequence through a ring much smaller than
+   the sequence, so that it keeps waiting for space, and a consumer checks
+   that the elements come out in order. Runs with the polling dequeue and
+   with the blocking one, and with and without batched publication. */
+
+#define TEST_NELEMTS  100000
+#define TEST_CAPACITY 16
+
+zm_spscqueue_t queue;
+
+static void* producer(void *arg) {
+    size_t elem;
+    for (elem = 1; elem <= TEST_NELEMTS; elem++)
+        zm_spscqueue_enqueue(&queue, (void*) elem);
+    zm_spscqueue_flush(&queue);
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_order
+ *
+ * Purpose: Test that every element is dequeued exactly once and in FIFO
+ *          order, and that try_enqueue reports a full queue.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_order(int batch, int block) {
+    pthread_t thread;
+    size_t expected = 1;
+    void *elem;
+    int i, errs = 0;
+
+    zm_spscqueue_init(&queue, TEST_CAPACITY, batch);
+    for (i = 0; i < TEST_CAPACITY; i++)
+        zm_spscqueue_try_enqueue(&queue, (void*)(size_t)(i + 1));
+    if (zm_spscqueue_try_enqueue(&queue, (void*) 1) != 0) {
+        fprintf(stderr, "batch %d: enqueued into a full queue\n", batch);
+        errs++;
+    }
+    zm_spscqueue_flush(&queue);
+    for (i = 0; i < TEST_CAPACITY; i++)
+        zm_spscqueue_dequeue(&queue, &elem);
+    if (zm_spscqueue_dequeue(&queue, &elem) != 0 || elem != NULL) {
+        fprintf(stderr, "batch %d: dequeued from an empty queue\n", batch);
+        errs++;
+    }
+    zm_spscqueue_destroy(&queue);
+
+    zm_spscqueue_init(&queue, TEST_CAPACITY, batch);
+    pthread_create(&thread, NULL, producer, NULL);
+    while (expected <= TEST_NELEMTS) {
+        if (block)
+            zm_spscqueue_dequeue_wait(&queue, &elem);
+        else if (!zm_spscqueue_dequeue(&queue, &elem))
+            continue;
+        if ((size_t) elem != expected) {
+            fprintf(stderr, "batch %d: got %zu instead of %zu\n", batch,
+                    (size_t) elem, expected);
+            errs++;
+            /* keep draining so that the producer completes */
+            expected = (size_t) elem;
+        }
+        expected++;
+    }
+    pthread_join(thread, NULL);
+    zm_spscqueue_destroy(&queue);
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    int errs = 0;
+    errs += test_order(1, 0);
+    errs += test_order(4, 0);
+    errs += test_order(1, 1);
+    errs += test_order(4, 1);
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
@@ -0,0 +1,79 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "queue/zm_swpqueue.h"
+#define TEST_NPRODUCERS 3
+#define TEST_NELEMTS    50000
+
+/* Producers enqueue (seq << 8) | producer; the consumer only drains the
+   queue with take_all and checks that every element arrives once and in
+   the order of its producer. Drains race with producers that have swapped
+   the tail but not linked their node yet. */
+
+zm_swpqueue_t queue;
+
+static void* producer(void *arg) {
+    int tid = (int)(size_t)arg;
+    size_t seq;
+    for (seq = 1; seq <= TEST_NELEMTS; seq++)
+        zm_swpqueue_enqueue(&queue, (void*)((seq << 8) | tid));
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: run
+ *
+ * Purpose: Test that take_all and the list iterator deliver every element
+ *  of an MPSC swpqueue exactly once and in per-producer order
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int run() {
+    pthread_t producers[TEST_NPRODUCERS];
+    size_t last[TEST_NPRODUCERS] = {0};
+    zm_swpqlist_t list;
+    size_t count = 0, seq;
+    unsigned long ndrains = 0;
+    int th, p, errs = 0;
+    void *data;
+
+    zm_swpqueue_init(&queue);
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_create(&producers[th], NULL, producer, (void*)(size_t)th);
+    while (count < (size_t)TEST_NPRODUCERS * TEST_NELEMTS) {
+        if (!zm_swpqueue_take_all(&queue, &list))
+            continue;
+        ndrains++;
+        while (zm_swpqueue_list_next(&list, &data)) {
+            p = (int)((size_t)data & 0xff);
+            seq = (size_t)data >> 8;
+            if (p >= TEST_NPRODUCERS || seq != last[p] + 1)
+                errs++;
+            else
+                last[p] = seq;
+            count++;
+        }
+    }
+    for (th = 0; th < TEST_NPRODUCERS; th++)
+        pthread_join(producers[th], NULL);
+    if (zm_swpqueue_take_all(&queue, &list))
+        errs++;
+
+    if (errs != 0) {
+        printf("Failed: %d errors in %lu drains\n", errs, ndrains);
+        return 1;
+    }
+    printf("Pass\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    return run();
+}
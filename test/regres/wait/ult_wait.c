@@ -0,0 +1,150 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil ; -*- */
+/*
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "wait/zm_ult.h"
+#include "lock/zm_mcs.h"
+#include "cond/zm_ccond.h"
+
+/* Several OS threads each run a set of cooperative ULTs. The ULTs contend
+   an MCS lock and yield while holding it, so the ULTs waiting behind it on
+   the same OS thread make progress only if the lock's spin loop yields
+   through the waiting hooks. Each OS thread also runs a consumer ULT that
+   waits on a condition variable for items produced by a sibling ULT. */
+
+#define TEST_NTHREADS 2
+#define TEST_NULTS 4
+#define TEST_NITER 200
+#define TEST_NITEMS 100
+
+zm_mcs_t lock;
+long counter = 0;
+zm_atomic_uint_t in_cs = 0;
+zm_atomic_uint_t errors = 0;
+
+struct pc {
+    zm_lock_t lock;
+    struct zm_ccond cond;
+    int items;
+    int consumed;
+};
+
+struct pc pcs[TEST_NTHREADS];
+
+static void contend(zm_ptr_t arg) {
+    zm_mcs_qnode_t node;
+    int iter;
+    for(iter=0; iter<TEST_NITER; iter++) {
+        zm_mcs_acquire_c(lock, &node);
+        if (zm_atomic_fetch_add(&in_cs, 1, zm_memord_acq_rel) != 0)
+            zm_atomic_fetch_add(&errors, 1, zm_memord_acq_rel);
+        long tmp = counter;
+        zm_ult_yield();
+        counter = tmp + 1;
+        zm_atomic_fetch_add(&in_cs, -1, zm_memord_acq_rel);
+        zm_mcs_release_c(lock, &node);
+    }
+}
+
+static void consume(zm_ptr_t arg) {
+    struct pc *pc = (struct pc*) arg;
+    zm_lock_ctxt_t ctxt;
+    int i;
+    for(i=0; i<TEST_NITEMS; i++) {
+        zm_lock_acquire_c(&pc->lock, &ctxt);
+        while (pc->items == 0)
+            zm_ccond_wait_c(&pc->cond, &pc->lock, &ctxt);
+        pc->items--;
+        pc->consumed++;
+        zm_lock_release_c(&pc->lock, &ctxt);
+    }
+}
+
+static void produce(zm_ptr_t arg) {
+    struct pc *pc = (struct pc*) arg;
+    int i;
+    /* the only ULT of its OS thread taking the lock without a context */
+    for(i=0; i<TEST_NITEMS; i++) {
+        zm_lock_acquire(&pc->lock);
+        pc->items++;
+        zm_ccond_signal(&pc->cond);
+        zm_lock_release(&pc->lock);
+        zm_ult_yield();
+    }
+}
+
+static void* run(void *arg) {
+    int tid = (int)(intptr_t) arg;
+    int i;
+    /* the consumer starts first so that it blocks */
+    zm_ult_create(consume, (zm_ptr_t) &pcs[tid]);
+    for(i=0; i<TEST_NULTS; i++)
+        zm_ult_create(contend, ZM_NULL);
+    zm_ult_create(produce, (zm_ptr_t) &pcs[tid]);
+    zm_ult_run();
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function: test_ult_wait
+ *
+ * Purpose: Test that locks and condition variables let the other ULTs of
+ *          an OS thread run while waiting.
+ *
+ * Return: Success: 0
+ *         Failure: 1
+ *-------------------------------------------------------------------------
+ */
+static int test_ult_wait() {
+    pthread_t threads[TEST_NTHREADS];
+    int th, errs = 0;
+
+    zm_mcs_init(&lock);
+    for (th = 0; th < TEST_NTHREADS; th++) {
+        zm_lock_init(&pcs[th].lock);
+        zm_ccond_init(&pcs[th].cond);
+        pcs[th].items = 0;
+        pcs[th].consumed = 0;
+    }
+    zm_ult_init();
+
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_create(&threads[th], NULL, run, (void*)(intptr_t) th);
+    for (th = 0; th < TEST_NTHREADS; th++)
+        pthread_join(threads[th], NULL);
+
+    zm_ult_finalize();
+
+    if (errors != 0) {
+        fprintf(stderr, "%u overlapping critical sections\n", errors);
+        errs++;
+    }
+    if (counter != (long)TEST_NTHREADS * TEST_NULTS * TEST_NITER) {
+        fprintf(stderr, "counter = %ld instead of %ld\n", counter,
+                (long)TEST_NTHREADS * TEST_NULTS * TEST_NITER);
+        errs++;
+    }
+    for (th = 0; th < TEST_NTHREADS; th++) {
+        if (pcs[th].consumed != TEST_NITEMS || pcs[th].items != 0) {
+            fprintf(stderr, "thread %d consumed %d items, %d left\n",
+                    th, pcs[th].consumed, pcs[th].items);
+            errs++;
+        }
+        zm_ccond_destroy(&pcs[th].cond);
+        zm_lock_destroy(&pcs[th].lock);
+    }
+    zm_mcs_destroy(&lock);
+
+    if (errs == 0)
+        printf("Pass\n");
+    else
+        printf("Fail\n");
+    return errs;
+}
+
+int main(int argc, char **argv) {
+    return test_ult_wait();
+}